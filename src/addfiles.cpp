@@ -9,6 +9,7 @@
 
 #include "csrcfiles.h"  // CSrcFiles
 #include "dryrun.h"     // CDryRun
+#include "plan.h"       // CPlan -- Records every file ttBld would write without writing any of them
 
 void AddFiles(const std::vector<ttlib::cstr>& lstFiles)
 {
@@ -71,7 +72,11 @@ void AddFiles(const std::vector<ttlib::cstr>& lstFiles)
         }
     }
 
-    if (!file.WriteFile(cSrcFiles.GetSrcFilesName()))
+    if (CPlan::Get().Add(cSrcFiles.GetSrcFilesName(), file, "project file"))
+    {
+        return;
+    }
+    else if (!file.WriteFile(cSrcFiles.GetSrcFilesName()))
     {
         std::cout << "Unable to create or write to " << cSrcFiles.GetSrcFilesName() << '\n';
     }
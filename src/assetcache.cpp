@@ -0,0 +1,221 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Content-addressed cache for -hgz, -png and -xpm conversions
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include <wx/utils.h>  // Miscellaneous utilities
+
+#include "assetcache.h"  // CAssetCache
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "trace.h"       // CTrace -- Scoped timers and counters exported as a Chrome trace
+
+static constexpr uint64_t FNV1A_PRIME = 0x00000100000001b3ULL;
+
+uint64_t HashFnv1a(std::string_view data, uint64_t hash)
+{
+    for (auto ch: data)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+CAssetCache::CAssetCache(std::string_view cache_dir) : m_cache_dir(cache_dir), m_hash(FNV1A_OFFSET)
+{
+    m_cache_dir.backslashestoforward();
+}
+
+void CAssetCache::HashBytes(const void* data, size_t size)
+{
+    m_hash = HashFnv1a(std::string_view(static_cast<const char*>(data), size), m_hash);
+    m_total_size += size;
+}
+
+void CAssetCache::HashString(std::string_view str)
+{
+    HashBytes(str.data(), str.size());
+
+    // Add a separator so that "ab" + "c" doesn't hash the same as "a" + "bc"
+    const unsigned char separator = 0;
+    HashBytes(&separator, 1);
+}
+
+bool CAssetCache::HashFile(const ttlib::cstr& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    constexpr size_t buf_size = 64 * 1024;
+    auto read_buf = std::make_unique<char[]>(buf_size);
+    while (file)
+    {
+        file.read(read_buf.get(), buf_size);
+        if (file.gcount() > 0)
+            HashBytes(read_buf.get(), static_cast<size_t>(file.gcount()));
+    }
+    return true;
+}
+
+bool CAssetCache::ComputeKey(std::string_view codec, int level, const std::vector<ttlib::cstr>& sources,
+                             std::string_view dst)
+{
+    m_hash = FNV1A_OFFSET;
+    m_total_size = 0;
+
+    // The version is part of the key so that a change to the generated header format invalidates all previous entries.
+    HashString(txtVersion);
+    HashString(codec);
+    HashString(std::to_string(level));
+
+    // The output filename is used to create the array name, so it must be part of the key.
+    HashString(dst);
+
+    for (auto& iter: sources)
+    {
+        // Source filenames end up in the comments of the generated header.
+        HashString(iter);
+        if (!HashFile(iter))
+        {
+            m_key.clear();
+            return false;
+        }
+    }
+
+    m_key.Format("%016llx%08llx", static_cast<unsigned long long>(m_hash),
+                 static_cast<unsigned long long>(m_total_size & 0xffffffff));
+
+    if (IsEnabled())
+    {
+        m_cache_file = m_cache_dir;
+        m_cache_file.append_filename(m_key);
+        m_cache_file << ".h";
+    }
+    return true;
+}
+
+bool CAssetCache::Fetch(const ttlib::cstr& dst)
+{
+    if (!IsEnabled() || m_key.empty())
+        return false;
+
+    std::string contents;
+    if (!ReadFileBytes(m_cache_file, contents))
+        return false;
+
+    if (CPlan::Get().Add(dst, contents, "converted asset"))
+        return true;
+    return WriteIfChanged(dst, contents.data(), contents.size());
+}
+
+bool CAssetCache::Commit(const void* data, size_t size, const ttlib::cstr& dst)
+{
+    if (CPlan::Get().Add(dst, std::string_view(static_cast<const char*>(data), size), "converted asset"))
+        return true;
+
+    if (!WriteIfChanged(dst, data, size))
+        return false;
+
+    if (IsEnabled() && !m_key.empty())
+    {
+        // Failure to update the cache isn't an error -- it just means the next run has to do the conversion again.
+        // Multiple ninja jobs can be running at the same time, which WriteFileAtomic() takes care of.
+        std::error_code ec;
+        std::filesystem::create_directories(m_cache_dir.c_str(), ec);
+        WriteFileAtomic(m_cache_file, data, size);
+    }
+    return true;
+}
+
+bool CAssetCache::Commit(const ttlib::textfile& file, const ttlib::cstr& dst)
+{
+    std::string contents;
+    for (auto& iter: file)
+    {
+        contents += iter;
+        contents += '\n';
+    }
+    return Commit(contents.data(), contents.size(), dst);
+}
+
+std::string NormalizePath(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    auto full_path = std::filesystem::absolute(path, ec);
+    auto result = (ec ? path : full_path.lexically_normal()).generic_u8string();
+    while (result.size() > 1 && result.back() == '/')
+        result.pop_back();
+    return result;
+}
+
+bool ReadFileBytes(const ttlib::cstr& filename, std::string& contents)
+{
+    std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+
+    auto size = file.tellg();
+    if (size < 0)
+        return false;
+    contents.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    if (size > 0)
+        file.read(contents.data(), size);
+    CTrace::Count(TRACE_COUNTER::bytes_read, static_cast<int64_t>(size));
+    return file.good() || file.eof();
+}
+
+bool WriteIfChanged(const ttlib::cstr& filename, const void* data, size_t size)
+{
+    std::error_code ec;
+    CTrace::Count(TRACE_COUNTER::files_stat);
+    if (std::filesystem::file_size(filename.c_str(), ec) == size && !ec)
+    {
+        std::string current;
+        if (ReadFileBytes(filename, current) && (size == 0 || memcmp(current.data(), data, size) == 0))
+            return true;  // Leave the timestamp alone so that ninja's restat can prune everything that depends on it
+    }
+
+    return WriteFileAtomic(filename, data, size);
+}
+
+bool WriteFileAtomic(const ttlib::cstr& filename, const void* data, size_t size)
+{
+    // The process id keeps ninja jobs apart, and the sequence number keeps threads within this process apart.
+    static std::atomic<size_t> s_sequence { 0 };
+
+    ttlib::cstr tmp_file(filename);
+    tmp_file << '.' << static_cast<size_t>(wxGetProcessId()) << '.' << s_sequence.fetch_add(1) << ".tmp";
+
+    std::error_code ec;
+    {
+        std::ofstream file(tmp_file.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(static_cast<const char*>(data), size);
+        if (!file.good())
+        {
+            file.close();
+            std::filesystem::remove(tmp_file.c_str(), ec);
+            return false;
+        }
+    }
+
+    // rename() replaces an existing file on all platforms (MoveFileEx with MOVEFILE_REPLACE_EXISTING on Windows)
+    std::filesystem::rename(tmp_file.c_str(), filename.c_str(), ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmp_file.c_str(), ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Content-addressed cache for -hgz, -png and -xpm conversions
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tttextfile_wx.h"  // Classes for reading and writing line-oriented files
+
+// The ninja rules for asset conversion get rerun whenever ninja thinks the source is dirty, which happens after a branch
+// switch, a fresh checkout, or just touching the file. This class lets the converter skip the actual compression when the
+// input bytes haven't changed by storing the generated header under a key computed from the input contents, the codec,
+// the compression level and the ttBld version.
+//
+// The output file is only written if its contents actually change -- combined with "restat = 1" in the ninja rule, this
+// prevents every source file that #includes the header from being recompiled.
+class CAssetCache
+{
+public:
+    // An empty cache_dir disables the cache -- Fetch() will always fail, and Commit() will only write the output file.
+    CAssetCache(std::string_view cache_dir);
+
+    bool IsEnabled() const { return !m_cache_dir.empty(); }
+
+    // Computes the key for this conversion. Returns false if any of the source files cannot be read.
+    bool ComputeKey(std::string_view codec, int level, const std::vector<ttlib::cstr>& sources, std::string_view dst);
+
+    // If a previously generated header matches the current key, it is copied to dst (if dst is different) and true
+    // is returned.
+    bool Fetch(const ttlib::cstr& dst);
+
+    // Writes the generated header to dst if it differs from what is already there, and stores it in the cache.
+    bool Commit(const void* data, size_t size, const ttlib::cstr& dst);
+    bool Commit(const ttlib::textfile& file, const ttlib::cstr& dst);
+
+    const ttlib::cstr& GetKey() const { return m_key; }
+
+protected:
+    void HashBytes(const void* data, size_t size);
+    void HashString(std::string_view str);
+    bool HashFile(const ttlib::cstr& filename);
+
+private:
+    ttlib::cstr m_cache_dir;
+    ttlib::cstr m_cache_file;
+    ttlib::cstr m_key;
+
+    uint64_t m_hash;
+    uint64_t m_total_size { 0 };
+};
+
+// FNV-1a (64-bit) -- we only need to detect changes, not resist tampering, so there's no need for anything heavier.
+// Pass the previous result as hash to continue hashing additional data.
+constexpr uint64_t FNV1A_OFFSET = 0xcbf29ce484222325ULL;
+uint64_t HashFnv1a(std::string_view data, uint64_t hash = FNV1A_OFFSET);
+
+// Returns the absolute, lexically normal form of path with forward slashes and no trailing slash, so that two spellings
+// of the same path compare equal. path is returned unchanged (other than the slashes) if it can't be made absolute.
+std::string NormalizePath(const std::filesystem::path& path);
+
+// Reads a file into a string. Returns false if the file cannot be opened.
+bool ReadFileBytes(const ttlib::cstr& filename, std::string& contents);
+
+// Writes data to a temporary file in the same directory and then renames it to filename, so that another thread or
+// process never sees a partially written file. Returns false if the file could not be written.
+bool WriteFileAtomic(const ttlib::cstr& filename, const void* data, size_t size);
+
+// Writes data to filename (using WriteFileAtomic) unless filename already contains exactly the same bytes. Returns
+// false only if the file needed to be written and could not be.
+bool WriteIfChanged(const ttlib::cstr& filename, const void* data, size_t size);
@@ -50,6 +50,14 @@ bool MakeNewProject(ttlib::cstr& projectFile)
     return true;
 }
 
+void CConvert::ReportError(const ttlib::cstr& msg)
+{
+    if (m_isBatchMode)
+        m_errors.emplace_back(msg);
+    else
+        appMsgBox(msg);
+}
+
 bld::RESULT CConvert::ConvertSrcfiles(const std::string& srcFile, std::string_view dstFile)
 {
     CSrcFiles srcOrg;
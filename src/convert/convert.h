@@ -11,7 +11,19 @@
 
 #include "../pugixml/pugixml.hpp"  // pugixml parser
 
-#include "writesrc.h"  // CWriteSrcFiles -- Writes a new or update srcfiles.yaml file
+#include "mappedfile.h"  // CMappedFile -- Private, copy-on-write memory mapping of a file
+#include "writesrc.h"    // CWriteSrcFiles -- Writes a new or update srcfiles.yaml file
+#include "xmlarena.h"    // CXmlArena -- Bump allocator for pugixml documents
+
+// Build-speed features that CMakeLists.txt can enable. Everything is off by default.
+struct CMakeSpeedOptions
+{
+    size_t unity_batch_size { 0 };  // 0 disables unity builds
+    bool use_launcher { false };    // use ccache or sccache if either is installed
+
+    // Empty, "auto" (mold or lld if installed, not used with MSVC), or any CMAKE_LINKER_TYPE value such as lld or mold
+    ttlib::cstr linker;
+};
 
 class CConvert
 {
@@ -28,11 +40,34 @@ public:
     bld::RESULT WriteCmakeProject();
     bld::RESULT ConvertToCmakeProject(ttlib::cstr& projectFile);
 
+    // Converts a single project file (.vcxproj, .vcproj, .dsp or CodeLite .project), writing both .srcfiles.yaml and
+    // CMakeLists.txt into dstDir. This does not change the current directory and never displays UI, so multiple
+    // CConvert instances can call it concurrently.
+    bld::RESULT ConvertProject(const ttlib::cstr& projectFile, const ttlib::cstr& dstDir);
+
     void DontCreateSrcFiles() { m_CreateSrcFiles = false; }
 
+    // Sets the BuildLibs: value written to .srcfiles.yaml -- used when converting a solution where the project
+    // references other projects.
+    void SetBuildLibs(std::string_view libs) { m_srcfiles.setOptValue(OPT::BUILD_LIBS, libs); }
+
+    void SetCMakeOptions(const CMakeSpeedOptions& options) { m_cmake_options = options; }
+
+    // Instead of building its own precompiled header, the target will use the one built for target. The caller is
+    // responsible for making certain both targets use the same header and compiler flags.
+    void SetPchReuseFrom(std::string_view target) { m_pch_reuse_from = target; }
+
+    // In batch mode, errors are stored rather than displayed, and no progress messages are written to std::cout.
+    void SetBatchMode() { m_isBatchMode = true; }
+    const std::vector<ttlib::cstr>& GetErrors() const { return m_errors; }
+
 protected:
+    // Converts a filename relative to the project file into a filename relative to the destination directory
     void MakeNameRelative(ttlib::cstr& filename);
 
+    // Displays msg in a message box unless batch mode is enabled, in which case it is added to m_errors
+    void ReportError(const ttlib::cstr& msg);
+
     void ProcessVcxDebug(pugi::xml_node node);
     void ProcessVcxRelease(pugi::xml_node node);
 
@@ -45,7 +80,17 @@ protected:
     // Adds CSrcFiles::m_lstSrcFiles and CSrcFiles::m_lstDebugFiles with no comments
     void CMakeAddFiles(ttlib::textfile& out);
 
+    // Adds the compiler launcher and linker selection -- these must precede any target
+    void CMakeAddToolchainSpeedups(ttlib::textfile& out);
+
+    // Adds every library in BuildLibs: with add_subdirectory(), creating the library's CMakeLists.txt from its
+    // .srcfiles.yaml if needed. Returns the library target names.
+    std::vector<ttlib::cstr> CMakeAddBuildLibs(ttlib::textfile& out);
+
 private:
+    // m_xmlarena and m_xmlmapping must be declared before m_xmldoc so that the document is destroyed first
+    CXmlArena m_xmlarena;
+    CMappedFile m_xmlmapping;
     pugi::xml_document m_xmldoc;
     CWriteSrcFiles m_srcfiles;
 
@@ -53,7 +98,16 @@ private:
     ttlib::cstr m_dstFile;
     ttlib::cstr m_srcDir;
     ttlib::cstr m_dstDir;
+    ttlib::cstr m_pch_reuse_from;
+
+    CMakeSpeedOptions m_cmake_options;
+
+    std::vector<ttlib::cstr> m_errors;
+
+    // Absolute directories of the projects whose BuildLibs: led to this one -- used to detect circular references
+    std::vector<ttlib::cstr> m_lib_chain;
 
     bool m_CreateSrcFiles { true };
     bool m_isConvertToCmake { false };
+    bool m_isBatchMode { false };
 };
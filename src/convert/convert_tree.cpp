@@ -0,0 +1,237 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Convert every project file in a directory tree
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+#include "convert.h"     // CConvert -- Class for converting project build files to .srcfiles.yaml
+#include "gitignore.h"   // CGitIgnore -- Compiled .gitignore and .git/info/exclude matcher
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "threadpool.h"  // CThreadPool -- Simple fixed-size thread pool for running independent tasks
+#include "ttconsole.h"   // concolor -- Sets/restores console foreground color
+
+namespace fs = std::filesystem;
+
+// clang-format off
+
+// If the same project exists in more than one format, only the first one listed here is converted.
+static constexpr const char* lstProjectExtensions[] = {
+
+    ".vcxproj",
+    ".vcproj",
+    ".dsp",
+    ".project",  // CodeLite
+
+};
+
+// clang-format on
+
+static size_t GetProjectPriority(const fs::path& path)
+{
+    auto ext = path.extension().u8string();
+    for (size_t idx = 0; idx < std::size(lstProjectExtensions); ++idx)
+    {
+        if (ttlib::is_sameas(ext, lstProjectExtensions[idx], tt::CASE::either))
+            return idx;
+    }
+    return tt::npos;
+}
+
+bld::RESULT CConvert::ConvertProject(const ttlib::cstr& projectFile, const ttlib::cstr& dstDir)
+{
+    m_dstDir = dstDir;
+    m_dstDir.addtrailingslash();
+
+    ttlib::cstr dstFile(m_dstDir);
+    dstFile << ".srcfiles.yaml";
+
+    ttlib::cstr project_name = projectFile.filename();
+    project_name.remove_extension();
+    m_srcfiles.setOptValue(OPT::PROJECT, project_name);
+
+    bld::RESULT result = bld::failure;
+    auto extension = projectFile.extension();
+    if (extension.is_sameas(".vcxproj", tt::CASE::either))
+        result = ConvertVcx(projectFile, dstFile);
+    else if (extension.is_sameas(".vcproj", tt::CASE::either))
+        result = ConvertVc(projectFile, dstFile);
+    else if (extension.is_sameas(".dsp", tt::CASE::either))
+        result = ConvertDsp(projectFile, dstFile);
+    else if (extension.is_sameas(".project", tt::CASE::either))
+        result = ConvertCodeLite(projectFile, dstFile);
+    else
+        ReportError(ttlib::cstr() << projectFile << " is not a recognized project file");
+
+    if (result != bld::success)
+    {
+        if (result == bld::write_failed)
+            ReportError(ttlib::cstr() << "Unable to write " << dstFile);
+        else if (m_errors.empty())
+            ReportError(ttlib::cstr() << "Unable to convert " << projectFile);
+        return result;
+    }
+
+    // Everything in m_srcfiles is now relative to m_dstDir, and WriteCmakeProject() must not try to adjust the paths
+    // again based on the location of the original project file.
+    m_isConvertToCmake = true;
+    m_srcFile.clear();
+    m_srcDir.clear();
+    m_dstDir = dstDir;
+
+    return WriteCmakeProject();
+}
+
+// Recursively finds every project file under dir, and converts them on a thread pool. Every project is written to the
+// same directory as the project file unless there are multiple projects in the same directory, in which case each
+// project is written to a subdirectory with the project's name.
+//
+// If isDryRun is true, nothing is written: with -json each conversion is recorded in the plan, otherwise the projects
+// that would be converted are listed.
+//
+// Returns 0 if every project was converted successfully.
+int ConvertProjectTree(const ttlib::cstr& dir, const CMakeSpeedOptions& options, bool isDryRun)
+{
+    std::error_code ec;
+    if (!fs::is_directory(fs::u8path(dir.c_str()), ec))
+    {
+        std::cerr << dir << " is not a directory" << '\n';
+        return 1;
+    }
+
+    // directory -> (project name -> project file)
+    std::map<fs::path, std::map<ttlib::cstr, fs::path>> projects;
+
+    // Build output directories are normally ignored by git, and can contain a very large number of files
+    auto gitignore = CGitIgnore::Get(dir);
+
+    auto options = fs::directory_options::skip_permission_denied;
+    for (auto iter = fs::recursive_directory_iterator(fs::u8path(dir.c_str()), options, ec);
+         iter != fs::recursive_directory_iterator(); iter.increment(ec))
+    {
+        if (ec)
+            break;
+
+        auto& path = iter->path();
+        if (iter->is_directory(ec))
+        {
+            // Skip .git, .vs, etc. and anything git ignores
+            auto name = path.filename().u8string();
+            if ((name.size() && name[0] == '.') || gitignore->IsIgnored(path.u8string(), true))
+                iter.disable_recursion_pending();
+            continue;
+        }
+
+        auto priority = GetProjectPriority(path);
+        if (priority == tt::npos)
+            continue;
+
+        ttlib::cstr name = path.stem().u8string();
+        auto& dir_projects = projects[path.parent_path()];
+        if (auto found = dir_projects.find(name);
+            found == dir_projects.end() || priority < GetProjectPriority(found->second))
+        {
+            dir_projects[name] = path;
+        }
+    }
+
+    if (ec)
+    {
+        std::cerr << "Unable to read " << dir << ": " << ec.message() << '\n';
+        return 1;
+    }
+
+    struct Job
+    {
+        ttlib::cstr project;
+        ttlib::cstr dst_dir;
+        std::vector<ttlib::cstr> errors;
+        bld::RESULT result { bld::failure };
+    };
+
+    std::vector<Job> jobs;
+    for (auto& [proj_dir, dir_projects]: projects)
+    {
+        for (auto& [name, file]: dir_projects)
+        {
+            auto& job = jobs.emplace_back();
+            job.project = fs::absolute(file, ec).lexically_normal().u8string();
+
+            auto dst = fs::absolute(proj_dir, ec).lexically_normal();
+            if (dir_projects.size() > 1)
+                dst /= fs::u8path(name.c_str());
+            job.dst_dir = dst.u8string();
+        }
+    }
+
+    if (jobs.empty())
+    {
+        std::cout << "No project files found in " << dir << '\n';
+        return 0;
+    }
+
+    // Only the plan can record what a conversion would write, so without it there's nothing more a dry run can report
+    if (isDryRun && !CPlan::Get().IsEnabled())
+    {
+        for (auto& job: jobs)
+            std::cout << "Would convert " << job.project << " to " << job.dst_dir << '\n';
+        return 0;
+    }
+
+    std::cout << "Converting " << jobs.size() << " projects..." << '\n';
+
+    {
+        CThreadPool pool;
+        for (auto& job: jobs)
+        {
+            pool.Add(
+                [&job, &options]()
+                {
+                    if (!CPlan::Get().AddDirectory(job.dst_dir, "project output directory"))
+                    {
+                        std::error_code ec_dir;
+                        fs::create_directories(fs::u8path(job.dst_dir.c_str()), ec_dir);
+                    }
+
+                    CConvert convert;
+                    convert.SetBatchMode();
+                    convert.SetCMakeOptions(options);
+                    job.result = convert.ConvertProject(job.project, job.dst_dir);
+                    job.errors = convert.GetErrors();
+                });
+        }
+        pool.Wait();
+    }
+
+    size_t failures = 0;
+    for (auto& job: jobs)
+    {
+        if (job.result == bld::success)
+            continue;
+
+        if (!failures)
+        {
+            ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+            std::cout << '\n' << "The following projects could not be converted:" << '\n';
+        }
+        ++failures;
+
+        std::cout << "  " << job.project << '\n';
+        for (auto& iter: job.errors)
+        {
+            std::cout << "      " << iter << '\n';
+        }
+    }
+
+    std::cout << '\n'
+              << "Converted " << (jobs.size() - failures) << " of " << jobs.size() << " projects";
+    if (failures)
+        std::cout << " (" << failures << " failed)";
+    std::cout << '\n';
+
+    return (failures ? 1 : 0);
+}
@@ -32,14 +32,13 @@ bld::RESULT CConvert::ConvertCodeLite(const std::string& srcFile, std::string_vi
     m_dstDir.make_absolute();
     m_dstDir.remove_filename();
 
-    std::wstring str16;
-    ttlib::utf8to16(srcFile, str16);
-    // auto result = m_xmldoc.load_file(str16.c_str());
-    auto result = m_xmldoc.load_file(srcFile.c_str());
+    // The previous document must be released before its mapping is replaced.
+    m_xmldoc.reset();
+    auto result = LoadXmlInPlace(srcFile, m_xmlmapping, m_xmldoc);
 
     if (!result)
     {
-        appMsgBox("Cannot open " + m_srcFile + "\n\n" + result.description());
+        ReportError("Cannot open " + m_srcFile + "\n\n" + result.description());
         return bld::RESULT::read_failed;
     }
 
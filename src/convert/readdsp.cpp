@@ -44,7 +44,7 @@ bld::RESULT CConvert::ConvertDsp(const std::string& srcFile, std::string_view ds
     ttlib::textfile fileIn;
     if (!fileIn.ReadFile(srcFile))
     {
-        appMsgBox("Cannot open " + srcFile);
+        ReportError("Cannot open " + srcFile);
         return bld::RESULT::read_failed;
     }
 
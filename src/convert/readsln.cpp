@@ -0,0 +1,530 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Convert a Visual Studio .sln file into a CMake workspace
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+
+#include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
+
+#include "convert.h"     // CConvert -- Class for converting project build files to .srcfiles.yaml
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "threadpool.h"  // CThreadPool -- Simple fixed-size thread pool for running independent tasks
+#include "ttconsole.h"   // concolor -- Sets/restores console foreground color
+#include "xmlstream.h"   // CXmlStream -- Single-pass XML reader that only keeps the elements a converter needs
+
+namespace fs = std::filesystem;
+
+struct SlnProject
+{
+    ttlib::cstr name;  // project filename without the extension -- this is also the CMake target name
+    ttlib::cstr guid;  // upper-case GUID including the braces
+    fs::path file;
+    fs::path dst_dir;  // where .srcfiles.yaml and CMakeLists.txt are written
+
+    std::set<ttlib::cstr> depends;  // GUIDs of projects this project must be linked with or built after
+    std::vector<ttlib::cstr> errors;
+
+    // Absolute path to the precompiled header followed by everything that affects how it is compiled. Projects with
+    // the same signature can share a single precompiled header.
+    ttlib::cstr pch_signature;
+
+    bld::RESULT result { bld::failure };
+    bool is_library { false };
+};
+
+// GUIDs are compared case-insensitively
+static ttlib::cstr MakeUpper(std::string_view str)
+{
+    ttlib::cstr result(str);
+    for (auto& ch: result)
+        ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    return result;
+}
+
+// Returns every double-quoted string in line.
+static std::vector<std::string_view> GetQuotedStrings(std::string_view line)
+{
+    std::vector<std::string_view> strings;
+    for (auto start = line.find('"'); start != std::string_view::npos; start = line.find('"', start))
+    {
+        auto end = line.find('"', start + 1);
+        if (end == std::string_view::npos)
+            break;
+        strings.emplace_back(line.substr(start + 1, end - start - 1));
+        start = end + 1;
+    }
+    return strings;
+}
+
+// Reads the Project() entries and their ProjectDependencies sections. Solution folders and non-C++ projects are
+// ignored.
+static bool ReadSolution(const ttlib::cstr& slnFile, std::vector<SlnProject>& projects)
+{
+    ttlib::viewfile in;
+    if (!in.ReadFile(slnFile))
+    {
+        std::cerr << "Cannot open " << slnFile << '\n';
+        return false;
+    }
+
+    auto sln_dir = fs::absolute(fs::u8path(slnFile.c_str())).parent_path();
+
+    SlnProject* cur_project = nullptr;
+    bool in_dependencies = false;
+
+    for (auto& iter: in)
+    {
+        std::string_view line = iter;
+        while (line.size() && (line.front() == ' ' || line.front() == '\t'))
+            line.remove_prefix(1);
+
+        if (line.rfind("Project(", 0) == 0)
+        {
+            cur_project = nullptr;
+
+            // Project("{type GUID}") = "Name", "path\Name.vcxproj", "{project GUID}"
+            auto strings = GetQuotedStrings(line);
+            if (strings.size() < 4)
+                continue;
+
+            ttlib::cstr path(strings[2]);
+            path.backslashestoforward();
+            if (!path.extension().is_sameas(".vcxproj", tt::CASE::either))
+                continue;
+
+            auto& project = projects.emplace_back();
+            project.file = (sln_dir / fs::u8path(path.c_str())).lexically_normal();
+            project.name = project.file.stem().u8string();
+            project.guid = MakeUpper(strings[3]);
+            cur_project = &project;
+        }
+        else if (line.rfind("EndProject", 0) == 0 && line.rfind("EndProjectSection", 0) != 0)
+        {
+            cur_project = nullptr;
+            in_dependencies = false;
+        }
+        else if (cur_project && line.rfind("ProjectSection(ProjectDependencies)", 0) == 0)
+        {
+            in_dependencies = true;
+        }
+        else if (line.rfind("EndProjectSection", 0) == 0)
+        {
+            in_dependencies = false;
+        }
+        else if (cur_project && in_dependencies)
+        {
+            // {GUID} = {GUID}
+            if (auto end = line.find('}'); line.size() && line.front() == '{' && end != std::string_view::npos)
+                cur_project->depends.emplace(MakeUpper(line.substr(0, end + 1)));
+        }
+    }
+
+    return true;
+}
+
+// Sets project.pch_signature if the project's Debug configuration uses a precompiled header that can be found.
+static void ReadPchSignature(SlnProject& project, pugi::xml_node debug_group, pugi::xml_node release_group)
+{
+    auto compile = debug_group.child("ClCompile");
+    ttlib::cstr pch(compile.child("PrecompiledHeaderFile").first_child().value());
+    if (pch.empty())
+        return;
+
+    // Every project has its own "pch.h" or "stdafx.h", so the header can only be shared if it is the same file.
+    pch.backslashestoforward();
+    auto pch_path = (project.file.parent_path() / fs::u8path(pch.c_str())).lexically_normal();
+    std::error_code ec;
+    if (!fs::exists(pch_path, ec))
+        return;
+
+    project.pch_signature << pch_path.generic_u8string() << '|'
+                          << compile.child("PreprocessorDefinitions").first_child().value() << '|'
+                          << compile.child("AdditionalOptions").first_child().value();
+    if (auto release_compile = release_group.child("ClCompile"); release_compile)
+    {
+        project.pch_signature << '|' << release_compile.child("PreprocessorDefinitions").first_child().value() << '|'
+                              << release_compile.child("AdditionalOptions").first_child().value();
+    }
+}
+
+// Reads the ProjectReference items, the ConfigurationType and the precompiled header settings from the project file.
+// This only loads the project -- the actual conversion is done later, once the BuildLibs: for every project is known.
+static void ReadProjectReferences(SlnProject& project, const std::map<ttlib::cstr, SlnProject*>& by_path)
+{
+    CXmlArena arena;
+    pugi::xml_document doc;
+    CXmlStream stream({ "Project/ItemGroup/ProjectReference", "Project/PropertyGroup/ConfigurationType",
+                        "Project/ItemDefinitionGroup/ClCompile" });
+    {
+        CXmlArena::Scope arena_scope(arena);
+        if (!stream.LoadFile(project.file.u8string(), doc))
+        {
+            project.errors.emplace_back() << "Cannot open " << project.file.u8string() << ": " << stream.GetError();
+            return;
+        }
+    }
+
+    bool found_type = false;
+    pugi::xml_node debug_group;
+    pugi::xml_node release_group;
+    for (auto child: doc.child("Project").children())
+    {
+        ttlib::sview name = child.name();
+        if (name.is_sameas("ItemDefinitionGroup"))
+        {
+            ttlib::cstr condition = child.attribute("Condition").value();
+            if (condition.contains("Debug|") && !debug_group)
+                debug_group = child;
+            else if (condition.contains("Release|") && !release_group)
+                release_group = child;
+        }
+        else if (name.is_sameas("PropertyGroup") && !found_type)
+        {
+            if (auto type = child.child("ConfigurationType"); type)
+            {
+                ttlib::sview val = type.first_child().value();
+                project.is_library = (val.is_sameas("StaticLibrary", tt::CASE::either) ||
+                                      val.is_sameas("DynamicLibrary", tt::CASE::either));
+                found_type = true;
+            }
+        }
+        else if (name.is_sameas("ItemGroup"))
+        {
+            for (auto node: child.children("ProjectReference"))
+            {
+                if (auto guid = node.child("Project").first_child().value(); guid.size())
+                {
+                    project.depends.emplace(MakeUpper(guid));
+                    continue;
+                }
+
+                // Older projects may not have a <Project> child, in which case the only way to identify the project is
+                // by its path.
+                ttlib::cstr include(node.attribute("Include").value());
+                if (include.empty())
+                    continue;
+                include.backslashestoforward();
+                auto ref_path = (project.file.parent_path() / fs::u8path(include.c_str())).lexically_normal();
+                if (auto found = by_path.find(ref_path.u8string()); found != by_path.end())
+                    project.depends.emplace(found->second->guid);
+            }
+        }
+    }
+
+    if (debug_group)
+        ReadPchSignature(project, debug_group, release_group);
+}
+
+// Returns the projects ordered so that every project comes after the projects it depends on. If there is a circular
+// dependency, the remaining projects are added in solution order.
+static std::vector<SlnProject*> SortProjects(std::vector<SlnProject>& projects,
+                                             const std::map<ttlib::cstr, SlnProject*>& by_guid)
+{
+    std::vector<SlnProject*> sorted;
+    std::set<SlnProject*> added;
+
+    while (sorted.size() < projects.size())
+    {
+        bool progress = false;
+        for (auto& project: projects)
+        {
+            if (added.count(&project))
+                continue;
+
+            bool ready = true;
+            for (auto& guid: project.depends)
+            {
+                if (auto found = by_guid.find(guid); found != by_guid.end() && !added.count(found->second))
+                {
+                    ready = false;
+                    break;
+                }
+            }
+
+            if (ready)
+            {
+                sorted.emplace_back(&project);
+                added.emplace(&project);
+                progress = true;
+            }
+        }
+
+        if (!progress)
+        {
+            ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+            std::cout << "Circular project dependency -- the following projects may be built in the wrong order:"
+                      << '\n';
+            for (auto& project: projects)
+            {
+                if (!added.count(&project))
+                {
+                    std::cout << "  " << project.name << '\n';
+                    sorted.emplace_back(&project);
+                }
+            }
+            break;
+        }
+    }
+
+    return sorted;
+}
+
+// Converts every .vcxproj in a Visual Studio solution to .srcfiles.yaml and CMakeLists.txt, then creates a
+// CMakeLists.txt next to the .sln that adds each project in dependency order and links the libraries each project
+// references. Each .srcfiles.yaml gets a BuildLibs: entry for the libraries it references, so the dependencies are
+// also preserved when building with ninja.
+//
+// If isDryRun is true, nothing is written: with -json each conversion is recorded in the plan, otherwise the projects
+// that would be converted are listed in build order.
+//
+// Returns 0 if every project was converted successfully.
+int ConvertSolution(const ttlib::cstr& slnFile, const CMakeSpeedOptions& options, bool isDryRun)
+{
+    std::vector<SlnProject> projects;
+    if (!ReadSolution(slnFile, projects))
+        return 1;
+
+    if (projects.empty())
+    {
+        std::cout << "No .vcxproj files found in " << slnFile << '\n';
+        return 0;
+    }
+
+    auto sln_dir = fs::absolute(fs::u8path(slnFile.c_str())).parent_path().lexically_normal();
+
+    std::map<ttlib::cstr, SlnProject*> by_guid;
+    std::map<ttlib::cstr, SlnProject*> by_path;
+    std::map<fs::path, size_t> dir_count;
+    std::set<ttlib::cstr> names;
+    for (auto& project: projects)
+    {
+        by_guid[project.guid] = &project;
+        by_path[project.file.u8string()] = &project;
+        ++dir_count[project.file.parent_path()];
+
+        if (!names.emplace(MakeUpper(project.name)).second)
+            project.errors.emplace_back() << "Another project in the solution is also named " << project.name;
+    }
+
+    // The top-level CMakeLists.txt is written next to the .sln file, so a project in the same directory, or one sharing
+    // a directory with other projects, is written to a subdirectory with the project's name.
+    for (auto& project: projects)
+    {
+        project.dst_dir = project.file.parent_path();
+        if (dir_count[project.dst_dir] > 1 || project.dst_dir == sln_dir)
+            project.dst_dir /= fs::u8path(project.name.c_str());
+    }
+
+    std::cout << "Converting " << projects.size() << " projects in " << slnFile << "..." << '\n';
+
+    CThreadPool pool;
+    for (auto& project: projects)
+    {
+        if (project.errors.size())
+            continue;
+        pool.Add([&project, &by_path]() { ReadProjectReferences(project, by_path); });
+    }
+    pool.Wait();
+
+    auto sorted = SortProjects(projects, by_guid);
+
+    // Only the plan can record what a conversion would write, so without it there's nothing more a dry run can report
+    if (isDryRun && !CPlan::Get().IsEnabled())
+    {
+        for (auto project: sorted)
+        {
+            if (project->errors.empty())
+                std::cout << "Would convert " << project->file.u8string() << " to " << project->dst_dir.u8string()
+                          << '\n';
+        }
+        return 0;
+    }
+
+    auto convert_project = [&pool, &options, &by_guid](SlnProject& project, const ttlib::cstr& reuse_from)
+    {
+        ttlib::cstr build_libs;
+        for (auto& guid: project.depends)
+        {
+            auto found = by_guid.find(guid);
+            if (found == by_guid.end() || !found->second->is_library)
+                continue;
+            if (build_libs.size())
+                build_libs << ';';
+            build_libs << found->second->dst_dir.lexically_relative(project.dst_dir).generic_u8string();
+        }
+
+        pool.Add(
+            [&project, &options, build_libs, reuse_from]()
+            {
+                if (!CPlan::Get().AddDirectory(project.dst_dir.u8string(), "project output directory"))
+                {
+                    std::error_code ec;
+                    fs::create_directories(project.dst_dir, ec);
+                }
+
+                CConvert convert;
+                convert.SetBatchMode();
+                convert.SetCMakeOptions(options);
+                if (build_libs.size())
+                    convert.SetBuildLibs(build_libs);
+                if (reuse_from.size())
+                    convert.SetPchReuseFrom(reuse_from);
+                project.result = convert.ConvertProject(project.file.u8string(), project.dst_dir.u8string());
+                project.errors = convert.GetErrors();
+            });
+    };
+
+    // The first project (in build order) using a precompiled header that converts successfully compiles it, and every
+    // other project with the same header and the same compiler settings reuses it. A project that fails to convert has
+    // no target to reuse, so the projects sharing its header wait until one of them has converted. If none of them
+    // can be converted, each project keeps its own precompiled header.
+    std::map<ttlib::cstr, std::deque<SlnProject*>> pch_waiting;
+    for (auto project: sorted)
+    {
+        if (project->errors.size())
+            continue;
+        if (project->pch_signature.empty())
+            convert_project(*project, {});
+        else
+            pch_waiting[project->pch_signature].push_back(project);
+    }
+
+    std::map<ttlib::cstr, SlnProject*> pch_candidates;
+    while (pch_waiting.size())
+    {
+        for (auto& [signature, waiting]: pch_waiting)
+        {
+            pch_candidates[signature] = waiting.front();
+            waiting.pop_front();
+            convert_project(*pch_candidates[signature], {});
+        }
+        pool.Wait();
+
+        for (auto iter = pch_waiting.begin(); iter != pch_waiting.end();)
+        {
+            auto owner = pch_candidates[iter->first];
+            if (owner->result == bld::success)
+            {
+                for (auto project: iter->second)
+                    convert_project(*project, owner->name);
+                iter = pch_waiting.erase(iter);
+            }
+            else if (iter->second.empty())
+            {
+                iter = pch_waiting.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+    pool.Wait();
+
+    ttlib::textfile out;
+    out += "cmake_minimum_required(VERSION 3.20)";
+    out += "";
+    out.emplace_back(ttlib::cstr() << "project(" << fs::u8path(slnFile.c_str()).stem().u8string() << " LANGUAGES CXX)");
+    out += "";
+
+    out += "# Projects are added in dependency order";
+    for (auto project: sorted)
+    {
+        if (project->result != bld::success)
+            continue;
+
+        auto rel_dir = project->dst_dir.lexically_relative(sln_dir).generic_u8string();
+        if (rel_dir.rfind("..", 0) == 0)
+        {
+            // Directories outside of the source tree need an explicit binary directory
+            out.emplace_back(ttlib::cstr() << "add_subdirectory(" << rel_dir << ' ' << project->name << ')');
+        }
+        else
+        {
+            out.emplace_back(ttlib::cstr() << "add_subdirectory(" << rel_dir << ')');
+        }
+    }
+
+    bool need_blank_line = true;
+    for (auto project: sorted)
+    {
+        if (project->result != bld::success)
+            continue;
+
+        ttlib::cstr libs;
+        ttlib::cstr targets;
+        for (auto& guid: project->depends)
+        {
+            auto found = by_guid.find(guid);
+            if (found == by_guid.end() || found->second->result != bld::success)
+                continue;
+            (found->second->is_library ? libs : targets) << ' ' << found->second->name;
+        }
+
+        if (need_blank_line && (libs.size() || targets.size()))
+        {
+            out += "";
+            need_blank_line = false;
+        }
+
+        if (libs.size())
+            out.emplace_back(ttlib::cstr() << "target_link_libraries(" << project->name << " PRIVATE" << libs << ')');
+
+        // A reference to an executable only means it must be built first
+        if (targets.size())
+            out.emplace_back(ttlib::cstr() << "add_dependencies(" << project->name << targets << ')');
+    }
+
+    ttlib::cstr out_name = (sln_dir / "CMakeLists.txt").u8string();
+    if (ttlib::file_exists(out_name))
+    {
+        out_name.replace_extension(".ttbld");
+    }
+
+    int exit_code = 0;
+    if (CPlan::Get().Add(out_name, out, "CMake solution project"))
+    {
+        // The file is only recorded in the plan
+    }
+    else if (!out.WriteFile(out_name))
+    {
+        std::cerr << "Cannot write to " << out_name << '\n';
+        exit_code = 1;
+    }
+    else
+    {
+        std::cout << "Created " << out_name << '\n';
+    }
+
+    size_t failures = 0;
+    for (auto& project: projects)
+    {
+        if (project.result == bld::success)
+            continue;
+
+        if (!failures)
+        {
+            ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+            std::cout << '\n' << "The following projects could not be converted:" << '\n';
+        }
+        ++failures;
+
+        std::cout << "  " << project.file.u8string() << '\n';
+        for (auto& iter: project.errors)
+        {
+            std::cout << "      " << iter << '\n';
+        }
+    }
+
+    std::cout << "Converted " << (projects.size() - failures) << " of " << projects.size() << " projects" << '\n';
+
+    return (failures ? 1 : exit_code);
+}
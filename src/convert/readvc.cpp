@@ -8,7 +8,8 @@
 #include "ttcwd.h"          // cwd -- Class for storing and optionally restoring the current directory
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 
-#include "convert.h"  // CConvert, CVcxWrite
+#include "convert.h"    // CConvert, CVcxWrite
+#include "xmlstream.h"  // CXmlStream -- Single-pass XML reader that only keeps the elements a converter needs
 #include "uifuncs.h"  // Miscellaneous functions for displaying UI
 
 bld::RESULT CConvert::ConvertVc(const std::string& srcFile, std::string_view dstFile)
@@ -32,18 +33,28 @@ bld::RESULT CConvert::ConvertVc(const std::string& srcFile, std::string_view dst
     m_dstDir.make_absolute();
     m_dstDir.remove_filename();
 
-    std::wstring str16;
-    ttlib::utf8to16(srcFile, str16);
-    // auto result = m_xmldoc.load_file(str16.c_str());
-    auto result = m_xmldoc.load_file(srcFile.c_str());
+    // Generated .vcproj files can be huge, but nearly all of that is per-file configuration data that is never used.
+    // Only the elements queried below are loaded, so memory use doesn't depend on how large the project file is.
+    CXmlStream stream({ "VisualStudioProject/Files/Filter/File@", "VisualStudioProject/Configurations" });
 
-    if (!result)
+    // The arena is only active while the document is loaded -- the static queries below must not be allocated from it.
+    m_xmldoc.reset();
+    m_xmlarena.Reset();
     {
-        appMsgBox("Cannot open " + m_srcFile + "\n\n" + result.description());
-        return bld::RESULT::read_failed;
+        CXmlArena::Scope arena_scope(m_xmlarena);
+        if (!stream.LoadFile(srcFile, m_xmldoc))
+        {
+            ReportError("Cannot open " + m_srcFile + "\n\n" + stream.GetError());
+            return bld::RESULT::read_failed;
+        }
     }
 
-    auto files = m_xmldoc.select_nodes("/VisualStudioProject/Files/Filter[@Name]");
+    // The queries are compiled once rather than every time a project is converted. Evaluating a compiled query doesn't
+    // modify it, so this is safe when multiple projects are being converted concurrently.
+    static const pugi::xpath_query query_filters("/VisualStudioProject/Files/Filter[@Name]");
+    static const pugi::xpath_query query_configs("/VisualStudioProject/Configurations/Configuration[@Name]");
+
+    auto files = m_xmldoc.select_nodes(query_filters);
 
     for (size_t pos = 0; pos < files.size(); ++pos)
     {
@@ -85,7 +96,7 @@ bld::RESULT CConvert::ConvertVc(const std::string& srcFile, std::string_view dst
         }
     }
 
-    auto configs = m_xmldoc.select_nodes("/VisualStudioProject/Configurations/Configuration[@Name]");
+    auto configs = m_xmldoc.select_nodes(query_configs);
 
     // All Debug| sections are shared, so only need to process one of them.
     bool DebugProcessed = false;
@@ -5,13 +5,25 @@
 // License:   Apache License see ../../LICENSE
 /////////////////////////////////////////////////////////////////////////////
 
+#include <filesystem>
+
 #include "ttcwd.h"          // cwd -- Class for storing and optionally restoring the current directory
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 #include <ttstring_wx.h>    // ttString -- wxString with additional methods similar to ttlib::cstr
 
-#include "convert.h"  // CConvert, CVcxWrite
+#include "convert.h"    // CConvert, CVcxWrite
+#include "xmlstream.h"  // CXmlStream -- Single-pass XML reader that only keeps the elements a converter needs
 #include "uifuncs.h"  // Miscellaneous functions for displaying UI
 
+// Converts a directory (which may have a trailing slash) into a normalized path without a trailing separator.
+static std::filesystem::path DirToPath(const ttlib::cstr& dir)
+{
+    auto path = std::filesystem::u8path(dir.c_str()).lexically_normal();
+    if (!path.has_filename() && path.has_parent_path() && path != path.root_path())
+        path = path.parent_path();
+    return path;
+}
+
 bld::RESULT CConvert::ConvertVcx(const std::string& srcFile, std::string_view dstFile)
 {
     ttlib::cwd cwd;
@@ -40,27 +52,19 @@ bld::RESULT CConvert::ConvertVcx(const std::string& srcFile, std::string_view ds
         m_dstDir.remove_filename();
     }
 
-    std::wstring str16;
-    ttlib::utf8to16(srcFile, str16);
+    // Only the elements used below are loaded, so memory use doesn't depend on how large the project file is.
+    CXmlStream stream({ "Project/ItemGroup/ClCompile@", "Project/ItemDefinitionGroup",
+                        "Project/PropertyGroup/ConfigurationType" });
 
-    if (auto result = m_xmldoc.load_file(srcFile.c_str()); !result)
+    // Any previous document must be released before the arena it was allocated from can be reused.
+    m_xmldoc.reset();
+    m_xmlarena.Reset();
     {
-        appMsgBox(ttlib::cstr() << "Cannot open " << m_srcFile << "\n\n" << result.description());
-        return bld::RESULT::read_failed;
-    }
-
-    auto files = m_xmldoc.select_nodes("/Project/ItemGroup/ClCompile[@Include]");
-
-    for (size_t pos = 0; pos < files.size(); ++pos)
-    {
-        ttlib::cstr filename = files[pos].node().first_attribute().as_string();
-        if (filename.size())
+        CXmlArena::Scope arena_scope(m_xmlarena);
+        if (!stream.LoadFile(srcFile, m_xmldoc))
         {
-            // The filename will be relative to the location of the xml file, so first we need to make it relative to that.
-            // Since the .srcfiles may be in a different location, we then need to make the file relative to that.
-
-            MakeNameRelative(filename);
-            m_srcfiles.GetSrcFileList().emplace_back(filename);
+            ReportError(ttlib::cstr() << "Cannot open " << m_srcFile << "\n\n" << stream.GetError());
+            return bld::RESULT::read_failed;
         }
     }
 
@@ -68,25 +72,52 @@ bld::RESULT CConvert::ConvertVcx(const std::string& srcFile, std::string_view ds
     bool DebugProcessed = false;
     bool ReleaseProcessed = false;  // Same as Debug|, only one gets processed
 
-    auto configs = m_xmldoc.select_nodes("/Project/ItemDefinitionGroup[@Condition]");
-    for (size_t pos = 0; pos < configs.size(); ++pos)
+    ttlib::cstr configuration_type;
+
+    // Everything needed is a child of <Project>, so a single pass over its children replaces what used to be a separate
+    // XPath query (each of which had to be compiled and then walk the entire document) for each type of element.
+    for (auto child: m_xmldoc.child("Project").children())
     {
-        ttlib::cstr condition = configs[pos].node().first_attribute().value();
-        if (condition.empty())
-            continue;  // theoretically impossible
-        if (condition.contains("Debug|"))
+        ttlib::sview name = child.name();
+        if (name.is_sameas("ItemGroup"))
         {
-            if (DebugProcessed)
-                continue;
-            ProcessVcxDebug(configs[pos].node());
-            DebugProcessed = true;
+            for (auto item: child.children("ClCompile"))
+            {
+                ttlib::cstr filename = item.attribute("Include").as_string();
+                if (filename.size())
+                {
+                    // The filename will be relative to the location of the xml file, so first we need to make it
+                    // relative to that. Since the .srcfiles may be in a different location, we then need to make the
+                    // file relative to that.
+
+                    MakeNameRelative(filename);
+                    m_srcfiles.GetSrcFileList().emplace_back(filename);
+                }
+            }
         }
-        else if (condition.contains("Release|"))
+        else if (name.is_sameas("ItemDefinitionGroup"))
         {
-            if (ReleaseProcessed)
+            ttlib::cstr condition = child.attribute("Condition").value();
+            if (condition.empty())
                 continue;
-            ProcessVcxRelease(configs[pos].node());
-            ReleaseProcessed = true;
+            if (condition.contains("Debug|"))
+            {
+                if (DebugProcessed)
+                    continue;
+                ProcessVcxDebug(child);
+                DebugProcessed = true;
+            }
+            else if (condition.contains("Release|"))
+            {
+                if (ReleaseProcessed)
+                    continue;
+                ProcessVcxRelease(child);
+                ReleaseProcessed = true;
+            }
+        }
+        else if (name.is_sameas("PropertyGroup") && configuration_type.empty())
+        {
+            configuration_type = child.child("ConfigurationType").first_child().value();
         }
     }
 
@@ -99,30 +130,32 @@ bld::RESULT CConvert::ConvertVcx(const std::string& srcFile, std::string_view ds
         m_srcfiles.setOptValue(OPT::LIBS_REL, {});
     }
 
+    // Libraries don't have a SubSystem, so ConfigurationType is the only way to know the project isn't an executable.
+    if (configuration_type.is_sameas("StaticLibrary", tt::CASE::either))
+        m_srcfiles.setOptValue(OPT::EXE_TYPE, "lib");
+    else if (configuration_type.is_sameas("DynamicLibrary", tt::CASE::either))
+        m_srcfiles.setOptValue(OPT::EXE_TYPE, "dll");
+
     return (!m_isConvertToCmake ? m_srcfiles.WriteNew(m_dstFile) : bld::RESULT::success);
 }
 
 void CConvert::MakeNameRelative(ttlib::cstr& filename)
 {
-    if (m_dstDir.size())
-    {
-        ttString ws;
-        ws << filename.wx_str();
-        ws.make_absolute();
-        ws.make_relative(m_dstDir);
-        filename = ws.ToUTF8().data();
-        filename.backslashestoforward();
-        return;
-    }
+    // The filename is relative to the project file, not the current directory. This is computed lexically rather than
+    // calling make_absolute() so that the result doesn't depend on the current directory -- which is what allows
+    // projects to be converted concurrently.
 
-    filename.make_absolute();
-    filename.make_relative(m_srcDir);
-    if (m_dstDir.size())
-    {
-        filename.make_absolute();
-        filename.make_relative(m_dstDir);
-    }
     filename.backslashestoforward();
+    auto path = std::filesystem::u8path(filename.c_str());
+    if (path.is_relative())
+        path = DirToPath(m_srcDir) / path;
+    path = path.lexically_normal();
+
+    auto relative = path.lexically_relative(DirToPath(m_dstDir.size() ? m_dstDir : m_srcDir));
+    if (!relative.empty())
+        path = relative;
+
+    filename = path.generic_u8string();
 }
 
 void CConvert::ProcessVcxDebug(pugi::xml_node node)
@@ -5,14 +5,21 @@
 // License:   Apache License -- see ../../LICENSE
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <map>
+
 #include "ttcwd.h"          // cwd -- Class for storing and optionally restoring the current directory
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 #include <ttsview_wx.h>     // sview -- std::string_view with additional methods
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
+#include "assetcache.h"      // ReadFileBytes, WriteFileAtomic
 #include "convert.h"         // CConvert -- Class for converting project build files to .srcfiles.yaml
 #include "convertvs_base.h"  // ConvertVS -- Dialog to get file and path for VS to CMake conversion
 #include "csrcfiles.h"       // CSrcFiles
+#include "plan.h"            // CPlan -- Records every file ttBld would write without writing any of them
 #include "uifuncs.h"         // Miscellaneous functions for displaying UI
 
 #include "../pugixml/pugixml.hpp"  // pugixml parser
@@ -54,6 +61,88 @@ const char* preset_json = R"===({
 }
 )===";
 
+// When CMakeLists.txt already exists, only the lines between these markers are replaced. Everything else in the file
+// belongs to the user.
+constexpr const char* txt_region_begin = "# ttBld:begin ";
+constexpr const char* txt_region_end = "# ttBld:end ";
+
+// Returns the region name if line is a marker of the specified type, otherwise an empty view.
+static std::string_view GetRegionName(std::string_view line, std::string_view marker)
+{
+    while (line.size() && (line.front() == ' ' || line.front() == '\t'))
+        line.remove_prefix(1);
+    while (line.size() && (line.back() == '\n' || line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+        line.remove_suffix(1);
+    if (line.size() <= marker.size() || line.substr(0, marker.size()) != marker)
+        return {};
+    return line.substr(marker.size());
+}
+
+// Replaces the contents of every region in existing with the same region from generated -- a region that generated
+// doesn't have is emptied. Everything outside of the regions, including the line endings, is copied unchanged.
+//
+// Returns false if existing doesn't contain any regions, or if a region is missing its end marker.
+static bool UpdateCmakeRegions(std::string_view existing, const ttlib::textfile& generated, std::string& updated)
+{
+    std::map<std::string_view, std::vector<std::string_view>> regions;
+    std::vector<std::string_view>* cur_region = nullptr;
+    for (auto& iter: generated)
+    {
+        if (auto name = GetRegionName(iter, txt_region_begin); name.size())
+            cur_region = &regions[name];
+        else if (GetRegionName(iter, txt_region_end).size())
+            cur_region = nullptr;
+        else if (cur_region)
+            cur_region->emplace_back(iter);
+    }
+
+    std::string_view eol = (existing.find("\r\n") != std::string_view::npos) ? "\r\n" : "\n";
+
+    // Returns the line starting at pos including its line ending
+    auto get_line = [existing](size_t pos)
+    {
+        auto end = existing.find('\n', pos);
+        return existing.substr(pos, (end == std::string_view::npos) ? std::string_view::npos : end + 1 - pos);
+    };
+
+    updated.clear();
+    updated.reserve(existing.size());
+
+    bool found_region = false;
+    for (size_t pos = 0; pos < existing.size();)
+    {
+        auto line = get_line(pos);
+        updated += line;
+        pos += line.size();
+
+        auto name = GetRegionName(line, txt_region_begin);
+        if (name.empty())
+            continue;
+        found_region = true;
+
+        for (;;)
+        {
+            if (pos >= existing.size())
+                return false;
+            line = get_line(pos);
+            if (GetRegionName(line, txt_region_end) == name)
+                break;
+            pos += line.size();
+        }
+
+        if (auto region = regions.find(name); region != regions.end())
+        {
+            for (auto& iter: region->second)
+            {
+                updated += iter;
+                updated += eol;
+            }
+        }
+    }
+
+    return found_region;
+}
+
 bld::RESULT CConvert::CreateCmakeProject(ttlib::cstr& projectFile)
 {
     ttlib::cwd cur_cwd;
@@ -142,14 +231,29 @@ bld::RESULT CConvert::WriteCmakeProject()
     out += "endif()";
     out += multi_config;
 
-    bool need_blank_line { false };
+    // Every block generated from .srcfiles.yaml or the command line options is placed in its own region so that it is
+    // updated in an existing CMakeLists.txt. Regions are written even when they are empty, so that an option enabled
+    // later still has a place to go.
+    auto begin_region = [&out](std::string_view name) { out.emplace_back(ttlib::cstr() << txt_region_begin << name); };
+    auto end_region = [&out](std::string_view name)
+    {
+        if (out.size() && out.back().empty())
+            out.pop_back();
+        out.emplace_back(ttlib::cstr() << txt_region_end << name);
+        out += "";
+    };
+
+    begin_region("toolchain");
+    CMakeAddToolchainSpeedups(out);
+    end_region("toolchain");
 
     // Note that we make definitions global for the project rather than for just the target. That's because flags like
     // -DWXUSINGDLL *MUST* be global.
 
+    begin_region("definitions");
+
     if (flags_cmn.size() && (flags_cmn.contains("/D") || flags_cmn.contains("-D")))
     {
-        need_blank_line = true;
         ttlib::cstr flags = flags_cmn;
         flags.Replace("-D", "/D", true, tt::CASE::exact);
 
@@ -190,7 +294,6 @@ bld::RESULT CConvert::WriteCmakeProject()
     if (m_srcfiles.hasOptValue(OPT::CFLAGS_REL) &&
         (m_srcfiles.getOptValue(OPT::CFLAGS_REL).contains("/D") || m_srcfiles.getOptValue(OPT::CFLAGS_REL).contains("-D")))
     {
-        need_blank_line = true;
         ttlib::cstr flags = m_srcfiles.getOptValue(OPT::CFLAGS_REL);
         flags.Replace("-D", "/D", true, tt::CASE::exact);
 
@@ -224,7 +327,6 @@ bld::RESULT CConvert::WriteCmakeProject()
     if (m_srcfiles.hasOptValue(OPT::CFLAGS_DBG) &&
         (m_srcfiles.getOptValue(OPT::CFLAGS_DBG).contains("/D") || m_srcfiles.getOptValue(OPT::CFLAGS_DBG).contains("-D")))
     {
-        need_blank_line = true;
         ttlib::cstr flags = m_srcfiles.getOptValue(OPT::CFLAGS_DBG);
         flags.Replace("-D", "/D", true, tt::CASE::exact);
 
@@ -255,21 +357,37 @@ bld::RESULT CConvert::WriteCmakeProject()
         }
     }
 
-    if (need_blank_line)
-    {
-        out += "";
-        need_blank_line = false;
-    }
+    end_region("definitions");
+
+    // Projects converted from a solution or a directory tree are linked by the workspace CMakeLists.txt that adds
+    // them, and the libraries may still be getting converted on another thread.
+    begin_region("build_libs");
+    std::vector<ttlib::cstr> build_libs;
+    if (!m_isConvertToCmake && m_srcfiles.hasOptValue(OPT::BUILD_LIBS))
+        build_libs = CMakeAddBuildLibs(out);
+    end_region("build_libs");
 
+    begin_region("files");
     if (m_srcfiles.GetDebugFileList().size())
     {
         out += "# Note the requirement that --config Debug is used to get the additional debug files";
     }
 
-    out.emplace_back(ttlib::cstr() << "add_executable(" << m_srcfiles.GetProjectName());
-    if (m_srcfiles.IsExeTypeWindow())
+    if (m_srcfiles.IsExeTypeLib())
+    {
+        out.emplace_back(ttlib::cstr() << "add_library(" << m_srcfiles.GetProjectName() << " STATIC");
+    }
+    else if (m_srcfiles.IsExeTypeDll())
     {
-        out.back() << " WIN32";
+        out.emplace_back(ttlib::cstr() << "add_library(" << m_srcfiles.GetProjectName() << " SHARED");
+    }
+    else
+    {
+        out.emplace_back(ttlib::cstr() << "add_executable(" << m_srcfiles.GetProjectName());
+        if (m_srcfiles.IsExeTypeWindow())
+        {
+            out.back() << " WIN32";
+        }
     }
 
     if (m_srcFile.size())
@@ -277,7 +395,7 @@ bld::RESULT CConvert::WriteCmakeProject()
         ttlib::viewfile in;
         if (!in.ReadFile(m_srcFile))
         {
-            std::cout << "Unable to read " << m_srcfiles.GetSrcFilesName() << '\n';
+            ReportError(ttlib::cstr() << "Unable to read " << m_srcfiles.GetSrcFilesName());
             return bld::RESULT::read_failed;
         }
 
@@ -285,7 +403,7 @@ bld::RESULT CConvert::WriteCmakeProject()
 
         if (!ttlib::is_found(file_pos))
         {
-            std::cout << m_srcfiles.GetSrcFilesName() << " does not contain a Files: section" << '\n';
+            ReportError(ttlib::cstr() << m_srcfiles.GetSrcFilesName() << " does not contain a Files: section");
             return bld::RESULT::invalid_file;
         }
         CMakeAddFilesSection(in, out, file_pos);
@@ -295,12 +413,18 @@ bld::RESULT CConvert::WriteCmakeProject()
         CMakeAddFiles(out);
     }
 
-    if (need_blank_line)
+    end_region("files");
+
+    begin_region("unity");
+    if (m_cmake_options.unity_batch_size)
     {
-        out += "";
-        need_blank_line = false;
+        out.emplace_back(ttlib::cstr() << "set_target_properties(" << m_srcfiles.GetProjectName()
+                                       << " PROPERTIES UNITY_BUILD ON UNITY_BUILD_BATCH_SIZE "
+                                       << m_cmake_options.unity_batch_size << ')');
     }
+    end_region("unity");
 
+    begin_region("msvc");
     out += "if (MSVC)";
     out += "    # /GL -- combined with the Linker flag /LTCG to perform whole program optimization in Release build";
     out += "    # /FC -- Full path to source code file in diagnostics";
@@ -308,7 +432,8 @@ bld::RESULT CConvert::WriteCmakeProject()
         ttlib::cstr() << "    target_compile_options(" << m_srcfiles.GetProjectName()
                       << " PRIVATE \"$<$<CONFIG:Release>:/GL>\" \"/FC\" \"/W4\" \"/Zc:__cplusplus\" \"/utf-8\")");
     out.emplace_back(ttlib::cstr() << "    target_link_options(" << m_srcfiles.GetProjectName()
-                                   << " PRIVATE \"$<$<CONFIG:Release>:/LTCG>\")\n");
+                                   << " PRIVATE \"$<$<CONFIG:Release>:/LTCG>\")");
+    out += "";
 
     if (m_srcfiles.hasOptValue(OPT::NATVIS))
     {
@@ -326,15 +451,22 @@ bld::RESULT CConvert::WriteCmakeProject()
 
     if (m_srcfiles.getRcName().size())
     {
-        out += "\n    # Assume the manifest is in the resource file";
+        out += "";
+        out += "    # Assume the manifest is in the resource file";
         out.emplace_back(ttlib::cstr() << "    target_link_options(" << m_srcfiles.GetProjectName()
                                        << " PRIVATE \"/manifest:no\")");
     }
 
     out += "endif()";
-    out += "";
+    end_region("msvc");
 
-    if (m_srcfiles.HasPch())
+    begin_region("pch");
+    if (m_pch_reuse_from.size())
+    {
+        out.emplace_back(ttlib::cstr() << "target_precompile_headers(" << m_srcfiles.GetProjectName() << " REUSE_FROM "
+                                       << m_pch_reuse_from << ')');
+    }
+    else if (m_srcfiles.HasPch())
     {
         if (m_isConvertToCmake)
         {
@@ -365,9 +497,10 @@ bld::RESULT CConvert::WriteCmakeProject()
             out.emplace_back(ttlib::cstr() << "target_precompile_headers(" << m_srcfiles.GetProjectName() << " PRIVATE \""
                                            << pch_path << "\")");
         }
-        out += "";
     }
+    end_region("pch");
 
+    begin_region("include_dirs");
     if (m_srcfiles.hasOptValue(OPT::INC_DIRS))
     {
         out.emplace_back(ttlib::cstr() << "target_include_directories(" << m_srcfiles.GetProjectName() << " PRIVATE ");
@@ -409,9 +542,22 @@ bld::RESULT CConvert::WriteCmakeProject()
             }
         }
         out += ")";
-        out += "";
     }
+    end_region("include_dirs");
 
+    begin_region("link_libraries");
+    if (build_libs.size())
+    {
+        out.emplace_back(ttlib::cstr() << "target_link_libraries(" << m_srcfiles.GetProjectName() << " PRIVATE");
+        for (auto& iter: build_libs)
+        {
+            out.back() << ' ' << iter;
+        }
+        out.back() << ')';
+    }
+    end_region("link_libraries");
+
+    begin_region("link_dirs");
     if (m_srcfiles.hasOptValue(OPT::LIB_DIRS) || m_srcfiles.hasOptValue(OPT::LIB_DIRS64))
         out += "if (MSVC)";
 
@@ -465,33 +611,249 @@ bld::RESULT CConvert::WriteCmakeProject()
     }
     if (m_srcfiles.hasOptValue(OPT::LIB_DIRS) || m_srcfiles.hasOptValue(OPT::LIB_DIRS64))
         out += "endif()";
+    end_region("link_dirs");
 
-    ttlib::cstr out_name("CMakeLists.txt");
+    // When converting a project, the files are relative to the destination directory, so that's where CMakeLists.txt
+    // needs to be written.
+    ttlib::cstr out_dir;
+    if (m_isConvertToCmake && m_dstDir.size())
+    {
+        out_dir = m_dstDir;
+        out_dir.addtrailingslash();
+    }
+
+    ttlib::cstr out_name(out_dir);
+    out_name << "CMakeLists.txt";
     if (ttlib::file_exists(out_name))
     {
+        std::string existing;
+        ReadFileBytes(out_name, existing);
+
+        std::string updated;
+        if (UpdateCmakeRegions(existing, out, updated))
+        {
+            if (CPlan::Get().Add(out_name, updated, "CMake project (generated regions)"))
+                return bld::RESULT::success;
+
+            // Leaving an unchanged file alone keeps its timestamp, so CMake doesn't reconfigure the build.
+            if (updated == existing)
+            {
+                if (!m_isBatchMode)
+                    std::cout << out_name << " is up to date" << '\n';
+                return bld::RESULT::success;
+            }
+
+            // cmake can be reading the file while it's being regenerated, so it must never see a partial file
+            if (!WriteFileAtomic(out_name, updated.data(), updated.size()))
+            {
+                ReportError(ttlib::cstr() << "Cannot write to " << out_name);
+                return bld::RESULT::write_failed;
+            }
+            if (!m_isBatchMode)
+                std::cout << "Updated " << out_name << '\n';
+            return bld::RESULT::success;
+        }
+
+        // A CMakeLists.txt that ttBld didn't create (or whose markers were removed) is never modified.
         out_name.replace_extension(".ttbld");
     }
 
-    if (!out.WriteFile(out_name))
+    bool isPlanned = CPlan::Get().Add(out_name, out, "CMake project");
+    if (!isPlanned && !out.WriteFile(out_name))
     {
-        std::cout << "Cannot write to " << out_name << '\n';
+        ReportError(ttlib::cstr() << "Cannot write to " << out_name);
         return bld::RESULT::write_failed;
     }
 
-    std::cout << "Created " << out_name << '\n';
-    if (!ttlib::file_exists("CMakePresets.json"))
+    // In batch mode, each project is part of a larger tree, so only the CMakeLists.txt is created.
+    if (!m_isBatchMode)
     {
-        out.clear();
-        out.ReadString(preset_json);
-        if (out.WriteFile("CMakePresets.json"))
+        if (!isPlanned)
+            std::cout << "Created " << out_name << '\n';
+        ttlib::cstr preset_name(out_dir);
+        preset_name << "CMakePresets.json";
+        if (!ttlib::file_exists(preset_name))
         {
-            std::cout << "Created CMakePresets.json" << '\n';
+            out.clear();
+            out.ReadString(preset_json);
+            if (CPlan::Get().Add(preset_name, out, "CMake presets"))
+            {
+                // The file is only recorded in the plan
+            }
+            else if (out.WriteFile(preset_name))
+            {
+                std::cout << "Created " << preset_name << '\n';
+            }
         }
     }
 
     return bld::RESULT::success;
 }
 
+void CConvert::CMakeAddToolchainSpeedups(ttlib::textfile& out)
+{
+    if (m_cmake_options.use_launcher)
+    {
+        out += "# A compiler cache avoids recompiling after a branch switch or a clean build directory";
+        out += "find_program(COMPILER_CACHE_PROGRAM NAMES sccache ccache)";
+        out += "if (COMPILER_CACHE_PROGRAM)";
+        out += "    set(CMAKE_C_COMPILER_LAUNCHER ${COMPILER_CACHE_PROGRAM})";
+        out += "    set(CMAKE_CXX_COMPILER_LAUNCHER ${COMPILER_CACHE_PROGRAM})";
+        out += "endif()";
+        out += "";
+    }
+
+    if (m_cmake_options.linker.size())
+    {
+        out += "# CMAKE_LINKER_TYPE requires CMake 3.29 -- older versions use the default linker";
+        out += "if (CMAKE_VERSION VERSION_GREATER_EQUAL 3.29)";
+        if (m_cmake_options.linker.is_sameas("auto", tt::CASE::either))
+        {
+            out += "    # lld-link is not used with MSVC since it cannot link objects compiled with /GL";
+            out += "    if (NOT MSVC)";
+            out += "        find_program(MOLD_PROGRAM mold)";
+            out += "        find_program(LLD_PROGRAM ld.lld)";
+            out += "        if (MOLD_PROGRAM)";
+            out += "            set(CMAKE_LINKER_TYPE MOLD)";
+            out += "        elseif (LLD_PROGRAM)";
+            out += "            set(CMAKE_LINKER_TYPE LLD)";
+            out += "        endif()";
+            out += "    endif()";
+        }
+        else
+        {
+            ttlib::cstr linker_type(m_cmake_options.linker);
+            for (auto& ch: linker_type)
+                ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+            out.emplace_back(ttlib::cstr() << "    set(CMAKE_LINKER_TYPE " << linker_type << ')');
+        }
+        out += "endif()";
+        out += "";
+    }
+}
+
+std::vector<ttlib::cstr> CConvert::CMakeAddBuildLibs(ttlib::textfile& out)
+{
+    namespace fs = std::filesystem;
+
+    std::vector<ttlib::cstr> targets;
+    std::error_code ec;
+
+    // CMakeLists.txt is written to out_dir, and the BuildLibs: paths are relative to .srcfiles.yaml. Both are resolved
+    // to absolute paths up front so that nothing below depends on (or changes) the current directory.
+    auto out_dir = fs::absolute(fs::u8path(m_isConvertToCmake && m_dstDir.size() ? m_dstDir.c_str() : "."), ec);
+    out_dir = out_dir.lexically_normal();
+    if (!out_dir.has_filename())
+        out_dir = out_dir.parent_path();
+    auto project_dir = (out_dir / fs::u8path(m_srcDir.c_str())).lexically_normal();
+    if (!project_dir.has_filename())
+        project_dir = project_dir.parent_path();
+
+    ttlib::multistr enumLib(ttlib::find_nonspace(m_srcfiles.getOptValue(OPT::BUILD_LIBS)), ';');
+    for (auto& libPath: enumLib)
+    {
+        ttlib::cstr lib_entry(libPath);
+        lib_entry.backslashestoforward();
+        auto lib_dir = (project_dir / fs::u8path(lib_entry.c_str())).lexically_normal();
+        if (!lib_dir.has_filename())
+            lib_dir = lib_dir.parent_path();
+
+        if (!fs::is_directory(lib_dir, ec))
+        {
+            ReportError(ttlib::cstr() << "The library source directory " << libPath
+                                      << " specified in BuildLibs: does not exist.");
+            continue;
+        }
+
+        // Just like the ninja generator, allow for the library's source being in a sub-directory with the same name
+        auto lib_project = locateProjectFile(lib_dir.generic_u8string());
+        if (lib_project.empty())
+            lib_project = locateProjectFile((lib_dir / lib_dir.filename()).generic_u8string());
+        if (lib_project.empty())
+        {
+            ReportError(ttlib::cstr() << "Cannot locate a .srcfiles.yaml for the library " << libPath);
+            continue;
+        }
+
+        auto lib_src_dir = fs::u8path(lib_project.c_str()).parent_path().lexically_normal();
+        if (!lib_src_dir.has_filename())
+            lib_src_dir = lib_src_dir.parent_path();
+        if (lib_src_dir == project_dir)
+        {
+            ReportError(ttlib::cstr() << "BuildLibs: cannot refer to the project's own directory " << libPath);
+            continue;
+        }
+        if (std::find(m_lib_chain.begin(), m_lib_chain.end(), lib_src_dir.generic_u8string()) != m_lib_chain.end())
+        {
+            ReportError(ttlib::cstr() << "Circular BuildLibs: reference to " << lib_project);
+            continue;
+        }
+
+        // CSrcFiles resolves Files:, wildcard patterns and a missing Project: (the directory name) against the current
+        // directory, so the library is read -- and its CMakeLists.txt created if it doesn't have one -- from its own
+        // directory. Everything used after this block is an absolute path.
+        ttlib::cstr target;
+        {
+            ttlib::cwd cwd(true);
+            ttlib::ChangeDir(ttlib::cstr(lib_src_dir.u8string()));
+            ttlib::cstr lib_filename(fs::u8path(lib_project.c_str()).filename().u8string());
+
+            CSrcFiles lib_srcfiles;
+            if (!lib_srcfiles.ReadFile(lib_filename))
+            {
+                ReportError(ttlib::cstr() << "Cannot read " << lib_project);
+                continue;
+            }
+            if (!lib_srcfiles.IsExeTypeLib() && !lib_srcfiles.IsExeTypeDll())
+            {
+                ReportError(ttlib::cstr() << lib_project << " specified in BuildLibs: is not a library");
+                continue;
+            }
+            target = lib_srcfiles.GetProjectName();
+
+            // An existing CMakeLists.txt is assumed to already define the library target
+            if (!fs::exists(lib_src_dir / "CMakeLists.txt", ec))
+            {
+                CConvert lib_convert;
+                lib_convert.SetBatchMode();
+                lib_convert.SetCMakeOptions(m_cmake_options);
+                lib_convert.m_lib_chain = m_lib_chain;
+                lib_convert.m_lib_chain.emplace_back(project_dir.generic_u8string());
+                if (lib_convert.CreateCmakeProject(lib_filename) != bld::RESULT::success)
+                {
+                    for (auto& iter: lib_convert.GetErrors())
+                        ReportError(iter);
+                    continue;
+                }
+                if (!m_isBatchMode && !CPlan::Get().IsEnabled())
+                    std::cout << "Created " << (lib_src_dir / "CMakeLists.txt").generic_u8string() << '\n';
+            }
+        }
+
+        if (targets.empty())
+            out += "# Libraries from BuildLibs: are built as part of this project";
+
+        // The same library may also be added by another library that this project links with
+        targets.emplace_back(target);
+        out.emplace_back(ttlib::cstr() << "if (NOT TARGET " << target << ')');
+
+        // Directories outside of the source tree need an explicit binary directory
+        auto rel_dir = lib_src_dir.lexically_relative(out_dir).generic_u8string();
+        if (rel_dir.empty())
+            rel_dir = lib_src_dir.generic_u8string();
+        if (rel_dir.rfind("..", 0) == 0 || fs::u8path(rel_dir).is_absolute())
+            out.emplace_back(ttlib::cstr() << "    add_subdirectory(" << rel_dir << ' ' << target << ')');
+        else
+            out.emplace_back(ttlib::cstr() << "    add_subdirectory(" << rel_dir << ')');
+        out += "endif()";
+    }
+
+    if (targets.size())
+        out += "";
+
+    return targets;
+}
+
 void CConvert::CMakeAddFilesSection(ttlib::viewfile& in, ttlib::textfile& out, size_t file_pos)
 {
     for (++file_pos; file_pos < in.size(); ++file_pos)
@@ -6,6 +6,7 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include <cctype>
+#include <chrono>
 
 #if defined(_WIN32)
     #include <Rpc.h>
@@ -25,7 +26,11 @@
 
 #endif  // _WIN32
 
-#include "writevcx.h"  // CVcxWrite
+#include "plan.h"       // CPlan -- Records every file ttBld would write without writing any of them
+#include "ttconsole.h"  // concolor -- Sets/restores console foreground color
+#include "writevcx.h"   // CVcxWrite
+#include "xmlarena.h"   // CXmlArena -- Bump allocator for pugixml documents
+#include "xmlwrite.h"   // CXmlWriter -- Streaming XML writer with the same output as a saved pugixml document
 
 #include "uifuncs.h"  // Miscellaneous functions for displaying UI
 
@@ -98,6 +103,17 @@ static bool UpdateBuildFile(ttlib::cstr /* filename */)
 }
 #endif
 
+// Collects xml output from pugixml so that it can be compared with CXmlWriter::str()
+class StringXmlWriter : public pugi::xml_writer
+{
+public:
+    void write(const void* data, size_t size) override { m_str.append(static_cast<const char*>(data), size); }
+    const std::string& str() const { return m_str; }
+
+private:
+    std::string m_str;
+};
+
 bool CVcxWrite::CreateBuildFile()
 {
     if (!IsProcessed())
@@ -122,106 +138,262 @@ bool CVcxWrite::CreateBuildFile()
         return UpdateBuildFile(vc_project_file);
 #endif
 
-    pugi::xml_document doc;
+    FindHeaders();
+
+    // The files are written directly rather than building a pugixml document first. The -vcxbench option compares the
+    // two to verify that the output is identical.
+    CXmlWriter xml;
+    GenerateProject(xml, guid);
+    if (CPlan::Get().Add(vc_project_file, xml.str(), "Visual Studio project"))
+    {
+        // The file is only recorded in the plan
+    }
+    else if (!xml.WriteFile(vc_project_file))
+    {
+        std::cout << "Unable to create or write to " + vc_project_file << '\n';
+        return false;
+    }
+    else
+    {
+        std::cout << "Created " << vc_project_file << '\n';
+    }
+
+    ttlib::cstr filter_file(vc_project_file);
+    filter_file += ".filters";
+
+    ttlib::cstr guid_src;
+    ttlib::cstr guid_hdr;
+    CreateGuid(guid_src);
+    CreateGuid(guid_hdr);
+
+    CXmlWriter filters;
+    GenerateFilters(filters, guid_src, guid_hdr);
+    if (CPlan::Get().Add(filter_file, filters.str(), "Visual Studio project filters"))
+    {
+        // The file is only recorded in the plan
+    }
+    else if (!filters.WriteFile(filter_file))
+    {
+        std::cout << "Unable to create or write to " + filter_file << '\n';
+        return false;
+    }
+    else
+    {
+        std::cout << "Created " << filter_file << '\n';
+    }
+
+    return true;
+}
+
+bool CVcxWrite::Benchmark(size_t iterations)
+{
+    if (!IsProcessed())
+    {
+        std::cout << "Unable to locate .srcfiles.yaml" << '\n';
+        return false;
+    }
+
+    // Fixed GUIDs so that both writers generate the same content
+    const ttlib::cstr guid("00000000-0000-0000-0000-000000000001");
+    const ttlib::cstr guid_src("00000000-0000-0000-0000-000000000002");
+    const ttlib::cstr guid_hdr("00000000-0000-0000-0000-000000000003");
+
+    FindHeaders();
+
+    // The documents use an arena the same way the document-based writer did
+    CXmlArena arena;
+
+    std::string dom_output;
+    auto dom_start = std::chrono::steady_clock::now();
+    for (size_t count = 0; count < iterations; ++count)
+    {
+        {
+            CXmlArena::Scope arena_scope(arena);
+            StringXmlWriter writer;
+
+            pugi::xml_document doc;
+            CXmlDomBuilder project(doc);
+            GenerateProject(project, guid);
+            doc.save(writer);
+
+            pugi::xml_document filter_doc;
+            CXmlDomBuilder filters(filter_doc);
+            GenerateFilters(filters, guid_src, guid_hdr);
+            filter_doc.save(writer);
+
+            if (count == 0)
+                dom_output = writer.str();
+        }
+        arena.Reset();
+    }
+    auto dom_time = std::chrono::steady_clock::now() - dom_start;
+
+    std::string stream_output;
+    auto stream_start = std::chrono::steady_clock::now();
+    for (size_t count = 0; count < iterations; ++count)
+    {
+        CXmlWriter project;
+        GenerateProject(project, guid);
+
+        CXmlWriter filters;
+        GenerateFilters(filters, guid_src, guid_hdr);
+
+        if (count == 0)
+            stream_output = project.str() + filters.str();
+    }
+    auto stream_time = std::chrono::steady_clock::now() - stream_start;
+
+    using std::chrono::microseconds;
+    std::cout << GetSrcFileList().size() << " source files, " << iterations << " iterations" << '\n';
+    std::cout << "pugixml document: " << std::chrono::duration_cast<microseconds>(dom_time).count() << " us" << '\n';
+    std::cout << "CXmlWriter:       " << std::chrono::duration_cast<microseconds>(stream_time).count() << " us" << '\n';
+
+    if (dom_output != stream_output)
+    {
+        ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+        std::cout << "The generated files are NOT identical" << '\n';
+        return false;
+    }
+
+    std::cout << "The generated files are identical" << '\n';
+    return true;
+}
+
+void CVcxWrite::FindHeaders()
+{
+    m_headers.clear();
+    for (auto& iter: GetSrcFileList())
+    {
+        if (iter.is_sameas(GetRcFile()))
+            continue;
+        ttlib::cstr header(iter);
+        header.replace_extension(".h");
+        bool header_found = header.file_exists();
+        for (; !header_found;)
+        {
+            header.replace_extension(".hh");
+            header_found = header.file_exists();
+            if (header_found)
+                break;
+
+            header.replace_extension(".hpp");
+            header_found = header.file_exists();
+            if (header_found)
+                break;
 
-    auto Project = doc.append_child("Project");
-    pugi::xml_node child;
-    pugi::xml_node PropGroup;
-    m_Project = &Project;
+            header.replace_extension(".hxx");
+            header_found = header.file_exists();
 
-    Project.append_attribute("DefaultTargets").set_value("Build");
-    Project.append_attribute("ToolsVersion").set_value("4.0");
-    Project.append_attribute("xmlns").set_value("http://schemas.microsoft.com/developer/msbuild/2003");
+            break;
+        }
+
+        if (header_found)
+            m_headers.emplace_back(header);
+    }
+}
+
+template <typename T>
+void CVcxWrite::GenerateProject(T& xml, const ttlib::cstr& guid)
+{
+    xml.StartElement("Project");
+    xml.Attribute("DefaultTargets", "Build");
+    xml.Attribute("ToolsVersion", "4.0");
+    xml.Attribute("xmlns", "http://schemas.microsoft.com/developer/msbuild/2003");
 
     // Add Build types
 
-    auto ItemGroup = Project.append_child("ItemGroup");
-    ItemGroup.append_attribute("Label").set_value("ProjectConfigurations");
+    xml.StartElement("ItemGroup");
+    xml.Attribute("Label", "ProjectConfigurations");
 
-    AddConfiguration(ItemGroup, GEN_DEBUG);
-    AddConfiguration(ItemGroup, GEN_RELEASE);
+    AddConfiguration(xml, GEN_DEBUG);
+    AddConfiguration(xml, GEN_RELEASE);
 
     if (hasOptValue(OPT::TARGET_DIR32))
     {
-        AddConfiguration(ItemGroup, GEN_DEBUG32);
-        AddConfiguration(ItemGroup, GEN_RELEASE32);
+        AddConfiguration(xml, GEN_DEBUG32);
+        AddConfiguration(xml, GEN_RELEASE32);
     }
+    xml.EndElement();
 
-    PropGroup = Project.append_child("PropertyGroup");
-    PropGroup.append_attribute("Label").set_value("Globals");
+    xml.StartElement("PropertyGroup");
+    xml.Attribute("Label", "Globals");
     {
         ttlib::cstr gd;
         gd << '{' << guid << '}';
-        PropGroup.append_child("ProjectGuid").text().set(gd.c_str());
-        // PropGroup.append_child("Keyword").text().set("Win32Proj");
-        PropGroup.append_child("ProjectName").text().set(GetProjectName().c_str());
+        xml.TextElement("ProjectGuid", gd);
+        // xml.TextElement("Keyword", "Win32Proj");
+        xml.TextElement("ProjectName", GetProjectName());
     }
+    xml.EndElement();
 
-    auto Import = Project.append_child("Import");
-    Import.append_attribute("Project").set_value("$(VCTargetsPath)\\Microsoft.Cpp.Default.props");
+    xml.StartElement("Import");
+    xml.Attribute("Project", "$(VCTargetsPath)\\Microsoft.Cpp.Default.props");
+    xml.EndElement();
 
-    AddConfigAppType(Project, GEN_DEBUG);
-    AddConfigAppType(Project, GEN_RELEASE);
+    AddConfigAppType(xml, GEN_DEBUG);
+    AddConfigAppType(xml, GEN_RELEASE);
 
     if (hasOptValue(OPT::TARGET_DIR32))
     {
-        AddConfigAppType(Project, GEN_DEBUG32);
-        AddConfigAppType(Project, GEN_RELEASE32);
+        AddConfigAppType(xml, GEN_DEBUG32);
+        AddConfigAppType(xml, GEN_RELEASE32);
     }
 
-    Import = Project.append_child("Import");
-    Import.append_attribute("Project").set_value("$(VCTargetsPath)\\Microsoft.Cpp.props");
+    xml.StartElement("Import");
+    xml.Attribute("Project", "$(VCTargetsPath)\\Microsoft.Cpp.props");
+    xml.EndElement();
 
-    PropGroup = Project.append_child("PropertyGroup");
+    xml.StartElement("PropertyGroup");
 
-    AddOutDirs(PropGroup, GEN_DEBUG);
-    AddOutDirs(PropGroup, GEN_RELEASE);
+    AddOutDirs(xml, GEN_DEBUG);
+    AddOutDirs(xml, GEN_RELEASE);
 
     if (hasOptValue(OPT::TARGET_DIR32))
     {
-        AddOutDirs(PropGroup, GEN_DEBUG32);
-        AddOutDirs(PropGroup, GEN_RELEASE32);
+        AddOutDirs(xml, GEN_DEBUG32);
+        AddOutDirs(xml, GEN_RELEASE32);
     }
+    xml.EndElement();
 
     for (auto& iter: lst_platforms)
     {
         if (ttlib::contains(iter, "Debug"))
         {
-            PropGroup = Project.append_child("PropertyGroup");
+            xml.StartElement("PropertyGroup");
             if (ttlib::contains(iter, "x64"))
             {
-                PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
-                child = PropGroup.append_child("TargetName");
+                xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Debug|x64'");
                 ttlib::cstr target_name = GetTargetDebug().filename();
                 target_name.remove_extension();
-                child.text().set(target_name.c_str());
+                xml.TextElement("TargetName", target_name);
             }
             else
             {
-                PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
-                child = PropGroup.append_child("TargetName");
+                xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Debug|Win32'");
                 ttlib::cstr target_name = GetTargetDebug32().filename();
                 target_name.remove_extension();
-                child.text().set(target_name.c_str());
+                xml.TextElement("TargetName", target_name);
             }
 
             // REVIEW: [KeyWorks - 09-10-2021] This assumes the manifest is in the resource file
-            PropGroup.append_child("GenerateManifest").text().set("false");
+            xml.TextElement("GenerateManifest", "false");
+            xml.EndElement();
         }
         else
         {
-            PropGroup = Project.append_child("PropertyGroup");
+            xml.StartElement("PropertyGroup");
             if (ttlib::contains(iter, "x64"))
             {
-                PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
+                xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Debug|x64'");
             }
             else
             {
-                PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
+                xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Release|x64'");
             }
 
             // REVIEW: [KeyWorks - 09-10-2021] This assumes the manifest is in the resource file
-            PropGroup.append_child("GenerateManifest").text().set("false");
+            xml.TextElement("GenerateManifest", "false");
+            xml.EndElement();
         }
     }
 
@@ -235,13 +407,13 @@ bool CVcxWrite::CreateBuildFile()
 
     for (auto& iter: lst_platforms)
     {
-        auto ItemDef = Project.append_child("ItemDefinitionGroup");
-        ItemDef.append_attribute("Condition").set_value(iter);
-        auto ClCompile = ItemDef.append_child("ClCompile");
+        xml.StartElement("ItemDefinitionGroup");
+        xml.Attribute("Condition", iter);
+        xml.StartElement("ClCompile");
 
         if (getOptValue(OPT::CFLAGS_CMN).contains("-std:c++latest") || getOptValue(OPT::MSVC_CMN).contains("-std:c++latest"))
         {
-            ClCompile.append_child("LanguageStandard").text().set("stdcpplatest");
+            xml.TextElement("LanguageStandard", "stdcpplatest");
         }
         else if (getOptValue(OPT::CFLAGS_CMN).contains("-std:c++"))
         {
@@ -252,7 +424,7 @@ bool CVcxWrite::CreateBuildFile()
                 ++ptr;
             }
             std << ttlib::atoi(ptr);
-            ClCompile.append_child("LanguageStandard").text().set(std.c_str());
+            xml.TextElement("LanguageStandard", std);
         }
         else if (getOptValue(OPT::MSVC_CMN).contains("-std:c++"))
         {
@@ -263,14 +435,14 @@ bool CVcxWrite::CreateBuildFile()
                 ++ptr;
             }
             std << ttlib::atoi(ptr);
-            ClCompile.append_child("LanguageStandard").text().set(std.c_str());
+            xml.TextElement("LanguageStandard", std);
         }
-        ClCompile.append_child("MultiProcessorCompilation").text().set("true");
+        xml.TextElement("MultiProcessorCompilation", "true");
         if (hasOptValue(OPT::WARN))
         {
             ttlib::cstr warn_level("Level");
             warn_level << getOptValue(OPT::WARN).atoi(getOptValue(OPT::WARN).find_oneof("0123456"));
-            ClCompile.append_child("WarningLevel").text().set(warn_level.c_str());
+            xml.TextElement("WarningLevel", warn_level);
         }
 
         ttlib::cstr options;
@@ -281,8 +453,8 @@ bool CVcxWrite::CreateBuildFile()
 
         if (ttlib::contains(iter, "Debug"))
         {
-            ClCompile.append_child("Optimization").text().set("Disabled");
-            ClCompile.append_child("RuntimeLibrary").text().set("MultiThreadedDebugDLL");
+            xml.TextElement("Optimization", "Disabled");
+            xml.TextElement("RuntimeLibrary", "MultiThreadedDebugDLL");
             if (hasOptValue(OPT::CFLAGS_DBG))
             {
                 if (options.size())
@@ -290,13 +462,14 @@ bool CVcxWrite::CreateBuildFile()
                 options << getOptValue(OPT::CFLAGS_DBG);
             }
             if (options.size())
-                ClCompile.append_child("AdditionalOptions").text().set(options.c_str());
+                xml.TextElement("AdditionalOptions", options);
+            xml.EndElement();  // ClCompile
 
-            auto Link = ItemDef.append_child("Link");
-            Link.append_child("GenerateDebugInformation").text().set("true");
+            xml.StartElement("Link");
+            xml.TextElement("GenerateDebugInformation", "true");
             if (ttlib::contains(iter, "x64"))
             {
-                Link.append_child("OutputFile").text().set(GetTargetDebug().c_str());
+                xml.TextElement("OutputFile", GetTargetDebug());
 
                 if (hasOptValue(OPT::LIB_DIRS64))
                 {
@@ -307,7 +480,7 @@ bool CVcxWrite::CreateBuildFile()
             }
             else
             {
-                Link.append_child("OutputFile").text().set(GetTargetDebug32().c_str());
+                xml.TextElement("OutputFile", GetTargetDebug32());
 
                 if (hasOptValue(OPT::LIB_DIRS32))
                 {
@@ -320,13 +493,14 @@ bool CVcxWrite::CreateBuildFile()
             if (LibPath.size())
             {
                 LibPath << ";%(AdditionalLibraryDirectories)";
-                Link.append_child("AdditionalLibraryDirectories").text().set(LibPath.c_str());
+                xml.TextElement("AdditionalLibraryDirectories", LibPath);
             }
+            xml.EndElement();  // Link
         }
         else
         {
             if (!IsOptimizeSpeed())
-                ClCompile.append_child("Optimization").text().set("MinSpace");
+                xml.TextElement("Optimization", "MinSpace");
 
             if (hasOptValue(OPT::CFLAGS_REL))
             {
@@ -335,13 +509,14 @@ bool CVcxWrite::CreateBuildFile()
                 options << getOptValue(OPT::CFLAGS_REL);
             }
             if (options.size())
-                ClCompile.append_child("AdditionalOptions").text().set(options.c_str());
+                xml.TextElement("AdditionalOptions", options);
+            xml.EndElement();  // ClCompile
 
-            auto Link = ItemDef.append_child("Link");
-            Link.append_child("GenerateDebugInformation").text().set("false");
+            xml.StartElement("Link");
+            xml.TextElement("GenerateDebugInformation", "false");
             if (ttlib::contains(iter, "x64"))
             {
-                Link.append_child("OutputFile").text().set(GetTargetRelease().c_str());
+                xml.TextElement("OutputFile", GetTargetRelease());
 
                 if (hasOptValue(OPT::LIB_DIRS64))
                 {
@@ -352,7 +527,7 @@ bool CVcxWrite::CreateBuildFile()
             }
             else
             {
-                Link.append_child("OutputFile").text().set(GetTargetRelease32().c_str());
+                xml.TextElement("OutputFile", GetTargetRelease32());
 
                 if (hasOptValue(OPT::LIB_DIRS32))
                 {
@@ -365,229 +540,195 @@ bool CVcxWrite::CreateBuildFile()
             if (LibPath.size())
             {
                 LibPath << ";%(AdditionalLibraryDirectories)";
-                Link.append_child("AdditionalLibraryDirectories").text().set(LibPath.c_str());
+                xml.TextElement("AdditionalLibraryDirectories", LibPath);
             }
+            xml.EndElement();  // Link
         }
+        xml.EndElement();  // ItemDefinitionGroup
     }
 
-    ItemGroup = Project.append_child("ItemGroup");
-    for (auto& iter: GetSrcFileList())
+    xml.StartElement("ItemGroup");
+    for (auto& iter: m_headers)
     {
-        if (iter.is_sameas(GetRcFile()))
-            continue;
-        ttlib::cstr header(iter);
-        header.replace_extension(".h");
-        bool header_found = header.file_exists();
-        for (; !header_found;)
-        {
-            header.replace_extension(".hh");
-            header_found = header.file_exists();
-            if (header_found)
-                break;
-
-            header.replace_extension(".hpp");
-            header_found = header.file_exists();
-            if (header_found)
-                break;
-
-            header.replace_extension(".hxx");
-            header_found = header.file_exists();
-
-            break;
-        }
-
-        if (header_found)
-        {
-            auto ClInclude = ItemGroup.append_child("ClInclude");
-            ClInclude.append_attribute("Include").set_value(header.c_str());
-        }
+        xml.StartElement("ClInclude");
+        xml.Attribute("Include", iter);
+        xml.EndElement();
     }
 
     if (HasPch())
     {
-        auto ClInclude = ItemGroup.append_child("ClInclude");
-        ClInclude.append_attribute("Include").set_value(getOptValue(OPT::PCH).c_str());
+        xml.StartElement("ClInclude");
+        xml.Attribute("Include", getOptValue(OPT::PCH));
+        xml.EndElement();
     }
+    xml.EndElement();
 
-    ItemGroup = Project.append_child("ItemGroup");
+    xml.StartElement("ItemGroup");
     for (auto& iter: GetSrcFileList())
     {
         if (iter.is_sameas(GetRcFile()))
             continue;
-        auto ClCompile = ItemGroup.append_child("ClCompile");
-        ClCompile.append_attribute("Include").set_value(iter.c_str());
+        xml.StartElement("ClCompile");
+        xml.Attribute("Include", iter);
+        xml.EndElement();
     }
 
     for (auto& iter: m_lstDebugFiles)
     {
-        auto ClCompile = ItemGroup.append_child("ClCompile");
-        ClCompile.append_attribute("Include").set_value(iter.c_str());
-        child = ClCompile.append_child("ExcludedFromBuild");
-        child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
-        child.text().set("true");
-        child = ClCompile.append_child("ExcludedFromBuild");
-        child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
-        child.text().set("true");
+        xml.StartElement("ClCompile");
+        xml.Attribute("Include", iter);
+        xml.StartElement("ExcludedFromBuild");
+        xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Release|x64'");
+        xml.Text("true");
+        xml.EndElement();
+        xml.StartElement("ExcludedFromBuild");
+        xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Release|Win32'");
+        xml.Text("true");
+        xml.EndElement();
+        xml.EndElement();
     }
 
     if (GetPchCpp().size())
     {
-        auto ClCompile = ItemGroup.append_child("ClCompile");
-        ClCompile.append_attribute("Include").set_value(GetPchCpp().c_str());
-        child = ClCompile.append_child("PrecompiledHeader");
-        child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
-        child.text().set("Create");
-        child = ClCompile.append_child("PrecompiledHeader");
-        child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
-        child.text().set("Create");
+        xml.StartElement("ClCompile");
+        xml.Attribute("Include", GetPchCpp());
+        AddConditionalElement(xml, "PrecompiledHeader", "'$(Configuration)|$(Platform)'=='Debug|x64'", "Create");
+        AddConditionalElement(xml, "PrecompiledHeader", "'$(Configuration)|$(Platform)'=='Release|x64'", "Create");
         if (hasOptValue(OPT::TARGET_DIR32))
         {
-            child = ClCompile.append_child("PrecompiledHeader");
-            child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
-            child.text().set("Create");
-            child = ClCompile.append_child("PrecompiledHeader");
-            child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
-            child.text().set("Create");
+            AddConditionalElement(xml, "PrecompiledHeader", "'$(Configuration)|$(Platform)'=='Debug|Win32'", "Create");
+            AddConditionalElement(xml, "PrecompiledHeader", "'$(Configuration)|$(Platform)'=='Release|Win32'",
+                                  "Create");
         }
 
         if (hasOptValue(OPT::PCH))
         {
-            child = ClCompile.append_child("PrecompiledHeaderFile");
-            child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
-            child.text().set(getOptValue(OPT::PCH).c_str());
-
-            child = ClCompile.append_child("PrecompiledHeaderFile");
-            child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
-            child.text().set(getOptValue(OPT::PCH).c_str());
+            auto& pch = getOptValue(OPT::PCH);
+            AddConditionalElement(xml, "PrecompiledHeaderFile", "'$(Configuration)|$(Platform)'=='Debug|x64'", pch);
+            AddConditionalElement(xml, "PrecompiledHeaderFile", "'$(Configuration)|$(Platform)'=='Release|x64'", pch);
             if (hasOptValue(OPT::TARGET_DIR32))
             {
-                child = ClCompile.append_child("PrecompiledHeaderFile");
-                child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
-                child.text().set(getOptValue(OPT::PCH).c_str());
-
-                child = ClCompile.append_child("PrecompiledHeaderFile");
-                child.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
-                child.text().set(getOptValue(OPT::PCH).c_str());
+                AddConditionalElement(xml, "PrecompiledHeaderFile", "'$(Configuration)|$(Platform)'=='Debug|Win32'",
+                                      pch);
+                AddConditionalElement(xml, "PrecompiledHeaderFile", "'$(Configuration)|$(Platform)'=='Release|Win32'",
+                                      pch);
             }
         }
+        xml.EndElement();
     }
+    xml.EndElement();
 
     if (GetRcFile().size())
     {
-        ItemGroup = Project.append_child("ItemGroup");
-        auto ResourceCompile = ItemGroup.append_child("ResourceCompile");
-        ResourceCompile.append_attribute("Include").set_value(GetRcFile().c_str());
+        xml.StartElement("ItemGroup");
+        xml.StartElement("ResourceCompile");
+        xml.Attribute("Include", GetRcFile());
+        xml.EndElement();
+        xml.EndElement();
     }
 
-    Import = Project.append_child("Import");
-    Import.append_attribute("Project").set_value("$(VCTargetsPath)\\Microsoft.Cpp.targets");
-
-    if (!doc.save_file(vc_project_file.c_str()))
-    {
-        std::cout << "Unable to create or write to " + vc_project_file << '\n';
-        return false;
-    }
-    else
-    {
-        std::cout << "Created " << vc_project_file << '\n';
-    }
+    xml.StartElement("Import");
+    xml.Attribute("Project", "$(VCTargetsPath)\\Microsoft.Cpp.targets");
+    xml.EndElement();
 
-    return CreateFilterFile(vc_project_file);
+    xml.EndElement();  // Project
 }
 
-bool CVcxWrite::CreateFilterFile(ttlib::cstr vc_project_file)
+template <typename T>
+void CVcxWrite::GenerateFilters(T& xml, const ttlib::cstr& guid_src, const ttlib::cstr& guid_hdr)
 {
-    vc_project_file.remove_extension();
-    vc_project_file += ".vcxproj.filters";
-
-    pugi::xml_document doc;
+    xml.StartElement("Project");
+    xml.Attribute("ToolsVersion", "4.0");
+    xml.Attribute("xmlns", "http://schemas.microsoft.com/developer/msbuild/2003");
 
-    auto Project = doc.append_child("Project");
-    Project.append_attribute("ToolsVersion").set_value("4.0");
-    Project.append_attribute("xmlns").set_value("http://schemas.microsoft.com/developer/msbuild/2003");
-
-    auto ItemGroup = Project.append_child("ItemGroup");
-    auto Filter = ItemGroup.append_child("Filter");
-    Filter.append_attribute("Include").set_value("Source Files");
+    xml.StartElement("ItemGroup");
+    xml.StartElement("Filter");
+    xml.Attribute("Include", "Source Files");
     {
-        ttlib::cstr guid;
-        CreateGuid(guid);
         ttlib::cstr gd;
-        gd << '{' << guid << '}';
-        Filter.append_child("UniqueIdentifier").text().set(gd.c_str());
-        Filter.append_child("Extensions").text().set("cpp;c;cc;cxx");
+        gd << '{' << guid_src << '}';
+        xml.TextElement("UniqueIdentifier", gd);
+        xml.TextElement("Extensions", "cpp;c;cc;cxx");
     }
+    xml.EndElement();
 
-    Filter = ItemGroup.append_child("Filter");
-    Filter.append_attribute("Include").set_value("Header Files");
+    xml.StartElement("Filter");
+    xml.Attribute("Include", "Header Files");
     {
-        ttlib::cstr guid;
-        CreateGuid(guid);
         ttlib::cstr gd;
-        gd << '{' << guid << '}';
-        Filter.append_child("UniqueIdentifier").text().set(gd.c_str());
-        Filter.append_child("Extensions").text().set("h;hh;hpp;hxx");
+        gd << '{' << guid_hdr << '}';
+        xml.TextElement("UniqueIdentifier", gd);
+        xml.TextElement("Extensions", "h;hh;hpp;hxx");
     }
+    xml.EndElement();
+    xml.EndElement();
 
-    ItemGroup = Project.append_child("ItemGroup");
+    xml.StartElement("ItemGroup");
+    ttlib::cstr include("Source Files\\");
+    auto prefix_length = include.size();
     for (auto& iter: GetSrcFileList())
     {
         if (iter.is_sameas(GetRcFile()))
             continue;
-        auto ClCompile = ItemGroup.append_child("ClCompile");
-        ttlib::cstr tmp("Source Files\\");
-        tmp += iter;
-        ClCompile.append_attribute("Include").set_value(tmp.c_str());
+        include.resize(prefix_length);
+        include += iter;
+        xml.StartElement("ClCompile");
+        xml.Attribute("Include", include);
+        xml.EndElement();
     }
+    xml.EndElement();
 
-    if (!doc.save_file(vc_project_file.c_str()))
-    {
-        std::cout << "Unable to create or write to " + vc_project_file << '\n';
-        return false;
-    }
-    else
-    {
-        std::cout << "Created " << vc_project_file << '\n';
-    }
+    xml.EndElement();  // Project
+}
 
-    return true;
+template <typename T>
+void CVcxWrite::AddConditionalElement(T& xml, std::string_view name, std::string_view condition,
+                                      std::string_view text)
+{
+    xml.StartElement(name);
+    xml.Attribute("Condition", condition);
+    xml.Text(text);
+    xml.EndElement();
 }
 
-void CVcxWrite::AddConfiguration(pugi::xml_node parent, GEN_TYPE gentype)
+template <typename T>
+void CVcxWrite::AddConfiguration(T& xml, GEN_TYPE gentype)
 {
-    auto configure = parent.append_child("ProjectConfiguration");
+    xml.StartElement("ProjectConfiguration");
     switch (gentype)
     {
         case GEN_DEBUG:
-            configure.append_attribute("Include").set_value("Debug|x64");
-            configure.append_child("Configuration").text().set("Debug");
-            configure.append_child("Platform").text().set("x64");
+            xml.Attribute("Include", "Debug|x64");
+            xml.TextElement("Configuration", "Debug");
+            xml.TextElement("Platform", "x64");
             break;
 
         case GEN_DEBUG32:
-            configure.append_attribute("Include").set_value("Debug|Win32");
-            configure.append_child("Configuration").text().set("Debug");
-            configure.append_child("Platform").text().set("Win32");
+            xml.Attribute("Include", "Debug|Win32");
+            xml.TextElement("Configuration", "Debug");
+            xml.TextElement("Platform", "Win32");
             break;
 
         case GEN_RELEASE:
-            configure.append_attribute("Include").set_value("Release|x64");
-            configure.append_child("Configuration").text().set("Release");
-            configure.append_child("Platform").text().set("x64");
+            xml.Attribute("Include", "Release|x64");
+            xml.TextElement("Configuration", "Release");
+            xml.TextElement("Platform", "x64");
             break;
 
         case GEN_RELEASE32:
-            configure.append_attribute("Include").set_value("Release|Win32");
-            configure.append_child("Configuration").text().set("Release");
-            configure.append_child("Platform").text().set("Win32");
+            xml.Attribute("Include", "Release|Win32");
+            xml.TextElement("Configuration", "Release");
+            xml.TextElement("Platform", "Win32");
             break;
 
         default:
             break;
     }
+    xml.EndElement();
 }
 
-void CVcxWrite::AddConfigAppType(pugi::xml_node parent, GEN_TYPE gentype)
+template <typename T>
+void CVcxWrite::AddConfigAppType(T& xml, GEN_TYPE gentype)
 {
     std::string type("Application");
     if (getOptValue(OPT::EXE_TYPE).is_sameas("lib"))
@@ -595,100 +736,84 @@ void CVcxWrite::AddConfigAppType(pugi::xml_node parent, GEN_TYPE gentype)
     if (getOptValue(OPT::EXE_TYPE).is_sameas("dll"))
         type = "Dynamic Library";
 
-    auto PropGroup = parent.append_child("PropertyGroup");
+    xml.StartElement("PropertyGroup");
 
     switch (gentype)
     {
         case GEN_DEBUG:
-            PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
+            xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Debug|x64'");
             break;
 
         case GEN_DEBUG32:
-            PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
+            xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Debug|Win32'");
             break;
 
         case GEN_RELEASE:
-            PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
+            xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Release|x64'");
             break;
 
         case GEN_RELEASE32:
-            PropGroup.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
+            xml.Attribute("Condition", "'$(Configuration)|$(Platform)'=='Release|Win32'");
             break;
 
         default:
             break;
     }
 
-    PropGroup.append_attribute("Label").set_value("Configuration");
-    PropGroup.append_child("ConfigurationType").text().set(type.c_str());
+    xml.Attribute("Label", "Configuration");
+    xml.TextElement("ConfigurationType", type);
 
     if (gentype == GEN_DEBUG || gentype == GEN_DEBUG32)
     {
-        PropGroup.append_child("UseDebugLibraries").text().set("true");
+        xml.TextElement("UseDebugLibraries", "true");
     }
     else
     {
-        PropGroup.append_child("UseDebugLibraries").text().set("false");
-        PropGroup.append_child("WholeProgramOptimization").text().set("true");
+        xml.TextElement("UseDebugLibraries", "false");
+        xml.TextElement("WholeProgramOptimization", "true");
     }
-    PropGroup.append_child("PlatformToolset").text().set("v142");
+    xml.TextElement("PlatformToolset", "v142");
     if (hasOptValue(OPT::INC_DIRS))
-        PropGroup.append_child("IncludePath").text().set(getOptValue(OPT::INC_DIRS).c_str());
+        xml.TextElement("IncludePath", getOptValue(OPT::INC_DIRS));
+    xml.EndElement();
 }
 
-void CVcxWrite::AddOutDirs(pugi::xml_node parent, GEN_TYPE gentype)
+template <typename T>
+void CVcxWrite::AddOutDirs(T& xml, GEN_TYPE gentype)
 {
-    pugi::xml_node dir;
     ttlib::cstr path;
 
     switch (gentype)
     {
         case GEN_DEBUG:
-            dir = parent.append_child("OutDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
             path = GetTargetDebug();
             path.remove_filename();
-            dir.text().set(path.c_str());
-
-            dir = parent.append_child("IntDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|x64'");
-            dir.text().set("bld\\msvc_Debug\\");
+            AddConditionalElement(xml, "OutDir", "'$(Configuration)|$(Platform)'=='Debug|x64'", path);
+            AddConditionalElement(xml, "IntDir", "'$(Configuration)|$(Platform)'=='Debug|x64'", "bld\\msvc_Debug\\");
             break;
 
         case GEN_DEBUG32:
-            dir = parent.append_child("OutDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
             path = GetTargetDebug32();
             path.remove_filename();
-            dir.text().set(path.c_str());
-
-            dir = parent.append_child("IntDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Debug|Win32'");
-            dir.text().set("bld\\msvc_Debug32\\");
+            AddConditionalElement(xml, "OutDir", "'$(Configuration)|$(Platform)'=='Debug|Win32'", path);
+            AddConditionalElement(xml, "IntDir", "'$(Configuration)|$(Platform)'=='Debug|Win32'",
+                                  "bld\\msvc_Debug32\\");
             break;
 
         case GEN_RELEASE:
-            dir = parent.append_child("OutDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
             path = GetTargetRelease();
             path.remove_filename();
-            dir.text().set(path.c_str());
-
-            dir = parent.append_child("IntDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|x64'");
-            dir.text().set("bld\\msvc_Release\\");
+            AddConditionalElement(xml, "OutDir", "'$(Configuration)|$(Platform)'=='Release|x64'", path);
+            AddConditionalElement(xml, "IntDir", "'$(Configuration)|$(Platform)'=='Release|x64'",
+                                  "bld\\msvc_Release\\");
             break;
 
         case GEN_RELEASE32:
-            dir = parent.append_child("OutDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
             path = GetTargetRelease32();
             path.remove_filename();
-            dir.text().set(path.c_str());
-
-            dir = parent.append_child("IntDir");
-            dir.append_attribute("Condition").set_value("'$(Configuration)|$(Platform)'=='Release|Win32'");
-            dir.text().set("bld\\msvc_Release32\\");
+            AddConditionalElement(xml, "OutDir", "'$(Configuration)|$(Platform)'=='Release|Win32'", path);
+            AddConditionalElement(xml, "IntDir", "'$(Configuration)|$(Platform)'=='Release|Win32'",
+                                  "bld\\msvc_Release32\\");
             break;
 
         default:
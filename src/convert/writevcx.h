@@ -9,11 +9,6 @@
 
 #include "ninja.h"  // CNinja
 
-namespace pugi
-{
-    class xml_node;
-}
-
 class CVcxWrite : public CNinja
 {
 public:
@@ -21,12 +16,30 @@ public:
 
     bool CreateBuildFile();
 
+    // Generates the .vcxproj and .vcxproj.filters content iterations times both with CXmlWriter and with a pugixml
+    // document, displays how long each took, and verifies that the output is identical. Nothing is written to disk.
+    bool Benchmark(size_t iterations);
+
 protected:
-    void AddOutDirs(pugi::xml_node parent, GEN_TYPE gentype);
-    void AddConfigAppType(pugi::xml_node parent, GEN_TYPE gentype);
-    void AddConfiguration(pugi::xml_node parent, GEN_TYPE gentype);
-    bool CreateFilterFile(ttlib::cstr vc_project_file);
+    // Locates the header file for every source file -- this only needs to be done once no matter how many times the
+    // project is generated.
+    void FindHeaders();
+
+    // T is either CXmlWriter or CXmlDomBuilder
+    template <typename T>
+    void GenerateProject(T& xml, const ttlib::cstr& guid);
+    template <typename T>
+    void GenerateFilters(T& xml, const ttlib::cstr& guid_src, const ttlib::cstr& guid_hdr);
+
+    template <typename T>
+    void AddOutDirs(T& xml, GEN_TYPE gentype);
+    template <typename T>
+    void AddConfigAppType(T& xml, GEN_TYPE gentype);
+    template <typename T>
+    void AddConfiguration(T& xml, GEN_TYPE gentype);
+    template <typename T>
+    void AddConditionalElement(T& xml, std::string_view name, std::string_view condition, std::string_view text);
 
 private:
-    pugi::xml_node* m_Project;
+    std::vector<ttlib::cstr> m_headers;
 };
@@ -9,6 +9,7 @@
 
 #include "wxWidgets_file.h"
 
+#include "plan.h"  // CPlan -- Records every file ttBld would write without writing any of them
 #include "ttcview_wx.h"
 
 // build/files doesn't include the C files, so we hard-code them here
@@ -506,7 +507,8 @@ int WidgetsFile::Convert(std::vector<ttlib::cstr>& files)
     }
     output += ")";
 
-    output.WriteFile(files[1]);
+    if (!CPlan::Get().Add(files[1], output, "wxWidgets CMake file list"))
+        output.WriteFile(files[1]);
 
     return 0;
 }
@@ -0,0 +1,516 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Single-pass XML reader that only keeps the elements a converter needs
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+
+#include "xmlstream.h"  // CXmlStream
+
+// Large enough that reading the file isn't a bottleneck, small enough that memory use doesn't depend on the file size
+static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+static bool IsWhiteSpace(char ch)
+{
+    return (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n');
+}
+
+static bool IsAllWhiteSpace(std::string_view str)
+{
+    for (auto ch: str)
+    {
+        if (!IsWhiteSpace(ch))
+            return false;
+    }
+    return true;
+}
+
+static void AppendUtf8(std::string& str, unsigned long ch)
+{
+    if (ch < 0x80)
+    {
+        str += static_cast<char>(ch);
+    }
+    else if (ch < 0x800)
+    {
+        str += static_cast<char>(0xC0 | (ch >> 6));
+        str += static_cast<char>(0x80 | (ch & 0x3F));
+    }
+    else if (ch < 0x10000)
+    {
+        str += static_cast<char>(0xE0 | (ch >> 12));
+        str += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+        str += static_cast<char>(0x80 | (ch & 0x3F));
+    }
+    else
+    {
+        str += static_cast<char>(0xF0 | (ch >> 18));
+        str += static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+        str += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+        str += static_cast<char>(0x80 | (ch & 0x3F));
+    }
+}
+
+// Expands entity references, and normalizes line endings the same way pugixml's default parse options do: "\r\n" and
+// "\r" become "\n" in text, and all whitespace characters become a space in attribute values.
+static std::string Decode(std::string_view raw, bool is_attribute)
+{
+    std::string result;
+    result.reserve(raw.size());
+
+    for (size_t pos = 0; pos < raw.size(); ++pos)
+    {
+        auto ch = raw[pos];
+        if (ch == '\r')
+        {
+            if (pos + 1 < raw.size() && raw[pos + 1] == '\n')
+                ++pos;
+            result += (is_attribute ? ' ' : '\n');
+        }
+        else if (is_attribute && (ch == '\n' || ch == '\t'))
+        {
+            result += ' ';
+        }
+        else if (ch == '&')
+        {
+            auto end = raw.find(';', pos);
+            if (end == std::string_view::npos)
+            {
+                result += ch;
+                continue;
+            }
+
+            auto entity = raw.substr(pos + 1, end - pos - 1);
+            if (entity == "amp")
+                result += '&';
+            else if (entity == "lt")
+                result += '<';
+            else if (entity == "gt")
+                result += '>';
+            else if (entity == "quot")
+                result += '"';
+            else if (entity == "apos")
+                result += '\'';
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                std::string digits(entity.substr(1));
+                int base = 10;
+                if (digits[0] == 'x' || digits[0] == 'X')
+                {
+                    digits.erase(0, 1);
+                    base = 16;
+                }
+                char* digits_end = nullptr;
+                auto value = std::strtoul(digits.c_str(), &digits_end, base);
+                if (digits.empty() || *digits_end)
+                {
+                    // Not a valid character reference, so leave it alone
+                    result += ch;
+                    continue;
+                }
+                AppendUtf8(result, value);
+            }
+            else
+            {
+                // Unknown entities are left as-is, which is what pugixml does
+                result += ch;
+                continue;
+            }
+            pos = end;
+        }
+        else
+        {
+            result += ch;
+        }
+    }
+
+    return result;
+}
+
+CXmlStream::CXmlStream(std::vector<std::string_view> paths)
+{
+    // Each path is tracked as a bit in Element::paths
+    assert(paths.size() <= 64);
+
+    for (auto iter: paths)
+    {
+        if (iter.size() && iter.back() == '@')
+        {
+            m_attributes_only |= (static_cast<uint64_t>(1) << m_paths.size());
+            iter.remove_suffix(1);
+        }
+
+        auto& names = m_paths.emplace_back();
+        size_t start = 0;
+        for (auto end = iter.find('/'); end != std::string_view::npos; end = iter.find('/', start))
+        {
+            names.emplace_back(iter.substr(start, end - start));
+            start = end + 1;
+        }
+        names.emplace_back(iter.substr(start));
+    }
+}
+
+bool CXmlStream::SetError(std::string_view msg)
+{
+    m_error.assign(msg);
+    m_error += " at offset ";
+    m_error += std::to_string(m_offset + m_pos);
+    return false;
+}
+
+void CXmlStream::CloseInput()
+{
+    if (m_file.is_open())
+        m_file.close();
+    m_mapping.Close();
+}
+
+bool CXmlStream::Fill(size_t count)
+{
+    while (m_view.size() - m_pos < count)
+    {
+        if (!m_file.is_open() || m_file.eof())
+            return false;
+
+        // Everything before m_pos has already been processed
+        if (m_pos)
+        {
+            m_buf.erase(0, m_pos);
+            m_offset += m_pos;
+            m_pos = 0;
+        }
+
+        auto old_size = m_buf.size();
+        m_buf.resize(old_size + READ_CHUNK_SIZE);
+        m_file.read(m_buf.data() + old_size, READ_CHUNK_SIZE);
+        auto bytes_read = static_cast<size_t>(m_file.gcount());
+        m_buf.resize(old_size + bytes_read);
+        m_view = m_buf;
+        if (!bytes_read)
+            return false;
+    }
+    return true;
+}
+
+size_t CXmlStream::Find(std::string_view str)
+{
+    size_t searched = 0;
+    for (;;)
+    {
+        if (auto found = m_view.find(str, m_pos + searched); found != std::string::npos)
+            return found - m_pos;
+
+        // Fill() can move the unprocessed data to the start of the buffer, so searched is relative to m_pos
+        auto available = m_view.size() - m_pos;
+        searched = (available >= str.size() ? available - str.size() + 1 : 0);
+        if (!Fill(available + 1))
+            return std::string::npos;
+    }
+}
+
+void CXmlStream::ReadText(std::string* text)
+{
+    for (;;)
+    {
+        auto found = m_view.find('<', m_pos);
+        auto end = (found == std::string::npos ? m_view.size() : found);
+        if (text)
+            text->append(m_view.substr(m_pos, end - m_pos));
+        m_pos = end;
+
+        // Text that isn't being kept is discarded a chunk at a time, so it never needs to fit in memory.
+        if (found != std::string::npos || !Fill(1))
+            return;
+    }
+}
+
+bool CXmlStream::LoadFile(const std::string& filename, pugi::xml_document& doc)
+{
+    doc.reset();
+    m_error.clear();
+    m_stack.clear();
+    m_buf.clear();
+    m_view = {};
+    m_pos = 0;
+    m_offset = 0;
+    m_found_root = false;
+
+    CloseInput();
+    m_file.clear();
+
+    // Tokenizing straight from a mapping of the file avoids copying it into m_buf. The chunked reads are only needed
+    // if the file can't be mapped.
+    auto path = std::filesystem::u8path(filename);
+    if (m_mapping.Open(filename))
+    {
+        m_view = std::string_view(m_mapping.data(), m_mapping.size());
+    }
+    else
+    {
+        m_file.open(path, std::ios::binary);
+        if (!m_file.is_open())
+        {
+            m_error = "File could not be opened";
+            return false;
+        }
+    }
+
+    if (Fill(4))
+    {
+        auto buf = reinterpret_cast<const unsigned char*>(m_view.data());
+        if ((buf[0] == 0xFF && buf[1] == 0xFE) || (buf[0] == 0xFE && buf[1] == 0xFF) || !buf[0] || !buf[1] || !buf[2] ||
+            !buf[3])
+        {
+            CloseInput();
+            if (auto result = doc.load_file(path.c_str()); !result)
+            {
+                m_error = result.description();
+                return false;
+            }
+            return true;
+        }
+
+        if (buf[0] == 0xEF && buf[1] == 0xBB && buf[2] == 0xBF)
+            m_pos = 3;
+    }
+
+    for (;;)
+    {
+        if (m_stack.size() && m_stack.back().keep_all)
+        {
+            std::string text;
+            ReadText(&text);
+            if (!IsAllWhiteSpace(text))
+                m_stack.back().node.append_child(pugi::node_pcdata).set_value(Decode(text, false));
+        }
+        else
+        {
+            ReadText(nullptr);
+        }
+
+        if (!Fill(1))
+            break;
+
+        if (!ReadMarkup(doc, m_stack.empty() || m_stack.back().keep_all))
+        {
+            CloseInput();
+            return false;
+        }
+    }
+
+    CloseInput();
+
+    if (m_stack.size())
+        return SetError(std::string("Unexpected end of file -- missing </") + m_stack.back().name + '>');
+    if (!m_found_root)
+        return SetError("No document element found");
+
+    return true;
+}
+
+// m_view[m_pos] is a '<' character
+bool CXmlStream::ReadMarkup(pugi::xml_node doc, bool keep)
+{
+    if (!Fill(2))
+        return SetError("Unexpected end of file");
+
+    if (m_view[m_pos + 1] == '?')
+    {
+        auto end = Find("?>");
+        if (end == std::string::npos)
+            return SetError("Unterminated processing instruction");
+        m_pos += end + 2;
+        return true;
+    }
+
+    if (m_view[m_pos + 1] == '!')
+    {
+        if (Fill(4) && m_view.compare(m_pos, 4, "<!--") == 0)
+        {
+            auto end = Find("-->");
+            if (end == std::string::npos)
+                return SetError("Unterminated comment");
+            m_pos += end + 3;
+            return true;
+        }
+
+        if (Fill(9) && m_view.compare(m_pos, 9, "<![CDATA[") == 0)
+        {
+            auto end = Find("]]>");
+            if (end == std::string::npos)
+                return SetError("Unterminated CDATA section");
+            if (keep && m_stack.size())
+                m_stack.back().node.append_child(pugi::node_cdata).set_value(m_view.substr(m_pos + 9, end - 9));
+            m_pos += end + 3;
+            return true;
+        }
+
+        // <!DOCTYPE ...> which may contain an internal subset inside [...]
+        auto end = Find(">");
+        if (end == std::string::npos)
+            return SetError("Unterminated declaration");
+        if (auto subset = m_view.find('[', m_pos); subset != std::string::npos && subset < m_pos + end)
+        {
+            m_pos = subset;
+            if (end = Find("]"); end == std::string::npos)
+                return SetError("Unterminated declaration");
+            m_pos += end;
+            if (end = Find(">"); end == std::string::npos)
+                return SetError("Unterminated declaration");
+        }
+        m_pos += end + 1;
+        return true;
+    }
+
+    if (m_view[m_pos + 1] == '/')
+    {
+        auto end = Find(">");
+        if (end == std::string::npos)
+            return SetError("Unterminated end tag");
+
+        std::string_view name(m_view.data() + m_pos + 2, end - 2);
+        while (name.size() && IsWhiteSpace(name.back()))
+            name.remove_suffix(1);
+
+        if (m_stack.empty() || name != m_stack.back().name)
+            return SetError(std::string("Unexpected end tag </") + std::string(name) + '>');
+
+        m_stack.pop_back();
+        m_pos += end + 1;
+        return true;
+    }
+
+    std::string tag;
+    if (!ReadStartTag(tag))
+        return false;
+
+    std::string name;
+    auto name_end = tag.find_first_of(" \t\r\n/");
+    name.assign(tag, 0, name_end);
+    if (name.empty())
+        return SetError("Invalid start tag");
+
+    m_found_root = true;
+
+    Element element { name, {}, 0, false };
+    if (m_stack.size() && m_stack.back().keep_all)
+    {
+        element.keep_all = true;
+        element.node = m_stack.back().node.append_child(name);
+    }
+    else
+    {
+        auto depth = m_stack.size();
+        auto parent_paths = (m_stack.size() ? m_stack.back().paths : ~static_cast<uint64_t>(0));
+        for (size_t idx = 0; idx < m_paths.size(); ++idx)
+        {
+            if (!(parent_paths & (static_cast<uint64_t>(1) << idx)))
+                continue;
+            if (depth < m_paths[idx].size() && m_paths[idx][depth] == name)
+            {
+                element.paths |= (static_cast<uint64_t>(1) << idx);
+                if (depth + 1 == m_paths[idx].size() && !(m_attributes_only & (static_cast<uint64_t>(1) << idx)))
+                    element.keep_all = true;
+            }
+        }
+
+        // Elements that are on the way to a requested path are created, but not their text or any children that
+        // aren't on a requested path.
+        if (element.paths)
+            element.node = (m_stack.size() ? m_stack.back().node : doc).append_child(name);
+    }
+
+    bool is_empty = false;
+    if (!ParseStartTag(std::string_view(tag).substr(name.size()), name, element.node, &is_empty))
+        return false;
+
+    if (!is_empty)
+        m_stack.emplace_back(std::move(element));
+
+    return true;
+}
+
+// Reads everything between '<' and the matching '>' into tag. A '>' inside a quoted attribute value does not end the
+// tag.
+bool CXmlStream::ReadStartTag(std::string& tag)
+{
+    size_t idx = 1;
+    char quote = 0;
+    for (;;)
+    {
+        if (m_pos + idx >= m_view.size() && !Fill(idx + 1))
+            return SetError("Unterminated start tag");
+
+        auto ch = m_view[m_pos + idx];
+        if (quote)
+        {
+            if (ch == quote)
+                quote = 0;
+        }
+        else if (ch == '"' || ch == '\'')
+        {
+            quote = ch;
+        }
+        else if (ch == '>')
+        {
+            break;
+        }
+        ++idx;
+    }
+
+    tag.assign(m_view.substr(m_pos + 1, idx - 1));
+    m_pos += idx + 1;
+    return true;
+}
+
+// attributes is everything in the start tag after the element name. If node is empty, the attributes are checked but
+// not stored.
+bool CXmlStream::ParseStartTag(std::string_view attributes, const std::string& name, pugi::xml_node node,
+                               bool* is_empty)
+{
+    size_t pos = 0;
+    for (;;)
+    {
+        while (pos < attributes.size() && IsWhiteSpace(attributes[pos]))
+            ++pos;
+        if (pos >= attributes.size())
+            return true;
+
+        if (attributes[pos] == '/')
+        {
+            if (pos + 1 != attributes.size())
+                return SetError(std::string("Invalid start tag <") + name + '>');
+            *is_empty = true;
+            return true;
+        }
+
+        auto name_start = pos;
+        while (pos < attributes.size() && attributes[pos] != '=' && !IsWhiteSpace(attributes[pos]))
+            ++pos;
+        auto attr_name = attributes.substr(name_start, pos - name_start);
+
+        while (pos < attributes.size() && IsWhiteSpace(attributes[pos]))
+            ++pos;
+        if (pos >= attributes.size() || attributes[pos] != '=')
+            return SetError(std::string("Attribute without a value in <") + name + '>');
+        ++pos;
+        while (pos < attributes.size() && IsWhiteSpace(attributes[pos]))
+            ++pos;
+
+        if (pos >= attributes.size() || (attributes[pos] != '"' && attributes[pos] != '\''))
+            return SetError(std::string("Attribute value is not quoted in <") + name + '>');
+        auto quote = attributes[pos++];
+        auto value_end = attributes.find(quote, pos);
+        if (value_end == std::string_view::npos)
+            return SetError(std::string("Unterminated attribute value in <") + name + '>');
+
+        if (node)
+            node.append_attribute(attr_name).set_value(Decode(attributes.substr(pos, value_end - pos), true));
+        pos = value_end + 1;
+    }
+}
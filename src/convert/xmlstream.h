@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Single-pass XML reader that only keeps the elements a converter needs
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../pugixml/pugixml.hpp"  // pugixml parser
+
+#include "mappedfile.h"  // CMappedFile -- Private, copy-on-write memory mapping of a file
+
+// Generated project files (particularly the older .vcproj format) can be tens of megabytes, nearly all of which is
+// per-file configuration data that the converters never look at. Rather than loading the entire file into a DOM, this
+// class tokenizes the file directly from a memory mapping (or in fixed-size chunks if it can't be mapped) and only
+// copies the elements matching one of the requested paths into the document. The existing XPath queries and node walks
+// then run against a document containing only what they need.
+//
+// Each path is a list of element names separated by '/' starting with the root element, e.g.
+// "Project/ItemGroup/ClCompile". An element matching a path is copied along with everything it contains. The
+// elements leading to it are copied with their attributes, but none of their other children are.
+//
+// A path ending with '@' (e.g. "Project/ItemGroup/ClCompile@") copies the matching element with its attributes only --
+// its children (such as per-file <FileConfiguration> settings) are discarded.
+class CXmlStream
+{
+public:
+    CXmlStream(std::vector<std::string_view> paths);
+
+    // Returns false if the file cannot be read or is not well-formed, in which case GetError() contains the reason.
+    //
+    // UTF-16 and UTF-32 files are not supported by the tokenizer -- these are passed to doc.load_file() instead.
+    bool LoadFile(const std::string& filename, pugi::xml_document& doc);
+
+    const std::string& GetError() const { return m_error; }
+
+protected:
+    // Makes certain at least count bytes are available starting at m_pos. Returns false if the file ends first.
+    bool Fill(size_t count);
+
+    // Returns the offset of str from m_pos, reading more of the file as needed, or std::string::npos.
+    size_t Find(std::string_view str);
+
+    // Skips (or appends to text if it isn't nullptr) everything up to the next '<'
+    void ReadText(std::string* text);
+
+    bool ReadMarkup(pugi::xml_node doc, bool keep);
+    bool ReadStartTag(std::string& tag);
+    bool ParseStartTag(std::string_view tag, const std::string& name, pugi::xml_node node, bool* is_empty);
+
+    bool SetError(std::string_view msg);
+    void CloseInput();
+
+    struct Element
+    {
+        std::string name;
+        pugi::xml_node node;  // empty if the element is being skipped
+        uint64_t paths;       // bit mask of m_paths that still match this element's ancestry
+        bool keep_all;
+    };
+
+private:
+    std::vector<std::vector<std::string>> m_paths;
+    uint64_t m_attributes_only { 0 };  // bit mask of m_paths that ended with '@'
+    std::vector<Element> m_stack;
+
+    CMappedFile m_mapping;
+    std::ifstream m_file;
+    std::string m_buf;  // only used if the file can't be mapped
+
+    std::string_view m_view;  // the data being tokenized -- either the mapping or m_buf
+    size_t m_pos { 0 };
+    size_t m_offset { 0 };  // file offset of m_buf[0], used for error messages
+
+    bool m_found_root { false };
+
+    std::string m_error;
+};
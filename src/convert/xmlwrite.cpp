@@ -0,0 +1,169 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Streaming XML writer with the same output as a saved pugixml document
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+
+#include "xmlwrite.h"  // CXmlWriter -- Streaming XML writer with the same output as a saved pugixml document
+
+CXmlWriter::CXmlWriter(size_t reserve_size)
+{
+    m_buffer.reserve(reserve_size);
+    m_buffer += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+}
+
+void CXmlWriter::CloseStartTag()
+{
+    if (m_start_tag_open)
+    {
+        m_buffer += '>';
+        m_start_tag_open = false;
+    }
+}
+
+void CXmlWriter::WriteIndent(size_t depth)
+{
+    m_buffer.append(depth, '\t');
+}
+
+void CXmlWriter::StartElement(std::string_view name)
+{
+    assert(!m_has_text);
+
+    // The root element immediately follows the declaration
+    if (m_open_elements.size())
+    {
+        CloseStartTag();
+        m_buffer += '\n';
+        WriteIndent(m_open_elements.size());
+    }
+
+    m_buffer += '<';
+    m_buffer += name;
+    m_open_elements.emplace_back(name);
+    m_start_tag_open = true;
+}
+
+void CXmlWriter::Attribute(std::string_view name, std::string_view value)
+{
+    assert(m_start_tag_open);
+
+    m_buffer += ' ';
+    m_buffer += name;
+    m_buffer += "=\"";
+    WriteEscaped(value, true);
+    m_buffer += '"';
+}
+
+void CXmlWriter::Text(std::string_view text)
+{
+    assert(m_start_tag_open);
+
+    CloseStartTag();
+    WriteEscaped(text, false);
+    m_has_text = true;
+}
+
+void CXmlWriter::EndElement()
+{
+    assert(m_open_elements.size());
+
+    auto name = m_open_elements.back();
+    m_open_elements.pop_back();
+
+    if (m_start_tag_open)
+    {
+        m_buffer += " />";
+        m_start_tag_open = false;
+    }
+    else
+    {
+        if (!m_has_text)
+        {
+            m_buffer += '\n';
+            WriteIndent(m_open_elements.size());
+        }
+        m_buffer += "</";
+        m_buffer += name;
+        m_buffer += '>';
+    }
+    m_has_text = false;
+
+    if (m_open_elements.empty())
+        m_buffer += '\n';
+}
+
+void CXmlWriter::WriteEscaped(std::string_view value, bool is_attribute)
+{
+    size_t start = 0;
+    for (size_t pos = 0; pos < value.size(); ++pos)
+    {
+        auto ch = static_cast<unsigned char>(value[pos]);
+
+        const char* entity = nullptr;
+        switch (ch)
+        {
+            case '&':
+                entity = "&amp;";
+                break;
+
+            case '<':
+                entity = "&lt;";
+                break;
+
+            case '>':
+                if (!is_attribute)
+                    entity = "&gt;";
+                break;
+
+            case '"':
+                if (is_attribute)
+                    entity = "&quot;";
+                break;
+
+            case '\t':
+            case '\n':
+            case '\r':
+                if (!is_attribute)
+                    continue;
+                break;
+
+            default:
+                break;
+        }
+
+        if (!entity && ch >= 32)
+            continue;
+
+        m_buffer.append(value.data() + start, pos - start);
+        start = pos + 1;
+
+        if (entity)
+        {
+            m_buffer += entity;
+        }
+        else
+        {
+            // pugixml always writes control characters as two decimal digits
+            m_buffer += "&#";
+            m_buffer += static_cast<char>('0' + ch / 10);
+            m_buffer += static_cast<char>('0' + ch % 10);
+            m_buffer += ';';
+        }
+    }
+    m_buffer.append(value.data() + start, value.size() - start);
+}
+
+bool CXmlWriter::WriteFile(const std::string& filename) const
+{
+    std::ofstream file(std::filesystem::u8path(filename), std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    return file.good();
+}
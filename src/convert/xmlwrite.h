@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Streaming XML writer with the same output as a saved pugixml document
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../pugixml/pugixml.hpp"  // pugixml parser
+
+// Writes XML directly into a string. The output is byte-for-byte identical to building the same elements in a
+// pugixml document and calling save_file() with its default settings (tab indentation and a UTF-8 declaration), but
+// without allocating a node for every element, attribute and text value.
+//
+// The element name passed to StartElement() must remain valid until the matching EndElement() -- in practice these are
+// always string literals.
+class CXmlWriter
+{
+public:
+    CXmlWriter(size_t reserve_size = 64 * 1024);
+
+    void StartElement(std::string_view name);
+    void Attribute(std::string_view name, std::string_view value);
+
+    // Sets the text of the current element. An element with text cannot also have child elements.
+    void Text(std::string_view text);
+
+    void EndElement();
+
+    void TextElement(std::string_view name, std::string_view text)
+    {
+        StartElement(name);
+        Text(text);
+        EndElement();
+    }
+
+    // The document is only complete once every element has been ended.
+    const std::string& str() const { return m_buffer; }
+
+    bool WriteFile(const std::string& filename) const;
+
+protected:
+    void CloseStartTag();
+    void WriteIndent(size_t depth);
+
+    // pugixml escapes different characters in attribute values than it does in text, and this must do the same.
+    void WriteEscaped(std::string_view value, bool is_attribute);
+
+private:
+    std::string m_buffer;
+    std::vector<std::string_view> m_open_elements;
+
+    bool m_start_tag_open { false };
+    bool m_has_text { false };
+};
+
+// Builds a pugixml document using the same calls as CXmlWriter, so that the same generator code can produce either a
+// document or a stream.
+class CXmlDomBuilder
+{
+public:
+    CXmlDomBuilder(pugi::xml_node parent) : m_node(parent) {}
+
+    void StartElement(std::string_view name) { m_node = m_node.append_child(name); }
+    void Attribute(std::string_view name, std::string_view value) { m_node.append_attribute(name).set_value(value); }
+    void Text(std::string_view text) { m_node.text().set(text); }
+    void EndElement() { m_node = m_node.parent(); }
+
+    void TextElement(std::string_view name, std::string_view text) { m_node.append_child(name).text().set(text); }
+
+private:
+    pugi::xml_node m_node;
+};
@@ -10,6 +10,8 @@
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 
 #include "ninja.h"  // CNinja
+#include "plan.h"   // CPlan -- Records every file ttBld would write without writing any of them
+#include "trace.h"  // CTrace -- Scoped timers and counters exported as a Chrome trace
 
 const char* res_makefile =
 #include "res/makefile"
@@ -23,6 +25,8 @@ extern const char* txtHelpNinja;
 
 bool CNinja::CreateMakeFile(MAKE_TYPE type)
 {
+    TRACE_SCOPE("CNinja::CreateMakeFile");
+
     ttlib::cstr MakeFile(type == MAKE_TYPE::normal ? "makefile" : "bld/makefile");
 
     if (type == MAKE_TYPE::normal && MakeFile.file_exists())
@@ -117,6 +121,10 @@ bool CNinja::CreateMakeFile(MAKE_TYPE type)
         file.insertLine(1, "# Changes you make will be lost if it is auto-generated again!");
         file.insertEmptyLine(2);
     }
+    CTrace::Count(TRACE_COUNTER::lines_emitted, static_cast<int64_t>(file.size()));
+
+    if (CPlan::Get().Add(MakeFile, file, type == MAKE_TYPE::normal ? "makefile" : "auto-generated makefile"))
+        return false;  // because we didn't write anything
 
     // If the makefile already exists, don't write to it unless something has actually changed
 
@@ -7,13 +7,14 @@
 
 #include <utility>
 
-#include <wx/filefn.h>  // File- and directory-related functions
-
 #include "ttcwd.h"          // Class for storing and optionally restoring the current directory
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 #include <tttextfile_wx.h>  // Classes for reading and writing line-oriented files
 
 #include "csrcfiles.h"  // CSrcFiles
+#include "gitignore.h"  // CGitIgnore -- Compiled .gitignore and .git/info/exclude matcher
+#include "globindex.h"  // CGlobIndex -- Incremental index of the directories searched by wildcard patterns
+#include "trace.h"      // CTrace -- Scoped timers and counters exported as a Chrome trace
 
 CSrcFiles::CSrcFiles() {}
 
@@ -24,6 +25,8 @@ CSrcFiles::CSrcFiles(std::string_view NinjaDir)
 
 bool CSrcFiles::ReadFile(std::string_view filename)
 {
+    TRACE_SCOPE("CSrcFiles::ReadFile");
+
     if (filename.empty())
     {
         auto project = locateProjectFile();
@@ -45,12 +48,18 @@ bool CSrcFiles::ReadFile(std::string_view filename)
         m_bldFolder.replace_filename(txtDefBuildDir);
     }
 
+    AddInputFile(m_srcfilename);
     ttlib::viewfile SrcFile;
     if (!SrcFile.ReadFile(m_srcfilename))
     {
         AddError("Cannot open " + m_srcfilename);
         return false;
     }
+    if (CTrace::IsEnabled())
+    {
+        for (auto& line: SrcFile)
+            CTrace::Count(TRACE_COUNTER::bytes_read, static_cast<int64_t>(line.size() + 1));
+    }
 
     m_bRead = true;
 
@@ -281,6 +290,22 @@ void CSrcFiles::AddCompilerFlag(std::string_view flag)
     m_Options[OPT::CFLAGS_CMN].value += flag;
 }
 
+void CSrcFiles::AddInputFile(std::string_view filename)
+{
+    ttlib::cstr path(filename);
+    path.make_absolute();
+    path.backslashestoforward();
+    ttlib::add_if(m_lstInputFiles, path);
+}
+
+void CSrcFiles::AddInputs(const CSrcFiles& other)
+{
+    for (auto& iter: other.m_lstInputFiles)
+        ttlib::add_if(m_lstInputFiles, iter);
+    for (auto& iter: other.m_lstInputDirs)
+        ttlib::add_if(m_lstInputDirs, iter);
+}
+
 void CSrcFiles::ProcessFile(std::string_view line)
 {
     if (ttlib::is_sameprefix(line, ".include", tt::CASE::either))
@@ -307,6 +332,7 @@ void CSrcFiles::ProcessFile(std::string_view line)
         ttlib::cstr root(line);
         root.remove_filename();
 
+        AddInputFile(filename);
         ttlib::viewfile cmake_files;
         if (cmake_files.ReadFile(filename))
         {
@@ -377,6 +403,7 @@ void CSrcFiles::ProcessDebugFile(std::string_view line)
         ttlib::cstr root(line);
         root.remove_filename();
 
+        AddInputFile(line);
         ttlib::viewfile cmake_files;
         if (cmake_files.ReadFile(line))
         {
@@ -514,11 +541,13 @@ void CSrcFiles::ProcessIncludeDirective(std::string_view file, ttlib::cstr root)
         return;
     }
 
+    AddInputFile(FullPath);
     if (!cIncSrcFiles.ReadFile(FullPath))
     {
         AddError("Unable to locate the file " + FullPath);
         return;
     }
+    AddInputs(cIncSrcFiles);
 
     for (auto& incFile: cIncSrcFiles.m_lstSrcFiles)
     {
@@ -535,25 +564,45 @@ void CSrcFiles::AddSourcePattern(std::string_view FilePattern)
     if (FilePattern.empty())
         return;
 
+    TRACE_SCOPE("CSrcFiles::AddSourcePattern");
+
+    // Generated files (build output, etc.) are typically ignored by git, and should never be added as source files
+    auto gitignore = CGitIgnore::Get();
+
+    // Only directories that changed since the last time the scripts were generated are enumerated again
+    auto globIndex = CGlobIndex::Get(GetBuildScriptDir());
+
     ttlib::multistr enumPattern(FilePattern, ';');
     for (auto& pattern: enumPattern)
     {
-        ttString name = wxFindFirstFile(pattern.wx_str(), wxFILE);
-        while (!name.empty())
+        ttlib::cstr dir(pattern);
+        dir.remove_filename();
+        if (dir.empty())
+            dir = "./";
+        dir.make_absolute();
+        dir.backslashestoforward();
+        if (dir.size() > 1 && dir.back() == '/')
+            dir.pop_back();
+        ttlib::add_if(m_lstInputDirs, dir);
+
+        for (auto& name: globIndex->Match(pattern))
         {
+            if (gitignore->IsIgnored(name))
+                continue;
+
             if (name.has_extension(".c") || name.has_extension(".cc") || name.has_extension(".cpp") ||
                 name.has_extension(".cxx"))
             {
                 if (m_section == SECTION_DEBUG_FILES)
-                    ttlib::add_if(m_lstDebugFiles, name.sub_cstr());
+                    ttlib::add_if(m_lstDebugFiles, name);
                 else
-                    ttlib::add_if(m_lstSrcFiles, name.sub_cstr());
+                    ttlib::add_if(m_lstSrcFiles, name);
             }
             else if (name.has_extension(".rc"))
             {
                 if (m_section != SECTION_DEBUG_FILES)
                 {
-                    ttlib::add_if(m_lstSrcFiles, name.sub_cstr());
+                    ttlib::add_if(m_lstSrcFiles, name);
                     m_RCname = name;
                 }
             }
@@ -568,12 +617,10 @@ void CSrcFiles::AddSourcePattern(std::string_view FilePattern)
             {
                 if (m_section != SECTION_DEBUG_FILES)
                 {
-                    ttlib::add_if(m_lstSrcFiles, name.sub_cstr());
-                    ttlib::add_if(m_lstIdlFiles, name.sub_cstr());
+                    ttlib::add_if(m_lstSrcFiles, name);
+                    ttlib::add_if(m_lstIdlFiles, name);
                 }
             }
-
-            wxFindNextFile();
         }
     }
 }
@@ -138,6 +138,14 @@ public:
 
     void SetReportingFile(std::string_view filename) { m_ReportPath = filename; }
 
+    // Every file that was read (.srcfiles.yaml, .include files, .cmake file lists) and every directory that was
+    // searched for a wildcard pattern. All paths are absolute, using forward slashes.
+    const std::vector<ttlib::cstr>& GetInputFiles() const { return m_lstInputFiles; }
+    const std::vector<ttlib::cstr>& GetInputDirs() const { return m_lstInputDirs; }
+
+    // Adds the input files and directories of another project (.include or BuildLibs:)
+    void AddInputs(const CSrcFiles& other);
+
     void AddError(std::string_view err);
 
     // Initialize default options
@@ -180,6 +188,8 @@ protected:
 
     void AddCompilerFlag(std::string_view flag);
 
+    void AddInputFile(std::string_view filename);
+
     const ttlib::cstr& GetReportFilename() { return m_ReportPath; }
 
 protected:
@@ -201,6 +211,9 @@ protected:
 
     std::vector<ttlib::cstr> m_lstIncludeSrcFiles;
 
+    std::vector<ttlib::cstr> m_lstInputFiles;  // Files read while processing the project file
+    std::vector<ttlib::cstr> m_lstInputDirs;   // Directories searched for wildcard patterns
+
     ttlib::cstr m_pchCPPname;
 
     OPT::value FindOption(const std::string_view name) const;
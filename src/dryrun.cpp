@@ -5,10 +5,222 @@
 // License:   Apache License see ../LICENSE
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "dryrun.h"  // CDryRun
 
+// Number of unchanged lines displayed before and after each change
+static constexpr size_t DIFF_CONTEXT = 3;
+
+// Line diff using Myers' O(ND) algorithm in its linear-space form: each range is split at the "middle snake" found
+// by searching forward from the start and backward from the end at the same time, and the two halves are then
+// compared recursively. Every line is first interned to an integer so that comparisons don't touch the text again,
+// and lines that only appear in one of the files are removed before comparing since they can never be matched -- a
+// completely rewritten file doesn't need to be searched at all.
+class CLineDiff
+{
+public:
+    CLineDiff(const std::vector<std::string_view>& org, const std::vector<std::string_view>& updated);
+
+    // true if the line in the original file was removed
+    const std::vector<bool>& GetDeleted() const { return m_deleted; }
+
+    // true if the line in the new file was added
+    const std::vector<bool>& GetInserted() const { return m_inserted; }
+
+protected:
+    void Compare(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi);
+
+    // Sets the start and end of the middle snake (relative to a_lo and b_lo) of a range that has no common prefix or
+    // suffix.
+    void FindMiddleSnake(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi, size_t& x_start, size_t& y_start,
+                         size_t& x_end, size_t& y_end);
+
+private:
+    // Interned lines that appear in both files, and the line number each one came from
+    std::vector<size_t> m_a;
+    std::vector<size_t> m_b;
+    std::vector<size_t> m_a_lines;
+    std::vector<size_t> m_b_lines;
+
+    std::vector<bool> m_deleted;
+    std::vector<bool> m_inserted;
+
+    // Furthest x reached on each diagonal, offset so that negative diagonals can be used as indices
+    std::vector<ptrdiff_t> m_forward;
+    std::vector<ptrdiff_t> m_backward;
+};
+
+CLineDiff::CLineDiff(const std::vector<std::string_view>& org, const std::vector<std::string_view>& updated)
+{
+    std::unordered_map<std::string_view, size_t> ids;
+    ids.reserve(org.size() + updated.size());
+
+    std::vector<size_t> org_ids;
+    org_ids.reserve(org.size());
+    for (auto& iter: org)
+        org_ids.push_back(ids.emplace(iter, ids.size()).first->second);
+    std::vector<size_t> updated_ids;
+    updated_ids.reserve(updated.size());
+    for (auto& iter: updated)
+        updated_ids.push_back(ids.emplace(iter, ids.size()).first->second);
+
+    // bit 0 set if the line is in the original file, bit 1 set if it is in the new file
+    std::vector<unsigned char> found_in(ids.size());
+    for (auto id: org_ids)
+        found_in[id] |= 1;
+    for (auto id: updated_ids)
+        found_in[id] |= 2;
+
+    m_deleted.resize(org.size());
+    m_inserted.resize(updated.size());
+
+    for (size_t line = 0; line < org_ids.size(); ++line)
+    {
+        if (found_in[org_ids[line]] == 3)
+        {
+            m_a.push_back(org_ids[line]);
+            m_a_lines.push_back(line);
+        }
+        else
+        {
+            m_deleted[line] = true;
+        }
+    }
+    for (size_t line = 0; line < updated_ids.size(); ++line)
+    {
+        if (found_in[updated_ids[line]] == 3)
+        {
+            m_b.push_back(updated_ids[line]);
+            m_b_lines.push_back(line);
+        }
+        else
+        {
+            m_inserted[line] = true;
+        }
+    }
+
+    auto size = 2 * (m_a.size() + m_b.size()) + 3;
+    m_forward.resize(size);
+    m_backward.resize(size);
+
+    Compare(0, m_a.size(), 0, m_b.size());
+}
+
+void CLineDiff::Compare(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi)
+{
+    while (a_lo < a_hi && b_lo < b_hi && m_a[a_lo] == m_b[b_lo])
+    {
+        ++a_lo;
+        ++b_lo;
+    }
+    while (a_lo < a_hi && b_lo < b_hi && m_a[a_hi - 1] == m_b[b_hi - 1])
+    {
+        --a_hi;
+        --b_hi;
+    }
+
+    if (a_lo == a_hi)
+    {
+        for (; b_lo < b_hi; ++b_lo)
+            m_inserted[m_b_lines[b_lo]] = true;
+        return;
+    }
+    if (b_lo == b_hi)
+    {
+        for (; a_lo < a_hi; ++a_lo)
+            m_deleted[m_a_lines[a_lo]] = true;
+        return;
+    }
+
+    size_t x_start, y_start, x_end, y_end;
+    FindMiddleSnake(a_lo, a_hi, b_lo, b_hi, x_start, y_start, x_end, y_end);
+
+    Compare(a_lo, a_lo + x_start, b_lo, b_lo + y_start);
+    Compare(a_lo + x_end, a_hi, b_lo + y_end, b_hi);
+}
+
+void CLineDiff::FindMiddleSnake(size_t a_lo, size_t a_hi, size_t b_lo, size_t b_hi, size_t& x_start,
+                                size_t& y_start, size_t& x_end, size_t& y_end)
+{
+    const auto* a = m_a.data() + a_lo;
+    const auto* b = m_b.data() + b_lo;
+    const auto n = static_cast<ptrdiff_t>(a_hi - a_lo);
+    const auto m = static_cast<ptrdiff_t>(b_hi - b_lo);
+    const auto delta = n - m;
+    const bool isOdd = (delta & 1) != 0;
+    const auto max_d = (n + m + 1) / 2;
+
+    // Diagonal k in the backward search is measured from the end of both ranges, and corresponds to diagonal
+    // delta - k in the forward search.
+    const auto offset = max_d + 1;
+    auto* forward = m_forward.data() + offset;
+    auto* backward = m_backward.data() + offset;
+    forward[1] = 0;
+    backward[1] = 0;
+
+    for (ptrdiff_t d = 0; d <= max_d; ++d)
+    {
+        for (ptrdiff_t k = -d; k <= d; k += 2)
+        {
+            auto x = (k == -d || (k != d && forward[k - 1] < forward[k + 1])) ? forward[k + 1] : forward[k - 1] + 1;
+            auto y = x - k;
+            auto x0 = x;
+            auto y0 = y;
+            while (x < n && y < m && a[x] == b[y])
+            {
+                ++x;
+                ++y;
+            }
+            forward[k] = x;
+
+            auto k_back = delta - k;
+            if (isOdd && k_back >= -(d - 1) && k_back <= d - 1 && x + backward[k_back] >= n)
+            {
+                x_start = static_cast<size_t>(x0);
+                y_start = static_cast<size_t>(y0);
+                x_end = static_cast<size_t>(x);
+                y_end = static_cast<size_t>(y);
+                return;
+            }
+        }
+
+        for (ptrdiff_t k = -d; k <= d; k += 2)
+        {
+            auto x =
+                (k == -d || (k != d && backward[k - 1] < backward[k + 1])) ? backward[k + 1] : backward[k - 1] + 1;
+            auto y = x - k;
+            auto x0 = x;
+            auto y0 = y;
+            while (x < n && y < m && a[n - x - 1] == b[m - y - 1])
+            {
+                ++x;
+                ++y;
+            }
+            backward[k] = x;
+
+            auto k_fwd = delta - k;
+            if (!isOdd && k_fwd >= -d && k_fwd <= d && x + forward[k_fwd] >= n)
+            {
+                x_start = static_cast<size_t>(n - x);
+                y_start = static_cast<size_t>(m - y);
+                x_end = static_cast<size_t>(n - x0);
+                y_end = static_cast<size_t>(m - y0);
+                return;
+            }
+        }
+    }
+
+    // Unreachable -- the searches always meet by the time d reaches max_d. Treat the range as entirely replaced.
+    x_start = y_start = 0;
+    x_end = static_cast<size_t>(n);
+    y_end = static_cast<size_t>(m);
+}
+
 void CDryRun::NewFile(std::string_view filename)
 {
     ASSERT(!filename.empty());
@@ -18,30 +230,124 @@ void CDryRun::NewFile(std::string_view filename)
 
 void CDryRun::DisplayFileDiff(const ttlib::viewfile& orgfile, const ttlib::textfile& newfile)
 {
-    if (!m_filename.empty())
+    std::vector<std::string_view> org_lines(orgfile.begin(), orgfile.end());
+    std::vector<std::string_view> new_lines(newfile.begin(), newfile.end());
+    DisplayFileDiff(org_lines, new_lines);
+}
+
+void CDryRun::DisplayFileDiff(const std::vector<std::string_view>& org_lines,
+                              const std::vector<std::string_view>& new_lines)
+{
+    CLineDiff diff(org_lines, new_lines);
+    auto& deleted = diff.GetDeleted();
+    auto& inserted = diff.GetInserted();
+
+    enum : char
     {
-        std::cout << m_filename << " dryrun changes:" << '\n';
+        op_same = ' ',
+        op_delete = '-',
+        op_insert = '+',
+    };
+
+    // Convert to an edit script, with deletions placed before the insertions that replace them
+    std::vector<char> script;
+    script.reserve(org_lines.size() + new_lines.size());
+    for (size_t posOrg = 0, posNew = 0; posOrg < org_lines.size() || posNew < new_lines.size();)
+    {
+        if (posOrg < org_lines.size() && deleted[posOrg])
+        {
+            script.push_back(op_delete);
+            ++posOrg;
+        }
+        else if (posNew < new_lines.size() && inserted[posNew])
+        {
+            script.push_back(op_insert);
+            ++posNew;
+        }
+        else
+        {
+            script.push_back(op_same);
+            ++posOrg;
+            ++posNew;
+        }
+    }
+
+    if (std::all_of(script.begin(), script.end(), [](char op) { return op == op_same; }))
+    {
+        if (!m_filename.empty())
+            std::cout << m_filename << " dryrun: no changes" << '\n';
+        return;
     }
 
+    std::cout << "--- " << (m_filename.empty() ? "original" : m_filename.c_str()) << '\n';
+    std::cout << "+++ " << (m_filename.empty() ? "dryrun" : m_filename.c_str()) << " (dryrun)" << '\n';
+
     size_t posOrg = 0;
     size_t posNew = 0;
-
-    for (; posOrg < orgfile.size() && posNew < newfile.size(); ++posOrg, ++posNew)
+    size_t pos = 0;
+    while (pos < script.size())
     {
-        if (!newfile[posOrg].is_sameas(orgfile[posNew]))
+        // Skip to the next change
+        auto first_change = pos;
+        while (first_change < script.size() && script[first_change] == op_same)
+            ++first_change;
+        if (first_change >= script.size())
+            break;
+
+        auto hunk_start = first_change > pos + DIFF_CONTEXT ? first_change - DIFF_CONTEXT : pos;
+        posOrg += hunk_start - pos;
+        posNew += hunk_start - pos;
+
+        // Extend the hunk until there are more than two contexts' worth of unchanged lines in a row
+        auto hunk_end = first_change;
+        for (size_t same_count = 0; hunk_end < script.size(); ++hunk_end)
         {
-            auto posSync = newfile.FindLineContaining(orgfile[posOrg]);
-            if (posSync != tt::npos)
+            if (script[hunk_end] == op_same)
             {
-                while (posNew < posSync)
-                {
-                    std::cout << "new: " << newfile[posNew++] << '\n';
-                }
-                continue;
+                if (++same_count > 2 * DIFF_CONTEXT)
+                    break;
             }
+            else
+            {
+                same_count = 0;
+            }
+        }
+        while (hunk_end > first_change && script[hunk_end - 1] == op_same)
+            --hunk_end;
+        hunk_end = std::min(hunk_end + DIFF_CONTEXT, script.size());
+
+        size_t count_org = 0;
+        size_t count_new = 0;
+        for (auto idx = hunk_start; idx < hunk_end; ++idx)
+        {
+            if (script[idx] != op_insert)
+                ++count_org;
+            if (script[idx] != op_delete)
+                ++count_new;
+        }
 
-            std::cout << posOrg << ": " << orgfile[posOrg] << '\n';
-            std::cout << posNew << ": " << newfile[posNew] << '\n';
+        // Unified diff line numbers are 1-based, and an empty range refers to the line before it
+        std::cout << "@@ -" << (count_org ? posOrg + 1 : posOrg) << ',' << count_org << " +"
+                  << (count_new ? posNew + 1 : posNew) << ',' << count_new << " @@" << '\n';
+
+        for (auto idx = hunk_start; idx < hunk_end; ++idx)
+        {
+            switch (script[idx])
+            {
+                case op_delete:
+                    std::cout << '-' << org_lines[posOrg++] << '\n';
+                    break;
+
+                case op_insert:
+                    std::cout << '+' << new_lines[posNew++] << '\n';
+                    break;
+
+                default:
+                    std::cout << ' ' << org_lines[posOrg++] << '\n';
+                    ++posNew;
+                    break;
+            }
         }
+        pos = hunk_end;
     }
 }
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <string_view>
+#include <vector>
+
 #include "tttextfile_wx.h"
 
 // Class to store information for a dry-run of functionality
@@ -22,8 +25,11 @@ public:
     const ttlib::cstr& GetFileName() { return m_filename; }
 
     void NewFile(std::string_view filename);
-    // Display each line that differs from the original
+
+    // Displays the changes from the original as a unified diff
     void DisplayFileDiff(const ttlib::viewfile& orgfile, const ttlib::textfile& newfile);
+    void DisplayFileDiff(const std::vector<std::string_view>& org_lines,
+                         const std::vector<std::string_view>& new_lines);
 
 private:
     // Class members
@@ -3,6 +3,7 @@ set (file_list
     ${CMAKE_CURRENT_LIST_DIR}/mainapp.cpp         # entry point, global strings, library pragmas
 
     ${CMAKE_CURRENT_LIST_DIR}/addfiles.cpp        # Used to add one or more filenames to a .srcfiles file
+    ${CMAKE_CURRENT_LIST_DIR}/assetcache.cpp      # Content-addressed cache for -hgz, -png and -xpm conversions
     ${CMAKE_CURRENT_LIST_DIR}/cmplrMsvc.cpp       # Creates .ninja scripts for MSVC and CLANG-CL compilers
     ${CMAKE_CURRENT_LIST_DIR}/createmakefile.cpp  # CreateMakeFile method for creating a makefile
     ${CMAKE_CURRENT_LIST_DIR}/csrcfiles.cpp       # CSrcFiles class for reading .srcfiles
@@ -10,23 +11,37 @@ set (file_list
     ${CMAKE_CURRENT_LIST_DIR}/finder.cpp          # Routines for finding executables such as the MSVC compiler
     ${CMAKE_CURRENT_LIST_DIR}/gencmdfiles.cpp     # Generates MSVCenv.cmd and Code.cmd files
     ${CMAKE_CURRENT_LIST_DIR}/gitfuncs.cpp        # Functions for working with .git
+    ${CMAKE_CURRENT_LIST_DIR}/gitignore.cpp       # Compiled .gitignore and .git/info/exclude matcher
+    ${CMAKE_CURRENT_LIST_DIR}/globindex.cpp       # Incremental index of the directories searched by wildcard patterns
     ${CMAKE_CURRENT_LIST_DIR}/image_hdr.cpp       # Convert image into png header
+    ${CMAKE_CURRENT_LIST_DIR}/indexer.cpp         # Creates a shareable symbol index for every source file in a project
+    ${CMAKE_CURRENT_LIST_DIR}/jsonpatch.cpp       # Edits individual values in a JSON file without changing anything else
     ${CMAKE_CURRENT_LIST_DIR}/make_hgz.cpp        # Converts a file into a .gz and stores as char array header
+    ${CMAKE_CURRENT_LIST_DIR}/mappedfile.cpp      # Private, copy-on-write memory mapping of a file
     ${CMAKE_CURRENT_LIST_DIR}/ninja.cpp           # CNinja for creating .ninja scripts
     ${CMAKE_CURRENT_LIST_DIR}/options.cpp         # contains all Options strings and CSrcOptions class for working with them
+    ${CMAKE_CURRENT_LIST_DIR}/plan.cpp            # Records every file ttBld would write without writing any of them
     ${CMAKE_CURRENT_LIST_DIR}/rcdep.cpp           # Contains functions for parsing RC dependencies
+    ${CMAKE_CURRENT_LIST_DIR}/toolcache.cpp       # Persistent cache of tool locations, versions and supported flags
+    ${CMAKE_CURRENT_LIST_DIR}/trace.cpp           # Scoped timers and counters exported as a Chrome trace
     ${CMAKE_CURRENT_LIST_DIR}/verninja.cpp        # CVerMakeNinja class
     ${CMAKE_CURRENT_LIST_DIR}/vs.cpp              # Creates .vs/tasks.vs.json and .vs/launch.vs.json
     ${CMAKE_CURRENT_LIST_DIR}/vscode.cpp          # Creates/updates .vscode files
+    ${CMAKE_CURRENT_LIST_DIR}/watcher.cpp         # Keeps .ninja scripts up to date whenever a project input changes
     ${CMAKE_CURRENT_LIST_DIR}/writesrc.cpp        # Writes a new or update srcfiles.yaml file
+    ${CMAKE_CURRENT_LIST_DIR}/xmlarena.cpp        # Bump allocator for pugixml documents
     ${CMAKE_CURRENT_LIST_DIR}/yamalize.cpp        # Used to convert .srcfiles to .vscode/srcfiles.yaml
 
     ${CMAKE_CURRENT_LIST_DIR}/convert/convert.cpp          # Various conversion methods
+    ${CMAKE_CURRENT_LIST_DIR}/convert/convert_tree.cpp     # Convert every project file in a directory tree
+    ${CMAKE_CURRENT_LIST_DIR}/convert/readsln.cpp          # Convert a Visual Studio .sln file into a CMake workspace
     ${CMAKE_CURRENT_LIST_DIR}/convert/readcodelite.cpp     # Class for converting a CodeLite .project file to .srcfiles.yaml
     ${CMAKE_CURRENT_LIST_DIR}/convert/readdsp.cpp          # Class for converting a Visual Studio .DSP file to .srcfiles.yaml
     ${CMAKE_CURRENT_LIST_DIR}/convert/readvc.cpp           # Class for converting a Visual Studio .vcproj file to .srcfiles.yaml
     ${CMAKE_CURRENT_LIST_DIR}/convert/readvcx.cpp          # Converts a Visual Studio project file into .srcfiles.yaml
     ${CMAKE_CURRENT_LIST_DIR}/convert/writevcx.cpp         # Create a Visual Studio project file
+    ${CMAKE_CURRENT_LIST_DIR}/convert/xmlstream.cpp        # Single-pass XML reader that only keeps the elements a converter needs
+    ${CMAKE_CURRENT_LIST_DIR}/convert/xmlwrite.cpp         # Streaming XML writer with the same output as a saved pugixml document
     ${CMAKE_CURRENT_LIST_DIR}/convert/write_cmake.cpp      # Create a CMakeLists.txt file
     ${CMAKE_CURRENT_LIST_DIR}/convert/wxWidgets_file.cpp   # Convert wxWidgets build/file to CMake file list
 
@@ -13,6 +13,8 @@
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 #include <ttstring_wx.h>    // ttString -- wxString with additional methods similar to ttlib::cstr
 
+#include "toolcache.h"  // CToolCache -- Persistent cache of tool locations, versions and supported flags
+
 /*
     The path to the MSVC compiler changes every time a new version is downloaded, no matter how minor a change that
     version may be. At the time this code is being written, those updates occur as often as once a week. That
@@ -104,20 +106,5 @@ bool IsHost64()
 
 bool FindFileEnv(const std::string& Env, std::string_view filename, ttlib::cstr& pathResult)
 {
-    auto pszEnv = std::getenv(Env.c_str());
-    if (pszEnv)
-    {
-        ttlib::multistr enumstr(pszEnv);
-        for (auto& str: enumstr)
-        {
-            str.append_filename(filename);
-            if (str.file_exists())
-            {
-                pathResult = str;
-                pathResult.backslashestoforward();
-                return true;
-            }
-        }
-    }
-    return false;
+    return CToolCache::Get().FindFile(Env, filename, pathResult);
 }
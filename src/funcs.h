@@ -12,6 +12,7 @@
 
 class cstr;
 class CSrcFiles;
+struct CMakeSpeedOptions;
 
 bool gitIgnoreAll(ttlib::cstr& GitExclude);
 bool gitIsFileIgnored(ttlib::cstr& gitIgnorePath, std::string_view filename);
@@ -24,6 +25,14 @@ bool ChangeOptions(std::string& ProjectFile);
 
 bool ConvertBuildScript(const char* pszBldFile);
 
+// Converts every .vcxproj, .vcproj, .dsp and CodeLite .project file in dir and all of its subdirectories. Returns 0 if
+// every project was converted. If isDryRun is true, nothing is written.
+int ConvertProjectTree(const ttlib::cstr& dir, const CMakeSpeedOptions& options, bool isDryRun);
+
+// Converts every .vcxproj in a Visual Studio solution, and creates a CMakeLists.txt next to the .sln file that builds
+// all of them. Returns 0 if every project was converted. If isDryRun is true, nothing is written.
+int ConvertSolution(const ttlib::cstr& slnFile, const CMakeSpeedOptions& options, bool isDryRun);
+
 // Search PATH, LIB, or INCLUDE (or variants)
 bool FindFileEnv(const std::string& Env, std::string_view filename, ttlib::cstr& pathResult);
 
@@ -34,8 +43,9 @@ bool CreateVsJson(const char* pszSrcFiles, std::vector<std::string>& results);
 
 // Following functions are for use in setting up a build system for VS Code
 
-// Returns true unless unable to write to a file
-std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view SrcFilename);
+// Returns true unless unable to write to a file. If recreateProps is true, c_cpp_properties.json is recreated
+// rather than updated.
+std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view SrcFilename, bool recreateProps = false);
 bool Yamalize();
 
 #if defined(_WIN32)
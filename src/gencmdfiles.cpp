@@ -11,9 +11,22 @@
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
 #include "funcs.h"  // List of function declarations
+#include "plan.h"   // CPlan -- Records every file ttBld would write without writing any of them
 
 #if defined(_WIN32)  // no reason to use the batch files on non-Windows platforms
 
+// A dry run can't try writing the file to find out whether the caller needs to fall back to another location, so it
+// assumes the write only fails if the directory doesn't exist.
+static bool WriteCodeCmd(const ttlib::cstr& path, const ttlib::textfile& file)
+{
+    if (!CPlan::Get().IsEnabled())
+        return file.WriteFile(path);
+
+    ttlib::cstr dir(path);
+    dir.remove_filename();
+    return dir.dir_exists() && CPlan::Get().Add(path, file, "VS Code launcher");
+}
+
 void CreateCodeCmd(const char* pszFile)
 {
     ASSERT_MSG(pszFile, "NULL pointer!");
@@ -55,9 +68,10 @@ void CreateCodeCmd(const char* pszFile)
     Path.append_filename(pszFile);
     Path.backslashestoforward();
 
-    if (file.WriteFile(Path))
+    if (WriteCodeCmd(Path, file))
     {
-        std::cout << Path << " created" << '\n';
+        if (!CPlan::Get().IsEnabled())
+            std::cout << Path << " created" << '\n';
     }
     else
     {
@@ -69,9 +83,10 @@ void CreateCodeCmd(const char* pszFile)
         if (FindFileEnv("PATH", "code.cmd", NewPath))
         {
             NewPath.replace_filename(pszFile);
-            if (file.WriteFile(NewPath))
+            if (WriteCodeCmd(NewPath, file))
             {
-                std::cout << NewPath << " created" << '\n';
+                if (!CPlan::Get().IsEnabled())
+                    std::cout << NewPath << " created" << '\n';
                 return;
             }
         }
@@ -233,6 +248,9 @@ bool CreateMSVCEnvCmd(const char* pszDstFile, bool bDef64)
     }
     file.emplace_back("set INCLUDE=" + Path);
 
+    if (CPlan::Get().Add(pszDstFile, file, "MSVC environment script"))
+        return true;
+
     // Don't write the file unless something has actually changed
 
     ttlib::viewfile fileOrg;
@@ -7,6 +7,18 @@
 
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
+#include "gitignore.h"  // CGitIgnore -- Compiled .gitignore and .git/info/exclude matcher
+#include "plan.h"       // CPlan -- Records every file ttBld would write without writing any of them
+
+// The compiled patterns are only discarded if the file is actually changed
+static bool WriteIgnoreFile(const ttlib::cstr& path, const ttlib::textfile& file)
+{
+    if (CPlan::Get().Add(path, file, "git ignore list"))
+        return true;
+    CGitIgnore::ClearCache();
+    return file.WriteFile(path);
+}
+
 // If .gitignore is found, gitIgnorePath will be updated to point to it
 bool gitIsFileIgnored(ttlib::cstr& gitIgnorePath, std::string_view filename)
 {
@@ -26,12 +38,7 @@ bool gitIsFileIgnored(ttlib::cstr& gitIgnorePath, std::string_view filename)
         }
     }
 
-    ttlib::viewfile file;
-    if (file.ReadFile(gitIgnorePath))
-    {
-        return (file.FindLineContaining(filename) != tt::npos);
-    }
-    return false;
+    return CGitIgnore::Get()->IsIgnored(filename, false, CGitIgnore::src_gitignore);
 }
 
 // If .git/info/exclude is found, GitExclude will be updated to point to it
@@ -54,12 +61,7 @@ bool gitIsExcluded(ttlib::cstr& GitExclude, std::string_view filename)
         return false;
     }
 
-    ttlib::viewfile file;
-    if (file.ReadFile(GitExclude))
-    {
-        return (file.FindLineContaining(filename) != tt::npos);
-    }
-    return false;
+    return CGitIgnore::Get()->IsIgnored(filename, false, CGitIgnore::src_exclude);
 }
 
 // This will work with either .gitignore or exclude
@@ -74,11 +76,11 @@ bool gitAddtoIgnore(ttlib::cstr& GitIgnore, std::string_view filename)
         if (file[line][0] == '#')
             continue;
         file.insertLine(line, filename);
-        return file.WriteFile(GitIgnore);
+        return WriteIgnoreFile(GitIgnore, file);
     }
 
     file.emplace_back(filename);
-    return file.WriteFile(GitIgnore);
+    return WriteIgnoreFile(GitIgnore, file);
 }
 
 // clang-format off
@@ -129,5 +131,5 @@ bool gitIgnoreAll(ttlib::cstr& GitExclude)
             file.emplace_back(name);
     }
 
-    return file.WriteFile(GitExclude);
+    return WriteIgnoreFile(GitExclude, file);
 }
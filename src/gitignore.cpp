@@ -0,0 +1,500 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Compiled .gitignore and .git/info/exclude matcher
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <filesystem>
+
+#include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
+
+#include "gitignore.h"  // CGitIgnore
+
+#include "assetcache.h"  // NormalizePath
+
+namespace fs = std::filesystem;
+
+static std::mutex s_cache_mutex;
+static std::map<std::string, std::shared_ptr<CGitIgnore>> s_cache;
+
+// git defaults to core.ignorecase=true on Windows
+static void FoldCase([[maybe_unused]] std::string& str)
+{
+#if defined(_WIN32)
+    for (auto& ch: str)
+    {
+        if (ch >= 'A' && ch <= 'Z')
+            ch = static_cast<char>(ch - 'A' + 'a');
+    }
+#endif  // _WIN32
+}
+
+std::shared_ptr<CGitIgnore> CGitIgnore::Get(std::string_view dir)
+{
+    auto start = NormalizePath(dir.empty() ? fs::current_path() : fs::u8path(dir));
+
+    // The repository root is the first directory containing .git (which is a file rather than a directory in a
+    // worktree or submodule).
+    ttlib::cstr root(start);
+    std::error_code ec;
+    for (auto path = fs::u8path(start);; path = path.parent_path())
+    {
+        if (fs::exists(path / ".git", ec))
+        {
+            root = NormalizePath(path);
+            break;
+        }
+        if (!path.has_relative_path() || path == path.parent_path())
+            break;
+    }
+
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    auto& matcher = s_cache[root];
+    if (!matcher)
+        matcher.reset(new CGitIgnore(root));
+    return matcher;
+}
+
+void CGitIgnore::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    s_cache.clear();
+}
+
+CGitIgnore::CGitIgnore(const ttlib::cstr& root) : m_root(root)
+{
+    ttlib::cstr exclude(m_root);
+    exclude << "/.git/info/exclude";
+    if (exclude.file_exists())
+        m_exclude.ReadFile(exclude);
+}
+
+const CGitIgnore::RuleSet* CGitIgnore::GetDirRules(const std::string& dir)
+{
+    auto found = m_dir_rules.find(dir);
+    if (found == m_dir_rules.end())
+    {
+        ttlib::cstr filename(m_root);
+        if (dir.size())
+            filename << '/' << dir;
+        filename << "/.gitignore";
+
+        std::unique_ptr<RuleSet> rules;
+        if (filename.file_exists())
+        {
+            rules = std::make_unique<RuleSet>();
+            rules->ReadFile(filename);
+            if (rules->empty())
+                rules.reset();
+        }
+        found = m_dir_rules.emplace(dir, std::move(rules)).first;
+    }
+    return found->second.get();
+}
+
+int CGitIgnore::MatchPath(const std::vector<std::string_view>& components, size_t count, bool isDir,
+                          unsigned int sources)
+{
+    if (sources & src_gitignore)
+    {
+        // The .gitignore closest to the path takes precedence
+        for (size_t depth = count; depth-- > 0;)
+        {
+            std::string dir;
+            for (size_t idx = 0; idx < depth; ++idx)
+            {
+                if (idx)
+                    dir += '/';
+                dir += components[idx];
+            }
+
+            if (auto rules = GetDirRules(dir); rules)
+            {
+                std::vector<std::string_view> relative(components.begin() + depth, components.begin() + count);
+                if (auto result = rules->Match(relative, isDir); result >= 0)
+                    return result;
+            }
+        }
+    }
+
+    if (sources & src_exclude)
+    {
+        std::vector<std::string_view> relative(components.begin(), components.begin() + count);
+        return m_exclude.Match(relative, isDir);
+    }
+
+    return -1;
+}
+
+bool CGitIgnore::IsIgnored(std::string_view path, bool isDir, unsigned int sources)
+{
+    if (path.empty())
+        return false;
+    if (path.back() == '/' || path.back() == '\\')
+        isDir = true;
+
+    auto full_path = NormalizePath(fs::u8path(path));
+    if (full_path.size() <= m_root.size() || full_path.compare(0, m_root.size(), m_root) != 0 ||
+        (full_path[m_root.size()] != '/' && m_root.back() != '/'))
+    {
+        return false;
+    }
+
+    std::string relative = full_path.substr(m_root.size() + (m_root.back() == '/' ? 0 : 1));
+    FoldCase(relative);
+
+    std::vector<std::string_view> components;
+    for (size_t begin = 0; begin < relative.size();)
+    {
+        auto end = relative.find('/', begin);
+        if (end == std::string::npos)
+            end = relative.size();
+        if (end > begin)
+            components.emplace_back(std::string_view(relative).substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A file cannot be re-included if any of its parent directories is ignored, so each parent is checked first.
+    for (size_t count = 1; count <= components.size(); ++count)
+    {
+        if (MatchPath(components, count, count < components.size() || isDir, sources) == 1)
+            return true;
+    }
+    return false;
+}
+
+/////////////////////////////////// RuleSet ///////////////////////////////////
+
+void CGitIgnore::RuleSet::ReadFile(const ttlib::cstr& filename)
+{
+    ttlib::viewfile file;
+    if (!file.ReadFile(filename))
+        return;
+
+    for (auto& line: file)
+        AddPattern(line);
+}
+
+void CGitIgnore::RuleSet::AddPattern(std::string_view line)
+{
+    while (line.size() && (line.back() == '\r' || line.back() == '\n'))
+        line.remove_suffix(1);
+
+    // Trailing spaces are ignored unless they are escaped
+    while (line.size() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\'))
+        line.remove_suffix(1);
+
+    if (line.empty() || line[0] == '#')
+        return;
+
+    Rule rule;
+    if (line[0] == '!')
+    {
+        rule.isNegated = true;
+        line.remove_prefix(1);
+    }
+
+    if (line.size() && line.back() == '/')
+    {
+        rule.isDirOnly = true;
+        line.remove_suffix(1);
+    }
+
+    // Any separator other than a trailing one anchors the pattern to the directory containing the ignore file
+    bool hasWildcard = false;
+    for (size_t pos = 0; pos < line.size(); ++pos)
+    {
+        if (line[pos] == '\\')
+            ++pos;
+        else if (line[pos] == '/')
+            rule.isAnchored = true;
+        else if (line[pos] == '*' || line[pos] == '?' || line[pos] == '[')
+            hasWildcard = true;
+    }
+    if (line.size() && line[0] == '/')
+        line.remove_prefix(1);
+    if (line.empty())
+        return;
+
+    std::string pattern(line);
+    FoldCase(pattern);
+
+    auto index = m_rules.size();
+
+    if (!hasWildcard)
+    {
+        std::string literal;
+        for (size_t pos = 0; pos < pattern.size(); ++pos)
+        {
+            if (pattern[pos] == '\\' && pos + 1 < pattern.size())
+                ++pos;
+            literal += pattern[pos];
+        }
+
+        if (rule.isAnchored)
+        {
+            auto node = &m_anchored;
+            for (size_t begin = 0; begin < literal.size();)
+            {
+                auto end = literal.find('/', begin);
+                if (end == std::string::npos)
+                    end = literal.size();
+                if (end > begin)
+                    node = &node->children[literal.substr(begin, end - begin)];
+                begin = end + 1;
+            }
+            node->rules.push_back(index);
+        }
+        else
+        {
+            m_names[literal].push_back(index);
+        }
+        m_rules.emplace_back(std::move(rule));
+        return;
+    }
+
+    // Compile the glob
+
+    for (size_t pos = 0; pos < pattern.size(); ++pos)
+    {
+        auto ch = pattern[pos];
+        if (ch == '\\' && pos + 1 < pattern.size())
+        {
+            rule.tokens.push_back({ tok_char, pattern[++pos], false, {} });
+        }
+        else if (ch == '?')
+        {
+            rule.tokens.push_back({ tok_any, 0, false, {} });
+        }
+        else if (ch == '*')
+        {
+            // "**" only has special meaning as an entire path component -- anywhere else it's the same as "*"
+            if (pos + 1 < pattern.size() && pattern[pos + 1] == '*' && (pos == 0 || pattern[pos - 1] == '/') &&
+                (pos + 2 == pattern.size() || pattern[pos + 2] == '/'))
+            {
+                rule.tokens.push_back({ tok_globstar, 0, false, {} });
+                ++pos;
+            }
+            else
+            {
+                while (pos + 1 < pattern.size() && pattern[pos + 1] == '*')
+                    ++pos;
+                rule.tokens.push_back({ tok_star, 0, false, {} });
+            }
+        }
+        else if (ch == '[')
+        {
+            Token token { tok_class, 0, false, {} };
+            auto end = pos + 1;
+            if (end < pattern.size() && (pattern[end] == '!' || pattern[end] == '^'))
+            {
+                token.negated = true;
+                ++end;
+            }
+
+            // A ']' immediately after the opening bracket is part of the set
+            bool isFirst = true;
+            for (; end < pattern.size() && (isFirst || pattern[end] != ']'); ++end, isFirst = false)
+            {
+                auto low = pattern[end];
+                if (low == '\\' && end + 1 < pattern.size())
+                    low = pattern[++end];
+                auto high = low;
+                if (end + 2 < pattern.size() && pattern[end + 1] == '-' && pattern[end + 2] != ']')
+                {
+                    end += 2;
+                    high = pattern[end];
+                    if (high == '\\' && end + 1 < pattern.size())
+                        high = pattern[++end];
+                }
+                token.set += low;
+                token.set += high;
+            }
+
+            if (end >= pattern.size())
+            {
+                // No closing bracket, so the '[' is just a character
+                rule.tokens.push_back({ tok_char, '[', false, {} });
+            }
+            else
+            {
+                rule.tokens.push_back(std::move(token));
+                pos = end;
+            }
+        }
+        else
+        {
+            rule.tokens.push_back({ tok_char, ch, false, {} });
+        }
+    }
+
+    m_globs.push_back(index);
+    m_rules.emplace_back(std::move(rule));
+}
+
+// The tokens are treated as the states of a non-deterministic automaton, and every possible state is advanced one
+// character at a time. That makes the cost proportional to the pattern length times the string length, no matter how
+// many '*' characters there are.
+bool CGitIgnore::RuleSet::MatchTokens(const std::vector<Token>& tokens, std::string_view str)
+{
+    auto count = tokens.size();
+    std::vector<char> states(count + 1, 0);
+    std::vector<char> next(count + 1, 0);
+
+    // Adds every state that can be reached without consuming a character
+    auto closure = [&](std::vector<char>& set)
+    {
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            if (!set[idx])
+                continue;
+            if (tokens[idx].type == tok_star || tokens[idx].type == tok_globstar)
+                set[idx + 1] = 1;
+
+            // "**/" also matches nothing at all, so "a/**/b" matches "a/b"
+            if (tokens[idx].type == tok_globstar && idx + 1 < count && tokens[idx + 1].type == tok_char &&
+                tokens[idx + 1].ch == '/')
+            {
+                set[idx + 2] = 1;
+            }
+        }
+    };
+
+    states[0] = 1;
+    closure(states);
+
+    for (auto ch: str)
+    {
+        std::fill(next.begin(), next.end(), 0);
+        bool isAlive = false;
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            if (!states[idx])
+                continue;
+
+            auto& token = tokens[idx];
+            switch (token.type)
+            {
+                case tok_char:
+                    if (token.ch == ch)
+                        next[idx + 1] = isAlive = true;
+                    break;
+
+                case tok_any:
+                    if (ch != '/')
+                        next[idx + 1] = isAlive = true;
+                    break;
+
+                case tok_star:
+                    if (ch != '/')
+                        next[idx] = isAlive = true;
+                    break;
+
+                case tok_globstar:
+                    next[idx] = isAlive = true;
+                    break;
+
+                case tok_class:
+                    if (ch != '/')
+                    {
+                        bool isInSet = false;
+                        for (size_t pos = 0; pos + 1 < token.set.size(); pos += 2)
+                        {
+                            if (ch >= token.set[pos] && ch <= token.set[pos + 1])
+                            {
+                                isInSet = true;
+                                break;
+                            }
+                        }
+                        if (isInSet != token.negated)
+                            next[idx + 1] = isAlive = true;
+                    }
+                    break;
+            }
+        }
+        if (!isAlive)
+            return false;
+        closure(next);
+        std::swap(states, next);
+    }
+
+    return states[count] != 0;
+}
+
+int CGitIgnore::RuleSet::Match(const std::vector<std::string_view>& components, bool isDir) const
+{
+    if (components.empty() || m_rules.empty())
+        return -1;
+
+    size_t best = tt::npos;
+    auto consider = [&](size_t index)
+    {
+        if ((best == tt::npos || index > best) && (!m_rules[index].isDirOnly || isDir))
+            best = index;
+    };
+
+    const TrieNode* node = &m_anchored;
+    for (auto& iter: components)
+    {
+        auto child = node->children.find(iter);
+        if (child == node->children.end())
+        {
+            node = nullptr;
+            break;
+        }
+        node = &child->second;
+    }
+    if (node)
+    {
+        for (auto index: node->rules)
+            consider(index);
+    }
+
+    if (auto found = m_names.find(std::string(components.back())); found != m_names.end())
+    {
+        for (auto index: found->second)
+            consider(index);
+    }
+
+    // The last matching rule wins, so the globs are checked in reverse order and only until they are older than the
+    // best literal match.
+    std::string path;
+    for (auto iter = m_globs.rbegin(); iter != m_globs.rend(); ++iter)
+    {
+        if (best != tt::npos && *iter < best)
+            break;
+
+        auto& rule = m_rules[*iter];
+        if (rule.isDirOnly && !isDir)
+            continue;
+
+        std::string_view subject = components.back();
+        if (rule.isAnchored)
+        {
+            if (path.empty())
+            {
+                for (auto& component: components)
+                {
+                    if (path.size())
+                        path += '/';
+                    path += component;
+                }
+            }
+            subject = path;
+        }
+
+        if (MatchTokens(rule.tokens, subject))
+        {
+            best = *iter;
+            break;
+        }
+    }
+
+    if (best == tt::npos)
+        return -1;
+    return m_rules[best].isNegated ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Compiled .gitignore and .git/info/exclude matcher
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+// Each ignore file is parsed once into a rule set. Patterns without wildcards are looked up directly -- anchored
+// patterns ("/bld", "src/gen/") in a trie keyed by path component, and unanchored ones ("Thumbs.db") in a table keyed
+// by filename. Only the patterns that actually contain wildcards are matched one at a time, and those are compiled
+// into a token sequence that is matched without backtracking.
+//
+// The rules follow git: the last matching pattern wins, "!pattern" re-includes, "pattern/" only matches directories,
+// a .gitignore in a subdirectory takes precedence over its parent's, .git/info/exclude has the lowest precedence, and
+// nothing can be re-included if one of its parent directories is ignored.
+class CGitIgnore
+{
+public:
+    enum SOURCE : unsigned int
+    {
+        src_gitignore = 1 << 0,  // .gitignore files
+        src_exclude = 1 << 1,    // .git/info/exclude
+        src_all = src_gitignore | src_exclude,
+    };
+
+    // Returns the matcher for the repository that contains dir (or for dir itself if it isn't in a repository). Each
+    // repository is only parsed once.
+    static std::shared_ptr<CGitIgnore> Get(std::string_view dir = std::string_view {});
+
+    // Call this after changing .gitignore or .git/info/exclude so that the next Get() reads them again.
+    static void ClearCache();
+
+    // path can be absolute or relative to the current directory. A trailing '/' means path is a directory, as does
+    // isDir. Paths outside of the repository are never ignored.
+    bool IsIgnored(std::string_view path, bool isDir = false, unsigned int sources = src_all);
+
+    const ttlib::cstr& GetRoot() const { return m_root; }
+
+protected:
+    CGitIgnore(const ttlib::cstr& root);
+
+    enum TOKEN_TYPE : unsigned char
+    {
+        tok_char,      // a single literal character
+        tok_any,       // ?
+        tok_star,      // * -- anything except '/'
+        tok_globstar,  // ** -- anything, including '/'
+        tok_class,     // [...]
+    };
+
+    struct Token
+    {
+        TOKEN_TYPE type;
+        char ch;          // tok_char
+        bool negated;     // tok_class
+        std::string set;  // tok_class -- pairs of characters specifying inclusive ranges
+    };
+
+    struct Rule
+    {
+        std::vector<Token> tokens;
+        bool isNegated { false };
+        bool isDirOnly { false };
+        bool isAnchored { false };  // matched against the entire path rather than just the filename
+    };
+
+    struct TrieNode
+    {
+        std::map<std::string, TrieNode, std::less<>> children;
+        std::vector<size_t> rules;
+    };
+
+    // All the rules from a single file, matched against paths relative to the directory containing the file.
+    class RuleSet
+    {
+    public:
+        void AddPattern(std::string_view line);
+        void ReadFile(const ttlib::cstr& filename);
+
+        bool empty() const { return m_rules.empty(); }
+
+        // Returns -1 if no rule matches, 1 if the path is ignored and 0 if it is explicitly re-included.
+        int Match(const std::vector<std::string_view>& components, bool isDir) const;
+
+    protected:
+        static bool MatchTokens(const std::vector<Token>& tokens, std::string_view str);
+
+    private:
+        std::vector<Rule> m_rules;
+
+        TrieNode m_anchored;                                           // literal anchored patterns
+        std::unordered_map<std::string, std::vector<size_t>> m_names;  // literal unanchored patterns
+        std::vector<size_t> m_globs;                                   // everything else
+    };
+
+    // Returns nullptr if there is no .gitignore in dir (which is relative to the repository root)
+    const RuleSet* GetDirRules(const std::string& dir);
+
+    int MatchPath(const std::vector<std::string_view>& components, size_t count, bool isDir, unsigned int sources);
+
+private:
+    ttlib::cstr m_root;  // absolute path with forward slashes and no trailing slash
+
+    RuleSet m_exclude;
+    std::map<std::string, std::unique_ptr<RuleSet>> m_dir_rules;
+
+    std::mutex m_mutex;
+};
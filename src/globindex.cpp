@@ -0,0 +1,353 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Incremental index of the directories searched by wildcard patterns
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+
+#if !defined(_WIN32)
+    #include <sys/stat.h>
+#endif  // _WIN32
+
+#include "globindex.h"
+
+#include "assetcache.h"  // NormalizePath, ReadFileBytes, WriteIfChanged
+#include "trace.h"       // CTrace -- Scoped timers and counters exported as a Chrome trace
+
+namespace fs = std::filesystem;
+
+// Changing the file layout in an incompatible way MUST change this number
+static constexpr int INDEX_FORMAT = 1;
+
+// FAT has a 2 second resolution, most other file systems are considerably better
+static constexpr int RACY_SECONDS = 2;
+
+static std::mutex s_cache_mutex;
+static std::map<std::string, std::shared_ptr<CGlobIndex>> s_cache;
+
+// The inode changes if the directory is deleted and re-created, which doesn't necessarily change the modification time
+static uint64_t GetInode([[maybe_unused]] const std::string& path)
+{
+#if defined(_WIN32)
+    return 0;  // std::filesystem doesn't provide the file index, and the modification time is sufficient on NTFS
+#else
+    CTrace::Count(TRACE_COUNTER::files_stat);
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return 0;
+    return static_cast<uint64_t>(info.st_ino);
+#endif  // _WIN32
+}
+
+static bool IsSameChar(char pat, char name)
+{
+#if defined(_WIN32)
+    // File names are not case-sensitive on Windows
+    if (pat >= 'A' && pat <= 'Z')
+        pat = static_cast<char>(pat - 'A' + 'a');
+    if (name >= 'A' && name <= 'Z')
+        name = static_cast<char>(name - 'A' + 'a');
+#endif  // _WIN32
+    return pat == name;
+}
+
+static std::vector<std::string_view> SplitFields(std::string_view line)
+{
+    std::vector<std::string_view> fields;
+    for (;;)
+    {
+        auto pos = line.find('\t');
+        fields.emplace_back(line.substr(0, pos));
+        if (pos == std::string_view::npos)
+            break;
+        line.remove_prefix(pos + 1);
+    }
+    return fields;
+}
+
+static int64_t ToInt(std::string_view str)
+{
+    return static_cast<int64_t>(std::strtoll(std::string(str).c_str(), nullptr, 10));
+}
+
+std::shared_ptr<CGlobIndex> CGlobIndex::Get(const ttlib::cstr& bld_dir)
+{
+    auto index_file = NormalizePath(fs::u8path(bld_dir.empty() ? "." : bld_dir.c_str()) / "glob.index");
+
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    auto& index = s_cache[index_file];
+    if (!index)
+        index.reset(new CGlobIndex(index_file));
+    return index;
+}
+
+void CGlobIndex::SaveAll()
+{
+    std::lock_guard<std::mutex> lock(s_cache_mutex);
+    for (auto& iter: s_cache)
+        iter.second->Save();
+}
+
+CGlobIndex::CGlobIndex(const ttlib::cstr& index_file) : m_index_file(index_file)
+{
+    ReadIndex();
+}
+
+void CGlobIndex::ReadIndex()
+{
+    std::string contents;
+    if (!ReadFileBytes(m_index_file, contents))
+        return;
+
+    std::string_view remaining(contents);
+    Directory* dir = nullptr;
+    bool isFirstLine = true;
+    while (remaining.size())
+    {
+        auto pos = remaining.find('\n');
+        auto line = remaining.substr(0, pos);
+        remaining.remove_prefix(pos == std::string_view::npos ? remaining.size() : pos + 1);
+
+        if (isFirstLine)
+        {
+            // An index written by a different version of ttBld is ignored, and will be replaced
+            if (line != "# ttBld glob index " + std::to_string(INDEX_FORMAT))
+                return;
+            isFirstLine = false;
+            continue;
+        }
+
+        auto fields = SplitFields(line);
+        if (fields[0] == "dir" && fields.size() == 5)
+        {
+            dir = &m_dirs[std::string(fields[1])];
+            dir->mtime = ToInt(fields[2]);
+            dir->inode = static_cast<uint64_t>(ToInt(fields[3]));
+            dir->isRacy = (fields[4] != "0");
+        }
+        else if (dir && fields[0] == "file" && fields.size() == 2)
+        {
+            dir->names.emplace_back(fields[1]);
+        }
+        else if (dir && fields[0] == "match" && fields.size() >= 2)
+        {
+            auto& matches = dir->matches[std::string(fields[1])];
+            for (size_t idx = 2; idx < fields.size(); ++idx)
+                matches.emplace_back(fields[idx]);
+        }
+    }
+
+    // Names and matches are always written sorted, but the file could have been edited
+    for (auto& iter: m_dirs)
+    {
+        std::sort(iter.second.names.begin(), iter.second.names.end());
+        for (auto& match: iter.second.matches)
+            std::sort(match.second.begin(), match.second.end());
+    }
+}
+
+bool CGlobIndex::Save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_isModified)
+        return true;
+
+    // Don't create the build directory just to store the index -- it will be written once something else has created
+    // it.
+    ttlib::cstr bld_dir(m_index_file);
+    bld_dir.remove_filename();
+    if (!bld_dir.dir_exists())
+        return true;
+
+    std::string contents("# ttBld glob index " + std::to_string(INDEX_FORMAT) + "\n");
+    for (auto& iter: m_dirs)
+    {
+        auto& dir = iter.second;
+        contents += "dir\t" + iter.first + '\t' + std::to_string(dir.mtime) + '\t' + std::to_string(dir.inode) + '\t' +
+                    (dir.isRacy ? "1" : "0") + '\n';
+        for (auto& name: dir.names)
+            contents += "file\t" + name + '\n';
+        for (auto& match: dir.matches)
+        {
+            contents += "match\t" + match.first;
+            for (auto& name: match.second)
+                contents += '\t' + name;
+            contents += '\n';
+        }
+    }
+
+    if (!WriteIfChanged(m_index_file, contents.data(), contents.size()))
+        return false;
+    m_isModified = false;
+    return true;
+}
+
+std::vector<ttlib::cstr> CGlobIndex::Match(std::string_view pattern)
+{
+    std::vector<ttlib::cstr> results;
+
+    auto pos = pattern.find_last_of("/\\");
+    auto filespec = (pos == std::string_view::npos) ? pattern : pattern.substr(pos + 1);
+    std::string_view dir_part = (pos == std::string_view::npos) ? std::string_view() : pattern.substr(0, pos);
+    if (pos == 0)
+        dir_part = pattern.substr(0, 1);  // root directory
+    if (filespec.empty())
+        return results;
+
+    // This matches the way wxFindFirstFile() returns the files it finds
+    ttlib::cstr prefix(dir_part.empty() ? std::string_view(".") : dir_part);
+    if (prefix.back() != '/' && prefix.back() != '\\')
+    {
+#if defined(_WIN32)
+        prefix += '\\';
+#else
+        prefix += '/';
+#endif  // _WIN32
+    }
+
+    auto path = NormalizePath(dir_part.empty() ? fs::path(".") : fs::u8path(dir_part.begin(), dir_part.end()));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& dir = m_dirs[path];
+    if (!Revalidate(path, dir))
+        return results;
+
+    auto found = dir.matches.find(filespec);
+    if (found == dir.matches.end())
+    {
+        std::vector<std::string> matches;
+        for (auto& name: dir.names)
+        {
+            if (IsMatch(filespec, name))
+                matches.emplace_back(name);
+        }
+        found = dir.matches.emplace(std::string(filespec), std::move(matches)).first;
+        m_isModified = true;
+    }
+
+    results.reserve(found->second.size());
+    for (auto& name: found->second)
+        results.emplace_back(prefix + name);
+    return results;
+}
+
+bool CGlobIndex::Revalidate(const std::string& path, Directory& dir)
+{
+    std::error_code ec;
+    auto fs_path = fs::u8path(path);
+    CTrace::Count(TRACE_COUNTER::files_stat);
+    auto last_write = fs::last_write_time(fs_path, ec);
+    if (ec)
+    {
+        if (dir.names.size())
+        {
+            dir.names.clear();
+            for (auto& iter: dir.matches)
+                iter.second.clear();
+            m_isModified = true;
+        }
+        dir.isRacy = true;
+        return false;
+    }
+
+    auto mtime = static_cast<int64_t>(last_write.time_since_epoch().count());
+    auto inode = GetInode(path);
+    if (!dir.isRacy && dir.mtime == mtime && dir.inode == inode)
+        return true;
+
+    TRACE_SCOPE("CGlobIndex::Revalidate");
+
+    std::vector<std::string> names;
+    for (fs::directory_iterator iter(fs_path, ec), end; !ec && iter != end; iter.increment(ec))
+    {
+        CTrace::Count(TRACE_COUNTER::files_stat);
+        std::error_code ec_type;
+        if (!iter->is_regular_file(ec_type))
+            continue;
+        auto name = iter->path().filename().u8string();
+
+        // wxFindFirstFile() doesn't return hidden files either
+        if (name.empty() || name[0] == '.')
+            continue;
+        names.emplace_back(std::move(name));
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<std::string> added;
+    std::vector<std::string> removed;
+    std::set_difference(names.begin(), names.end(), dir.names.begin(), dir.names.end(), std::back_inserter(added));
+    std::set_difference(dir.names.begin(), dir.names.end(), names.begin(), names.end(), std::back_inserter(removed));
+
+    if (added.size() || removed.size())
+    {
+        for (auto& iter: dir.matches)
+        {
+            std::vector<std::string> matches;
+            std::set_difference(iter.second.begin(), iter.second.end(), removed.begin(), removed.end(),
+                                std::back_inserter(matches));
+            for (auto& name: added)
+            {
+                if (IsMatch(iter.first, name))
+                    matches.emplace_back(name);
+            }
+            std::sort(matches.begin(), matches.end());
+            iter.second = std::move(matches);
+        }
+        dir.names = std::move(names);
+    }
+
+    // If the directory changed within RACY_SECONDS of now, another change could occur without changing its
+    // modification time, so it has to be enumerated again the next time it is used.
+    auto racy_ticks = std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::seconds(RACY_SECONDS));
+    auto now = fs::file_time_type::clock::now().time_since_epoch().count();
+
+    dir.mtime = mtime;
+    dir.inode = inode;
+    dir.isRacy = (now - mtime < racy_ticks.count());
+    m_isModified = true;
+    return true;
+}
+
+bool CGlobIndex::IsMatch(std::string_view pattern, std::string_view filename)
+{
+    size_t pat = 0;
+    size_t name = 0;
+
+    // Position of the last '*' seen, and the position in filename it is currently matched up to
+    size_t star = std::string_view::npos;
+    size_t star_name = 0;
+
+    while (name < filename.size())
+    {
+        if (pat < pattern.size() && pattern[pat] == '*')
+        {
+            star = pat++;
+            star_name = name;
+        }
+        else if (pat < pattern.size() && (pattern[pat] == '?' || IsSameChar(pattern[pat], filename[name])))
+        {
+            ++pat;
+            ++name;
+        }
+        else if (star != std::string_view::npos)
+        {
+            // Let the last '*' consume one more character and try again
+            pat = star + 1;
+            name = ++star_name;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (pat < pattern.size() && pattern[pat] == '*')
+        ++pat;
+    return pat == pattern.size();
+}
@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Incremental index of the directories searched by wildcard patterns
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+// Wildcard patterns in Files: and GZIP: would otherwise enumerate every directory they search each time the scripts
+// are generated. The index (<bld dir>/glob.index) stores the file names in each directory that was searched along with
+// the directory's modification time and inode. On the next run a directory is only enumerated again if one of those
+// changed, and the files that were added or removed are applied to the matches already cached for each pattern.
+//
+// A directory modified within RACY_SECONDS of being enumerated is always enumerated again, since a second change could
+// leave its modification time unchanged on file systems with a coarse timestamp.
+class CGlobIndex
+{
+public:
+    // Returns the index stored in bld_dir, reading it the first time it is requested
+    static std::shared_ptr<CGlobIndex> Get(const ttlib::cstr& bld_dir);
+
+    // Writes every index that changed. An index is only written if its build directory already exists.
+    static void SaveAll();
+
+    // Returns every file (not directory) matching pattern, sorted. Only the filename portion may contain '*' or '?'.
+    // Each result is prefixed with the pattern's directory (or "." if it doesn't have one) the same way that
+    // wxFindFirstFile() prefixes the files it finds.
+    std::vector<ttlib::cstr> Match(std::string_view pattern);
+
+    bool Save();
+
+    // Returns true if filename matches a pattern containing '*' and/or '?' (case-insensitive on Windows)
+    static bool IsMatch(std::string_view pattern, std::string_view filename);
+
+protected:
+    CGlobIndex(const ttlib::cstr& index_file);
+
+    void ReadIndex();
+
+    struct Directory
+    {
+        int64_t mtime { 0 };
+        uint64_t inode { 0 };
+        bool isRacy { true };
+
+        std::vector<std::string> names;                                // sorted
+        std::map<std::string, std::vector<std::string>, std::less<>> matches;  // filespec -> sorted matching names
+    };
+
+    // Enumerates the directory again if it changed, and updates the cached matches. Returns false if the directory
+    // doesn't exist.
+    bool Revalidate(const std::string& path, Directory& dir);
+
+private:
+    ttlib::cstr m_index_file;
+    std::map<std::string, Directory, std::less<>> m_dirs;  // key is the absolute path with forward slashes
+
+    std::mutex m_mutex;
+    bool m_isModified { false };
+};
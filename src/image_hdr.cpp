@@ -5,7 +5,11 @@
 // License:   Apache License see ../LICENSE
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 
 #include <wx/image.h>     // wxImage class
 #include <wx/mstream.h>   // Memory stream classes
@@ -14,6 +18,9 @@
 #include <ttstring_wx.h>    // ttString -- wxString with additional methods similar to ttlib::cstr
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
+#include "assetcache.h"  // CAssetCache
+#include "threadpool.h"  // CThreadPool -- Simple fixed-size thread pool for running independent tasks
+
 // clang-format off
 static constexpr const char* lst_no_png_conversion[] = {
 
@@ -47,56 +54,240 @@ R"===(#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 20170
 
 // clang-format on
 
-int ConvertImageToHeader(std::vector<ttlib::cstr>& files)
+// wxInitAllImageHandlers() is expensive enough that it is only called if there is an image that actually needs to be
+// converted (i.e., it wasn't found in the cache), and it is only called once no matter how many images are converted.
+static void InitImageHandlers()
 {
-    if (files.size() < 2)
+    static std::once_flag handlers_initialized;
+    std::call_once(handlers_initialized, []() { wxInitAllImageHandlers(); });
+}
+
+// Returns the handler that can read the image, or nullptr if no handler recognizes it. The handler matching the
+// filename's extension is checked first since that's almost always the correct one -- only if it can't read the file
+// do we probe every handler.
+static wxImageHandler* FindImageHandler(const ttlib::cstr& filename, wxInputStream& stream)
+{
+    ttlib::cstr ext = filename.extension();
+    if (ext.size() > 1)
     {
-        std::cerr << "both src and dest files must be specified" << '\n';
-        return 1;
+        ext.erase(0, 1);
+        auto handler = wxImage::FindHandler(ext.wx_str(), wxBITMAP_TYPE_ANY);
+        if (handler && handler->CanRead(stream))
+            return handler;
     }
 
-    // Add all image handlers so that the EmbedImage class can be used to convert any type of image that wxWidgets
-    // supports.
-    wxInitAllImageHandlers();
+    auto& list = wxImage::GetHandlers();
+    for (auto node = list.GetFirst(); node; node = node->GetNext())
+    {
+        auto handler = static_cast<wxImageHandler*>(node->GetData());
+        if (handler->CanRead(stream))
+            return handler;
+    }
+    return nullptr;
+}
 
-    wxImage image;
-    bool isImageLoaded { false };
-    // We need to know what the original file type is because if we convert it to a header, then XPM and BMP files will
-    // be converted to PNG before saving.
+// Change the version whenever OptimizePng() changes what it produces so that cached headers are regenerated.
+inline constexpr const auto txtPngCodec = "png-opt1";
 
-    ttString mime_type;
-    wxFFileInputStream stream(files[0].wx_str());
-    if (stream.IsOk())
+// These match the libpng values for PNG_FILTER_NONE ... PNG_ALL_FILTERS
+enum : int
+{
+    png_filter_none = 0x08,
+    png_filter_sub = 0x10,
+    png_filter_up = 0x20,
+    png_filter_avg = 0x40,
+    png_filter_paeth = 0x80,
+    png_filter_all = 0xF8,
+};
+
+// These match the zlib values for Z_DEFAULT_STRATEGY, Z_FILTERED and Z_RLE
+enum : int
+{
+    z_strategy_default = 0,
+    z_strategy_filtered = 1,
+    z_strategy_rle = 3,
+};
+
+// Returns true if decoded has exactly the same pixels as original. A missing alpha channel is treated as fully
+// opaque.
+static bool isSameImage(const wxImage& original, const wxImage& decoded)
+{
+    if (original.GetWidth() != decoded.GetWidth() || original.GetHeight() != decoded.GetHeight())
+        return false;
+
+    const size_t pixels = static_cast<size_t>(original.GetWidth()) * original.GetHeight();
+    if (std::memcmp(original.GetData(), decoded.GetData(), pixels * 3) != 0)
+        return false;
+
+    auto org_alpha = original.HasAlpha() ? original.GetAlpha() : nullptr;
+    auto new_alpha = decoded.HasAlpha() ? decoded.GetAlpha() : nullptr;
+    for (size_t pos = 0; pos < pixels; ++pos)
     {
-        wxBufferedInputStream bstream(stream);
+        if ((org_alpha ? org_alpha[pos] : wxALPHA_OPAQUE) != (new_alpha ? new_alpha[pos] : wxALPHA_OPAQUE))
+            return false;
+    }
+    return true;
+}
+
+// Tries every combination of colour type, row filter and zlib strategy and writes the smallest PNG to out. Every
+// candidate is decoded and compared against the original pixels, so only lossless reductions are ever used.
+//
+// The candidates are always tried in the same order and a later candidate must be strictly smaller to replace an
+// earlier one, so the result is deterministic for any given input -- which is what keeps the asset cache stable.
+//
+// Returns false if no candidate could be created, in which case the caller should save the image normally.
+static bool OptimizePng(const wxImage& source, wxOutputStream& out)
+{
+    // Images with a mask colour are left alone -- the PNG handler converts the mask to transparency, so the pixels
+    // cannot be compared directly.
+    if (source.HasMask())
+        return false;
+
+    wxImage image(source);
+    const size_t pixels = static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+    if (!pixels)
+        return false;
+
+    // An alpha channel where every pixel is opaque adds nothing but size.
+    if (image.HasAlpha())
+    {
+        auto alpha = image.GetAlpha();
+        if (std::all_of(alpha, alpha + pixels, [](unsigned char value) { return value == wxALPHA_OPAQUE; }))
+            image.ClearAlpha();
+    }
 
-        wxImageHandler* handler;
-        auto& list = wxImage::GetHandlers();
-        for (auto node = list.GetFirst(); node; node = node->GetNext())
+    bool isGrey = true;
+    {
+        auto rgb = image.GetData();
+        for (size_t pos = 0; pos < pixels; ++pos, rgb += 3)
         {
-            handler = (wxImageHandler*) node->GetData();
-            if (handler->CanRead(stream))
+            if (rgb[0] != rgb[1] || rgb[0] != rgb[2])
             {
-                mime_type = handler->GetMimeType();
+                isGrey = false;
+                break;
+            }
+        }
+    }
+
+    std::vector<int> formats;
+    if (isGrey)
+        formats.push_back(wxPNG_TYPE_GREY_RED);  // uses the red channel as is rather than computing luminance
+    if (image.CountColours(256) <= 256)
+        formats.push_back(wxPNG_TYPE_PALETTE);
+    formats.push_back(wxPNG_TYPE_COLOUR);
 
-                if (handler->LoadFile(&image, stream))
+    static constexpr int filters[] = { png_filter_none, png_filter_sub,   png_filter_up,
+                                       png_filter_avg,  png_filter_paeth, png_filter_all };
+    static constexpr int strategies[] = { z_strategy_default, z_strategy_filtered, z_strategy_rle };
+
+    std::string best;
+    for (auto format: formats)
+    {
+        bool isFormatLossless = true;
+        for (auto filter: filters)
+        {
+            for (auto strategy: strategies)
+            {
+                wxImage candidate(image);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_FORMAT, format);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_BITDEPTH, 8);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_FILTER, filter);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL, 9);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_MEM_LEVEL, 9);
+                candidate.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_STRATEGY, strategy);
+
+                wxMemoryOutputStream stream;
+                if (!candidate.SaveFile(stream, wxBITMAP_TYPE_PNG))
+                    continue;
+
+                auto size = static_cast<size_t>(stream.GetLength());
+                if (best.size() && size >= best.size())
+                    continue;
+
+                std::string data(size, 0);
+                stream.CopyTo(data.data(), size);
+
+                // The filter and strategy only affect how the pixels are compressed, so if the colour type loses
+                // information with one of them, it loses it with all of them.
+                wxMemoryInputStream verify_stream(data.data(), data.size());
+                wxImage decoded;
+                if (!decoded.LoadFile(verify_stream, wxBITMAP_TYPE_PNG) || !isSameImage(source, decoded))
                 {
-                    isImageLoaded = true;
+                    isFormatLossless = false;
                     break;
                 }
-                else
-                {
-                    std::cerr << "Unable to read " << files[0].c_str();
-
-                    return 1;
-                }
+                best = std::move(data);
             }
+            if (!isFormatLossless)
+                break;
         }
     }
 
-    if (!isImageLoaded)
+    if (best.empty())
+        return false;
+
+    out.Write(best.data(), best.size());
+    return out.LastWrite() == best.size();
+}
+
+// A single image conversion. It is split into steps so that a batch conversion can run the steps that don't use wxImage
+// on a thread pool (see ConvertImageBatch()). Any errors are returned in errMsg rather than being displayed.
+struct ImageJob
+{
+    ImageJob(const ttlib::cstr& source, const ttlib::cstr& dest, const ttlib::cstr& cache_dir) :
+        src(source), dst(dest), cache(cache_dir)
+    {
+    }
+
+    ttlib::cstr src;
+    ttlib::cstr dst;
+    CAssetCache cache;
+    std::string encoded;  // the converted image that gets written to dst
+    ttlib::cstr errMsg;
+    bool isCached { false };
+};
+
+// Returns true if a previous conversion of the same image was found in the cache and copied to dst. Safe to call from
+// any thread.
+static bool FetchImage(ImageJob& job, bool isXpm)
+{
+    if (isXpm)
+        return job.cache.ComputeKey("xpm", 0, { job.src }, job.dst) && job.cache.Fetch(job.dst);
+    return job.cache.ComputeKey(txtPngCodec, 9, { job.src }, job.dst) && job.cache.Fetch(job.dst);
+}
+
+// Loads the image and sets job.encoded to the image data the header will contain. This uses wxImage, so it must only
+// be called from the main thread.
+static bool EncodeHeaderImage(ImageJob& job)
+{
+    // Add all image handlers so that the EmbedImage class can be used to convert any type of image that wxWidgets
+    // supports.
+    InitImageHandlers();
+
+    wxImage image;
+    // We need to know what the original file type is because if we convert it to a header, then XPM and BMP files will
+    // be converted to PNG before saving.
+
+    ttString mime_type;
+    wxFFileInputStream stream(job.src.wx_str());
+    if (!stream.IsOk())
+    {
+        job.errMsg << "Cannot open " << job.src;
+        return false;
+    }
+
+    auto handler = FindImageHandler(job.src, stream);
+    if (!handler)
     {
-        std::cerr << "Unrecognized image file format in " << files[0].c_str();
+        job.errMsg << "Unrecognized image file format in " << job.src;
+        return false;
+    }
+
+    mime_type = handler->GetMimeType();
+    if (!handler->LoadFile(&image, stream))
+    {
+        job.errMsg << "Unable to read " << job.src;
+        return false;
     }
 
     ttString suffix(mime_type);
@@ -111,31 +302,36 @@ int ConvertImageToHeader(std::vector<ttlib::cstr>& files)
         image.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL, 9);
         image.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_MEM_LEVEL, 9);
 
-        image.SaveFile(save_stream, wxBITMAP_TYPE_PNG);
+        if (!OptimizePng(image, save_stream))
+            image.SaveFile(save_stream, wxBITMAP_TYPE_PNG);
     }
     else
     {
         image.SaveFile(save_stream, mime_type);
     }
 
-    auto read_stream = save_stream.GetOutputStreamBuffer();
+    job.encoded.resize(static_cast<size_t>(save_stream.GetLength()));
+    save_stream.CopyTo(job.encoded.data(), job.encoded.size());
+    return true;
+}
 
+// Writes job.encoded to job.dst as an array of bytes. Safe to call from any thread.
+static bool CommitHeaderImage(ImageJob& job)
+{
     ttlib::textfile file_out;
 
-    ttlib::cstr string_name = files[1].filename();
+    ttlib::cstr string_name = job.dst.filename();
 
     string_name.remove_extension();
     string_name.Replace(".", "_", true);
 
     file_out.emplace_back(txt_ImgPrefix);
-    file_out.addEmptyLine().Format("const unsigned char %s[%zu] = {", string_name.c_str(), read_stream->GetBufferSize());
+    file_out.addEmptyLine().Format("const unsigned char %s[%zu] = {", string_name.c_str(), job.encoded.size());
 
-    read_stream->Seek(0, wxFromStart);
-
-    auto buf = static_cast<unsigned char*>(read_stream->GetBufferStart());
+    auto buf = reinterpret_cast<const unsigned char*>(job.encoded.data());
 
     size_t pos = 0;
-    auto buf_size = read_stream->GetBufferSize();
+    auto buf_size = job.encoded.size();
 
     while (pos < buf_size)
     {
@@ -152,11 +348,231 @@ int ConvertImageToHeader(std::vector<ttlib::cstr>& files)
         file_out[file_out.size() - 1].pop_back();
 
     file_out.addEmptyLine() << "};";
-    if (!file_out.WriteFile(files[1]))
+    if (!job.cache.Commit(file_out, job.dst))
+    {
+        job.errMsg << "Unable to write converted image to " << job.dst;
+        return false;
+    }
+
+    return true;
+}
+
+// Loads the image and sets job.encoded to the XPM file. This uses wxImage, so it must only be called from the main
+// thread.
+static bool EncodeXpmImage(ImageJob& job)
+{
+    // Add all image handlers so that any type of image that wxWidgets supports can be converted.
+    InitImageHandlers();
+
+    wxImage image;
     {
-        std::cerr << "Unable to write converted image to " << files[1].c_str();
+        wxFFileInputStream stream(job.src.wx_str());
+        auto handler = stream.IsOk() ? FindImageHandler(job.src, stream) : nullptr;
+        if (!handler || !handler->LoadFile(&image, stream))
+        {
+            job.errMsg << "Cannot load the image file " << job.src;
+            return false;
+        }
+    }
+
+    if (image.HasAlpha())
+        image.ConvertAlphaToMask(wxIMAGE_ALPHA_THRESHOLD);
+
+    // The XPM handler uses this option for the name of the array. SaveFile() sets it automatically when given a
+    // filename, but we're saving to a stream so that the file only gets written if it actually changed.
+    ttlib::cstr array_name = job.dst.filename();
+    array_name.remove_extension();
+    image.SetOption(wxIMAGE_OPTION_FILENAME, array_name.wx_str());
+
+    wxMemoryOutputStream save_stream;
+    if (!image.SaveFile(save_stream, wxBITMAP_TYPE_XPM))
+    {
+        job.errMsg << "Cannot save the XPM file " << job.dst;
+        return false;
+    }
+
+    job.encoded.resize(static_cast<size_t>(save_stream.GetLength()));
+    save_stream.CopyTo(job.encoded.data(), job.encoded.size());
+    return true;
+}
+
+// Safe to call from any thread.
+static bool CommitXpmImage(ImageJob& job)
+{
+    if (!job.cache.Commit(job.encoded.data(), job.encoded.size(), job.dst))
+    {
+        job.errMsg << "Cannot save the XPM file " << job.dst;
+        return false;
+    }
+
+    return true;
+}
+
+int ConvertImageToHeader(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir)
+{
+    if (files.size() < 2)
+    {
+        std::cerr << "both src and dest files must be specified" << '\n';
         return 1;
     }
 
+    ImageJob job(files[0], files[1], cache_dir);
+    if (!FetchImage(job, false) && (!EncodeHeaderImage(job) || !CommitHeaderImage(job)))
+    {
+        std::cerr << job.errMsg << '\n';
+        return 1;
+    }
     return 0;
 }
+
+int ConvertImageToXpm(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir)
+{
+    if (files.size() < 2)
+    {
+        std::cerr << "both src and dest files must be specified" << '\n';
+        return 1;
+    }
+
+    ImageJob job(files[0], files[1], cache_dir);
+    if (!FetchImage(job, true) && (!EncodeXpmImage(job) || !CommitXpmImage(job)))
+    {
+        std::cerr << job.errMsg << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Splits a ninja response file into filenames. Ninja quotes any filename containing special characters the way the
+// platform's shell expects:
+//
+//     POSIX:   'it'\''s here'  -- single quotes, with an embedded quote written as '\'' (close, escaped quote, reopen)
+//     Windows: "it\"s here"    -- double quotes, with the CommandLineToArgvW() rules for backslashes before a quote
+static void ParseResponseFile(std::string_view contents, std::vector<ttlib::cstr>& names)
+{
+    size_t pos = 0;
+    while (pos < contents.size())
+    {
+        while (pos < contents.size() && std::isspace(static_cast<unsigned char>(contents[pos])))
+            ++pos;
+        if (pos >= contents.size())
+            break;
+
+        auto& name = names.emplace_back();
+        while (pos < contents.size() && !std::isspace(static_cast<unsigned char>(contents[pos])))
+        {
+            if (contents[pos] == '\'')
+            {
+                // Everything up to the next single quote is literal
+                for (++pos; pos < contents.size() && contents[pos] != '\''; ++pos)
+                    name += contents[pos];
+                ++pos;
+            }
+            else if (contents[pos] == '"')
+            {
+                for (++pos; pos < contents.size(); ++pos)
+                {
+                    // 2n backslashes followed by a quote are n backslashes and the end of the quoted text, 2n + 1
+                    // backslashes followed by a quote are n backslashes and a literal quote. Any other backslashes
+                    // are literal.
+                    size_t backslashes = 0;
+                    while (pos < contents.size() && contents[pos] == '\\')
+                    {
+                        ++backslashes;
+                        ++pos;
+                    }
+                    if (pos < contents.size() && contents[pos] == '"')
+                    {
+                        name.append(backslashes / 2, '\\');
+                        if (backslashes % 2 == 0)
+                            break;
+                        name += '"';
+                    }
+                    else
+                    {
+                        name.append(backslashes, '\\');
+                        if (pos >= contents.size())
+                            break;
+                        name += contents[pos];
+                    }
+                }
+                ++pos;
+            }
+#if !defined(_WIN32)
+            else if (contents[pos] == '\\' && pos + 1 < contents.size())
+            {
+                // Outside of quotes, a backslash escapes the next character (this is how '\'' produces a quote)
+                name += contents[pos + 1];
+                pos += 2;
+            }
+#endif  // _WIN32
+            else
+            {
+                name += contents[pos++];
+            }
+        }
+    }
+}
+
+// The response file contains all the source images followed by all the output headers (ninja's "$in $out"). Every image
+// is converted in a single process rather than ninja launching a separate process for each image.
+int ConvertImageBatch(const ttlib::cstr& rsp_file, bool isXpm, const ttlib::cstr& cache_dir)
+{
+    std::string contents;
+    if (!ReadFileBytes(rsp_file, contents))
+    {
+        std::cerr << "Cannot open " << rsp_file << '\n';
+        return 1;
+    }
+
+    std::vector<ttlib::cstr> names;
+    ParseResponseFile(contents, names);
+    if (names.empty() || names.size() % 2)
+    {
+        std::cerr << rsp_file << " must contain a matching destination for every source image" << '\n';
+        return 1;
+    }
+
+    const size_t count = names.size() / 2;
+    std::vector<ImageJob> jobs;
+    jobs.reserve(count);
+    for (size_t idx = 0; idx < count; ++idx)
+        jobs.emplace_back(names[idx], names[count + idx], cache_dir);
+
+    // wxWidgets doesn't guarantee that its image handlers are thread-safe -- every wxImage shares the same handler
+    // objects. So every wxImage load and save (which includes the PNG compression) is done on this thread, and only the
+    // cache lookups (which hash each source image) and creating and writing the output files run on the thread pool.
+    {
+        CThreadPool pool(std::min<size_t>(count, std::thread::hardware_concurrency()));
+        for (auto& job: jobs)
+            pool.Add([&job, isXpm]() { job.isCached = FetchImage(job, isXpm); });
+        pool.Wait();
+
+        for (auto& job: jobs)
+        {
+            if (job.isCached || !(isXpm ? EncodeXpmImage(job) : EncodeHeaderImage(job)))
+                continue;
+
+            // The output is written while the next image is being encoded
+            pool.Add(
+                [&job, isXpm]()
+                {
+                    if (isXpm)
+                        CommitXpmImage(job);
+                    else
+                        CommitHeaderImage(job);
+                });
+        }
+        pool.Wait();
+    }
+
+    int result = 0;
+    for (auto& job: jobs)
+    {
+        if (job.errMsg.size())
+        {
+            std::cerr << job.errMsg << '\n';
+            result = 1;
+        }
+    }
+    return result;
+}
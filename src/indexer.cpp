@@ -0,0 +1,1178 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Creates a shareable symbol index for every source file in a project
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <set>
+
+#include "indexer.h"
+
+#include "assetcache.h"  // HashFnv1a, ReadFileBytes, WriteIfChanged
+#include "csrcfiles.h"   // CSrcFiles
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "threadpool.h"  // CThreadPool -- Simple fixed-size thread pool for running independent tasks
+#include "trace.h"       // CTrace -- Scoped timers and counters exported as a Chrome trace
+
+// Changing the shard contents MUST change this number so that shards created by a previous version are ignored.
+static constexpr int INDEX_FORMAT = 2;
+
+// Pseudo-tags are the standard way for a tag file to describe itself -- readers ignore the ones they don't recognize.
+static constexpr const char* txtTagHeader = "!_TAG_FILE_FORMAT\t2\t/extended format/\n"
+                                            "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n"
+                                            "!_TAG_PROGRAM_NAME\tttBld\t//\n";
+static constexpr std::string_view txtTagIndexFormat = "!_TTBLD_INDEX_FORMAT\t";
+static constexpr std::string_view txtTagSourceHash = "!_TTBLD_SOURCE_HASH\t";
+static constexpr std::string_view txtTagInclude = "!_TTBLD_INCLUDE\t";
+
+static ttlib::cstr HashToString(uint64_t hash)
+{
+    ttlib::cstr result;
+    result.Format("%016llx", static_cast<unsigned long long>(hash));
+    return result;
+}
+
+static bool IsIndexable(const ttlib::cstr& filename)
+{
+    auto ext = filename.extension();
+    for (auto iter: { ".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp" })
+    {
+        if (ext.is_sameas(iter, tt::CASE::either))
+            return true;
+    }
+    return false;
+}
+
+/////////////////////////////////// Symbol extraction ///////////////////////////////////
+
+namespace
+{
+    struct Token
+    {
+        std::string_view text;
+        size_t line;
+        bool isIdent;
+    };
+
+    struct Symbol
+    {
+        size_t line;
+        const char* kind;
+        std::string name;
+        std::string scope;       // enclosing namespace, class or enum
+        const char* scope_kind;  // "namespace", "class" or "enum" -- nullptr if scope is empty
+        bool isDefinition;
+    };
+
+    // Splits a file into identifiers and punctuation. Comments, string and character literals and numbers are
+    // skipped (a string literal becomes a single '"' token). Preprocessor directives are not tokenized -- #define and
+    // quoted #include directives are reported directly.
+    class CTokenizer
+    {
+    public:
+        CTokenizer(std::string_view src, std::vector<Symbol>& symbols, std::vector<ttlib::cstr>& includes) :
+            m_src(src), m_symbols(symbols), m_includes(includes)
+        {
+        }
+
+        std::vector<Token> Tokenize();
+
+    protected:
+        void Directive();
+        void SkipQuoted(char quote);
+        void SkipRawString();
+
+        static bool IsIdentChar(char ch) { return ttlib::is_alpha(ch) || ttlib::is_digit(ch) || ch == '_'; }
+
+    private:
+        std::string_view m_src;
+        std::vector<Symbol>& m_symbols;
+        std::vector<ttlib::cstr>& m_includes;
+
+        size_t m_pos { 0 };
+        size_t m_line { 1 };
+    };
+
+    std::vector<Token> CTokenizer::Tokenize()
+    {
+        std::vector<Token> tokens;
+        bool line_start = true;
+
+        while (m_pos < m_src.size())
+        {
+            char ch = m_src[m_pos];
+            if (ch == '\n')
+            {
+                ++m_line;
+                ++m_pos;
+                line_start = true;
+                continue;
+            }
+            if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v')
+            {
+                ++m_pos;
+                continue;
+            }
+
+            if (ch == '#' && line_start)
+            {
+                Directive();
+                continue;
+            }
+            line_start = false;
+
+            if (ch == '/' && m_pos + 1 < m_src.size() && m_src[m_pos + 1] == '/')
+            {
+                while (m_pos < m_src.size() && m_src[m_pos] != '\n')
+                    ++m_pos;
+            }
+            else if (ch == '/' && m_pos + 1 < m_src.size() && m_src[m_pos + 1] == '*')
+            {
+                m_pos += 2;
+                while (m_pos + 1 < m_src.size() && !(m_src[m_pos] == '*' && m_src[m_pos + 1] == '/'))
+                {
+                    if (m_src[m_pos] == '\n')
+                        ++m_line;
+                    ++m_pos;
+                }
+                m_pos += 2;
+            }
+            else if (ch == '"' || ch == '\'')
+            {
+                if (ch == '"')
+                    tokens.push_back({ m_src.substr(m_pos, 1), m_line, false });
+                SkipQuoted(ch);
+            }
+            else if (ttlib::is_digit(ch) ||
+                     (ch == '.' && m_pos + 1 < m_src.size() && ttlib::is_digit(m_src[m_pos + 1])))
+            {
+                // This also consumes digit separators, suffixes and exponents
+                while (m_pos < m_src.size() &&
+                       (IsIdentChar(m_src[m_pos]) || m_src[m_pos] == '.' || m_src[m_pos] == '\''))
+                {
+                    ++m_pos;
+                }
+            }
+            else if (IsIdentChar(ch))
+            {
+                auto start = m_pos;
+                while (m_pos < m_src.size() && IsIdentChar(m_src[m_pos]))
+                    ++m_pos;
+                auto ident = m_src.substr(start, m_pos - start);
+
+                // String literal prefixes: R"(...)", u8"...", L'x', etc.
+                if (m_pos < m_src.size() && (m_src[m_pos] == '"' || m_src[m_pos] == '\''))
+                {
+                    if (ident == "R" || ident == "LR" || ident == "uR" || ident == "UR" || ident == "u8R")
+                    {
+                        tokens.push_back({ m_src.substr(m_pos, 1), m_line, false });
+                        SkipRawString();
+                        continue;
+                    }
+                    if (ident == "L" || ident == "u" || ident == "U" || ident == "u8")
+                        continue;
+                }
+                tokens.push_back({ ident, m_line, true });
+            }
+            else if (ch == ':' && m_pos + 1 < m_src.size() && m_src[m_pos + 1] == ':')
+            {
+                tokens.push_back({ m_src.substr(m_pos, 2), m_line, false });
+                m_pos += 2;
+            }
+            else
+            {
+                tokens.push_back({ m_src.substr(m_pos, 1), m_line, false });
+                ++m_pos;
+            }
+        }
+        return tokens;
+    }
+
+    void CTokenizer::SkipQuoted(char quote)
+    {
+        for (++m_pos; m_pos < m_src.size(); ++m_pos)
+        {
+            if (m_src[m_pos] == '\\')
+            {
+                if (m_pos + 1 < m_src.size() && m_src[m_pos + 1] == '\n')
+                    ++m_line;
+                ++m_pos;
+            }
+            else if (m_src[m_pos] == quote)
+            {
+                ++m_pos;
+                return;
+            }
+            else if (m_src[m_pos] == '\n')
+            {
+                // Unterminated literal -- don't let it swallow the rest of the file
+                return;
+            }
+        }
+    }
+
+    void CTokenizer::SkipRawString()
+    {
+        auto open_paren = m_src.find('(', m_pos);
+        if (open_paren == std::string_view::npos)
+        {
+            m_pos = m_src.size();
+            return;
+        }
+
+        std::string terminator(")");
+        terminator += m_src.substr(m_pos + 1, open_paren - m_pos - 1);
+        terminator += '"';
+
+        auto end = m_src.find(terminator, open_paren);
+        end = (end == std::string_view::npos ? m_src.size() : end + terminator.size());
+        for (; m_pos < end; ++m_pos)
+        {
+            if (m_src[m_pos] == '\n')
+                ++m_line;
+        }
+    }
+
+    void CTokenizer::Directive()
+    {
+        auto line = m_line;
+
+        // Collect the logical line, joining any continuation lines and stopping at a comment
+        std::string directive;
+        for (++m_pos; m_pos < m_src.size() && m_src[m_pos] != '\n'; ++m_pos)
+        {
+            if (m_src[m_pos] == '\\')
+            {
+                auto next = m_pos + 1;
+                if (next < m_src.size() && m_src[next] == '\r')
+                    ++next;
+                if (next < m_src.size() && m_src[next] == '\n')
+                {
+                    m_pos = next;
+                    ++m_line;
+                    continue;
+                }
+            }
+            if (m_src[m_pos] == '/' && m_pos + 1 < m_src.size() &&
+                (m_src[m_pos + 1] == '/' || m_src[m_pos + 1] == '*'))
+            {
+                break;
+            }
+            directive += m_src[m_pos];
+        }
+
+        // Skip the remainder of the line (a trailing comment)
+        while (m_pos < m_src.size() && m_src[m_pos] != '\n')
+            ++m_pos;
+
+        std::string_view text(directive);
+        auto skip_space = [&]()
+        {
+            while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+                text.remove_prefix(1);
+        };
+        auto word = [&]()
+        {
+            skip_space();
+            size_t len = 0;
+            while (len < text.size() && IsIdentChar(text[len]))
+                ++len;
+            auto result = text.substr(0, len);
+            text.remove_prefix(len);
+            return result;
+        };
+
+        auto keyword = word();
+        if (keyword == "define")
+        {
+            auto name = word();
+            if (!name.empty())
+                m_symbols.push_back({ line, "macro", std::string(name), {}, nullptr, true });
+        }
+        else if (keyword == "include")
+        {
+            skip_space();
+            if (!text.empty() && text.front() == '"')
+            {
+                auto end = text.find('"', 1);
+                if (end != std::string_view::npos && end > 1)
+                    m_includes.emplace_back(text.substr(1, end - 1));
+            }
+        }
+    }
+
+    // Walks the token stream one statement at a time, keeping track of the namespace/class scope. Function bodies and
+    // initializers are skipped entirely.
+    class CSymbolParser
+    {
+    public:
+        CSymbolParser(const std::vector<Token>& tokens, std::vector<Symbol>& symbols) :
+            m_tokens(tokens), m_symbols(symbols)
+        {
+        }
+
+        void Parse();
+
+    protected:
+        enum SCOPE_KIND
+        {
+            scope_namespace,
+            scope_type,
+            scope_enum,
+            scope_linkage,  // extern "C" { ... }
+        };
+
+        struct Scope
+        {
+            SCOPE_KIND kind;
+            std::string name;
+            bool isTypedef { false };  // typedef struct { ... } name;
+        };
+
+        void OpenBrace();
+        void Declaration();
+        void Enumerator();
+
+        // Removes any leading template<...>, attributes and specifiers that don't affect the name
+        size_t SkipPrefix(size_t pos) const;
+
+        // Returns the position of the first '(' at the top level of the statement that follows a name, or npos
+        size_t FindCallParen(size_t start, size_t& name_begin, std::string& name) const;
+
+        std::string CurrentScope() const;
+        void AddSymbol(const Token& token, const char* kind, std::string_view qualifier, std::string_view name,
+                       bool isDefinition);
+
+        static bool IsMacroName(std::string_view name)
+        {
+            return std::all_of(name.begin(), name.end(),
+                               [](char ch) { return (ch >= 'A' && ch <= 'Z') || ttlib::is_digit(ch) || ch == '_'; });
+        }
+
+        bool IsTypeScope() const { return !m_scopes.empty() && m_scopes.back().kind == scope_type; }
+
+        // Returns true if name is a constructor or destructor of the current class
+        bool IsConstructor(std::string_view name) const;
+
+    private:
+        const std::vector<Token>& m_tokens;
+        std::vector<Symbol>& m_symbols;
+
+        std::vector<Scope> m_scopes;
+        std::vector<const Token*> m_stmt;
+
+        bool m_isTypedefTail { false };  // the statement after the closing brace of a typedef'd struct or enum
+    };
+
+    void CSymbolParser::Parse()
+    {
+        size_t skip_depth = 0;   // > 0 while inside a function body or a braced initializer
+        size_t nested = 0;       // parenthesis and bracket depth within the current statement
+        size_t init_braces = 0;  // braces belonging to a constructor's member initializers
+        bool in_ctor_init = false;
+
+        for (auto& token: m_tokens)
+        {
+            auto ch = token.text[0];
+            if (skip_depth)
+            {
+                if (ch == '{' && token.text.size() == 1)
+                    ++skip_depth;
+                else if (ch == '}')
+                    --skip_depth;
+                continue;
+            }
+
+            if (token.text == "(" || token.text == "[")
+            {
+                ++nested;
+                m_stmt.push_back(&token);
+                continue;
+            }
+            if (token.text == ")" || token.text == "]")
+            {
+                if (nested)
+                    --nested;
+                m_stmt.push_back(&token);
+                continue;
+            }
+
+            if (nested || init_braces)
+            {
+                if (ch == '{')
+                    ++init_braces;
+                else if (ch == '}' && init_braces)
+                    --init_braces;
+                m_stmt.push_back(&token);
+                continue;
+            }
+
+            if (ch == '{')
+            {
+                // In a member initializer list, "m_value { 0 }" is an initializer rather than the function body
+                if (in_ctor_init && !m_stmt.empty() && (m_stmt.back()->isIdent || m_stmt.back()->text == ">"))
+                {
+                    ++init_braces;
+                    m_stmt.push_back(&token);
+                    continue;
+                }
+                auto scopes = m_scopes.size();
+                m_isTypedefTail = false;
+                OpenBrace();
+                if (m_scopes.size() == scopes)
+                    skip_depth = 1;
+                in_ctor_init = false;
+                m_stmt.clear();
+            }
+            else if (ch == '}')
+            {
+                if (!m_scopes.empty() && m_scopes.back().kind == scope_enum)
+                    Enumerator();
+                if (!m_scopes.empty())
+                {
+                    m_isTypedefTail = m_scopes.back().isTypedef;
+                    m_scopes.pop_back();
+                }
+                m_stmt.clear();
+            }
+            else if (ch == ';')
+            {
+                Declaration();
+                m_isTypedefTail = false;
+                in_ctor_init = false;
+                m_stmt.clear();
+            }
+            else if (ch == ',' && !m_scopes.empty() && m_scopes.back().kind == scope_enum)
+            {
+                Enumerator();
+                m_stmt.clear();
+            }
+            else if (ch == ':' && m_stmt.size() == 1 &&
+                     (m_stmt[0]->text == "public" || m_stmt[0]->text == "protected" || m_stmt[0]->text == "private"))
+            {
+                m_stmt.clear();
+            }
+            else
+            {
+                if (ch == ':' && token.text.size() == 1 && !m_stmt.empty() && m_stmt.back()->text == ")")
+                    in_ctor_init = true;
+
+                // An upper-case name alone on its line is a macro that doesn't need a semicolon (BEGIN_NAMESPACE)
+                if (m_stmt.size() == 1 && m_stmt[0]->line < token.line && IsMacroName(m_stmt[0]->text))
+                    m_stmt.clear();
+                m_stmt.push_back(&token);
+            }
+        }
+    }
+
+    std::string CSymbolParser::CurrentScope() const
+    {
+        std::string scope;
+        for (auto& iter: m_scopes)
+        {
+            if (iter.name.empty())
+                continue;
+            if (scope.size())
+                scope += "::";
+            scope += iter.name;
+        }
+        return scope;
+    }
+
+    void CSymbolParser::AddSymbol(const Token& token, const char* kind, std::string_view qualifier,
+                                  std::string_view name, bool isDefinition)
+    {
+        auto scope = CurrentScope();
+        const char* scope_kind = nullptr;
+        if (qualifier.size())
+        {
+            // Only an out-of-line member definition or a nested class definition has a qualifier
+            if (scope.size())
+                scope += "::";
+            scope += qualifier;
+            scope_kind = "class";
+        }
+        else
+        {
+            for (auto iter = m_scopes.rbegin(); iter != m_scopes.rend(); ++iter)
+            {
+                if (iter->name.empty())
+                    continue;
+                scope_kind = (iter->kind == scope_type ? "class" : iter->kind == scope_enum ? "enum" : "namespace");
+                break;
+            }
+        }
+        m_symbols.push_back({ token.line, kind, std::string(name), std::move(scope), scope_kind, isDefinition });
+    }
+
+    size_t CSymbolParser::SkipPrefix(size_t pos) const
+    {
+        while (pos < m_stmt.size())
+        {
+            auto text = m_stmt[pos]->text;
+            if (text == "template" && pos + 1 < m_stmt.size() && m_stmt[pos + 1]->text == "<")
+            {
+                size_t depth = 0;
+                for (++pos; pos < m_stmt.size(); ++pos)
+                {
+                    if (m_stmt[pos]->text == "<")
+                        ++depth;
+                    else if (m_stmt[pos]->text == ">" && --depth == 0)
+                        break;
+                }
+                ++pos;
+            }
+            else if (text == "[" && pos + 1 < m_stmt.size() && m_stmt[pos + 1]->text == "[")
+            {
+                while (pos < m_stmt.size() && !(m_stmt[pos]->text == "]" && pos > 0 && m_stmt[pos - 1]->text == "]"))
+                    ++pos;
+                ++pos;
+            }
+            else if (text == "inline" || text == "export" || text == "static" || text == "constexpr" ||
+                     text == "consteval" || text == "virtual" || text == "explicit" || text == "typename")
+            {
+                ++pos;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return pos;
+    }
+
+    size_t CSymbolParser::FindCallParen(size_t start, size_t& name_begin, std::string& name) const
+    {
+        size_t angle = 0;
+        for (size_t pos = start; pos < m_stmt.size(); ++pos)
+        {
+            auto text = m_stmt[pos]->text;
+            if (text == "<")
+                ++angle;
+            else if (text == ">" && angle)
+                --angle;
+            else if (angle)
+                continue;
+            else if (text == "=" || text == "{")
+                return tt::npos;
+            else if (text == "operator")
+            {
+                // operator()(...), operator==(...), operator new[](...), operator bool(...)
+                name = "operator";
+                auto paren = pos + 1;
+                if (paren + 1 < m_stmt.size() && m_stmt[paren]->text == "(" && m_stmt[paren + 1]->text == ")")
+                {
+                    name += "()";
+                    paren += 2;
+                }
+                for (; paren < m_stmt.size() && m_stmt[paren]->text != "("; ++paren)
+                {
+                    if (m_stmt[paren]->isIdent && m_stmt[paren - 1]->isIdent)
+                        name += ' ';
+                    name += m_stmt[paren]->text;
+                }
+                name_begin = pos;
+                return paren < m_stmt.size() ? paren : tt::npos;
+            }
+            else if (text == "(")
+            {
+                if (pos == 0 || !m_stmt[pos - 1]->isIdent)
+                    return tt::npos;
+                name_begin = pos - 1;
+                name = m_stmt[pos - 1]->text;
+                if (name_begin > 0 && m_stmt[name_begin - 1]->text == "~")
+                {
+                    --name_begin;
+                    name.insert(0, "~");
+                }
+                return pos;
+            }
+        }
+        return tt::npos;
+    }
+
+    void CSymbolParser::OpenBrace()
+    {
+        if (m_stmt.empty())
+            return;
+
+        auto pos = SkipPrefix(0);
+        if (pos >= m_stmt.size())
+            return;
+
+        bool isTypedef = false;
+        if (m_stmt[pos]->text == "typedef")
+        {
+            isTypedef = true;
+            ++pos;
+            if (pos >= m_stmt.size())
+                return;
+        }
+
+        auto first = m_stmt[pos]->text;
+
+        if (first == "extern" && pos + 2 == m_stmt.size() && m_stmt[pos + 1]->text == "\"")
+        {
+            m_scopes.push_back({ scope_linkage, {} });
+            return;
+        }
+
+        if (first == "namespace")
+        {
+            std::string name;
+            for (++pos; pos < m_stmt.size(); ++pos)
+            {
+                if (m_stmt[pos]->isIdent)
+                {
+                    if (m_stmt[pos]->text == "inline")
+                        continue;
+                    if (name.size())
+                        name += "::";
+                    name += m_stmt[pos]->text;
+                }
+            }
+            if (name.size())
+                AddSymbol(*m_stmt.back(), "namespace", {}, name, true);
+            m_scopes.push_back({ scope_namespace, std::move(name) });
+            return;
+        }
+
+        if (first == "class" || first == "struct" || first == "union")
+        {
+            // The name is the last identifier before the base class list, which skips over any export macro.
+            const char* kind = (first == "class" ? "class" : first == "struct" ? "struct" : "union");
+            const Token* name = nullptr;
+            std::string qualifier;
+            for (++pos; pos < m_stmt.size(); ++pos)
+            {
+                auto text = m_stmt[pos]->text;
+                if (text == ":" || text == "<")
+                    break;
+                if (text == "::" && name)
+                {
+                    if (qualifier.size())
+                        qualifier += "::";
+                    qualifier += name->text;
+                    name = nullptr;
+                }
+                else if (m_stmt[pos]->isIdent && text != "final" && text != "alignas")
+                {
+                    name = m_stmt[pos];
+                }
+            }
+            if (name)
+            {
+                AddSymbol(*name, kind, qualifier, name->text, true);
+                if (qualifier.size())
+                    qualifier += "::";
+                qualifier += name->text;
+            }
+            m_scopes.push_back({ scope_type, std::move(qualifier), isTypedef });
+            return;
+        }
+
+        if (first == "enum")
+        {
+            ++pos;
+            bool isScoped = false;
+            if (pos < m_stmt.size() && (m_stmt[pos]->text == "class" || m_stmt[pos]->text == "struct"))
+            {
+                isScoped = true;
+                ++pos;
+            }
+            std::string name;
+            if (pos < m_stmt.size() && m_stmt[pos]->isIdent)
+            {
+                name = m_stmt[pos]->text;
+                AddSymbol(*m_stmt[pos], "enum", {}, name, true);
+            }
+
+            // Unscoped enumerators belong to the enclosing scope, so an unnamed scope is used for them.
+            m_scopes.push_back({ scope_enum, isScoped ? name : std::string(), isTypedef });
+            return;
+        }
+
+        // Anything else is either a function body or an initializer -- in both cases the braces will be skipped.
+        size_t name_begin;
+        std::string name;
+        auto paren = FindCallParen(pos, name_begin, name);
+        if (paren != tt::npos && (name_begin > pos || IsConstructor(name)))
+        {
+            std::string qualifier;
+            for (auto qual = name_begin; qual >= 2 && m_stmt[qual - 1]->text == "::" && m_stmt[qual - 2]->isIdent;
+                 qual -= 2)
+            {
+                if (qualifier.size())
+                    qualifier.insert(0, "::");
+                qualifier.insert(0, m_stmt[qual - 2]->text);
+            }
+            AddSymbol(*m_stmt[name_begin], (IsTypeScope() || qualifier.size()) ? "method" : "function", qualifier,
+                      name, true);
+            return;
+        }
+
+        // int array[] = { ... }; or Type value { ... };
+        if (m_scopes.empty() || m_scopes.back().kind != scope_enum)
+        {
+            const Token* var = nullptr;
+            for (size_t idx = pos + 1; idx < m_stmt.size(); ++idx)
+            {
+                auto text = m_stmt[idx]->text;
+                if (text == "=" || text == "[")
+                    break;
+                if (m_stmt[idx]->isIdent)
+                    var = m_stmt[idx];
+            }
+            if (var)
+                AddSymbol(*var, IsTypeScope() ? "field" : "variable", {}, var->text, true);
+        }
+    }
+
+    bool CSymbolParser::IsConstructor(std::string_view name) const
+    {
+        if (!IsTypeScope())
+            return false;
+
+        std::string_view class_name = m_scopes.back().name;
+        if (auto pos = class_name.rfind(':'); pos != std::string_view::npos)
+            class_name.remove_prefix(pos + 1);
+        if (name.size() && name[0] == '~')
+            name.remove_prefix(1);
+        return (class_name.size() && name == class_name);
+    }
+
+    void CSymbolParser::Declaration()
+    {
+        if (m_scopes.size() && m_scopes.back().kind == scope_enum)
+            return;
+
+        if (m_isTypedefTail)
+        {
+            // typedef struct { ... } name, *pname;
+            for (auto iter: m_stmt)
+            {
+                if (iter->isIdent)
+                    AddSymbol(*iter, "typedef", {}, iter->text, true);
+            }
+            return;
+        }
+
+        auto pos = SkipPrefix(0);
+        if (pos >= m_stmt.size())
+            return;
+
+        auto first = m_stmt[pos]->text;
+        if (first == "friend" || first == "static_assert" || first == "return" || first == "template" ||
+            first == "namespace")
+        {
+            return;
+        }
+
+        if (first == "using")
+        {
+            // Only aliases are recorded -- using-declarations and using-directives don't declare anything new
+            if (pos + 2 < m_stmt.size() && m_stmt[pos + 1]->isIdent && m_stmt[pos + 2]->text == "=")
+                AddSymbol(*m_stmt[pos + 1], "alias", {}, m_stmt[pos + 1]->text, true);
+            return;
+        }
+
+        if (first == "typedef")
+        {
+            // typedef void (*name)(int); declares name inside the first parenthesis
+            const Token* name = nullptr;
+            for (size_t idx = pos + 1; idx + 2 < m_stmt.size(); ++idx)
+            {
+                if (m_stmt[idx]->text == "(" && m_stmt[idx + 1]->text == "*" && m_stmt[idx + 2]->isIdent)
+                {
+                    name = m_stmt[idx + 2];
+                    break;
+                }
+            }
+            if (!name)
+            {
+                size_t depth = 0;
+                for (size_t idx = pos + 1; idx < m_stmt.size(); ++idx)
+                {
+                    auto text = m_stmt[idx]->text;
+                    if (text == "[" || text == "(")
+                        ++depth;
+                    else if ((text == "]" || text == ")") && depth)
+                        --depth;
+                    else if (!depth && m_stmt[idx]->isIdent)
+                        name = m_stmt[idx];
+                }
+            }
+            if (name)
+                AddSymbol(*name, "typedef", {}, name->text, true);
+            return;
+        }
+
+        if (first == "class" || first == "struct" || first == "union" || first == "enum")
+        {
+            // Forward declarations don't add anything that the definition won't
+            bool isForward = true;
+            for (size_t idx = pos + 1; idx < m_stmt.size(); ++idx)
+            {
+                if (!m_stmt[idx]->isIdent && m_stmt[idx]->text != "::" && m_stmt[idx]->text != ":")
+                    isForward = false;
+            }
+            if (isForward || m_stmt.size() - pos < 3)
+                return;
+        }
+
+        size_t name_begin;
+        std::string name;
+        auto paren = FindCallParen(pos, name_begin, name);
+        if (paren != tt::npos)
+        {
+            // At namespace scope a statement starting with a name followed by '(' is almost always a macro invocation.
+            // In a class, it is a constructor if the name matches the class name.
+            if (name_begin == pos && !IsConstructor(name))
+                return;
+            AddSymbol(*m_stmt[name_begin], IsTypeScope() ? "method" : "function", {}, name, false);
+            return;
+        }
+
+        // A variable or data member -- the name is the last identifier before any initializer, array size or bit field
+        const Token* var = nullptr;
+        size_t angle = 0;
+        for (size_t idx = pos; idx < m_stmt.size(); ++idx)
+        {
+            auto text = m_stmt[idx]->text;
+            if (text == "<")
+                ++angle;
+            else if (text == ">" && angle)
+                --angle;
+            else if (angle)
+                continue;
+            else if (text == "=" || text == "[" || text == "{" || text == ":" || text == "(")
+                break;
+            else if (text == ",")
+                break;
+            else if (m_stmt[idx]->isIdent)
+                var = m_stmt[idx];
+        }
+        if (var && var != m_stmt[pos])
+            AddSymbol(*var, IsTypeScope() ? "field" : "variable", {}, var->text, !(first == "extern"));
+    }
+
+    void CSymbolParser::Enumerator()
+    {
+        if (!m_stmt.empty() && m_stmt[0]->isIdent)
+            AddSymbol(*m_stmt[0], "enumerator", {}, m_stmt[0]->text, true);
+    }
+}  // namespace
+
+/////////////////////////////////// CIndexer ///////////////////////////////////
+
+// Returns the kind letter that ctags uses for C++ symbols
+static char GetKindLetter(const Symbol& symbol)
+{
+    // clang-format off
+    static constexpr std::pair<std::string_view, char> kinds[] = {
+        { "namespace",  'n' },
+        { "class",      'c' },
+        { "struct",     's' },
+        { "union",      'u' },
+        { "enum",       'g' },
+        { "enumerator", 'e' },
+        { "macro",      'd' },
+        { "typedef",    't' },
+        { "alias",      't' },
+        { "field",      'm' },
+    };
+    // clang-format on
+
+    std::string_view kind(symbol.kind);
+    if (kind == "function" || kind == "method")
+        return symbol.isDefinition ? 'f' : 'p';
+    if (kind == "variable")
+        return symbol.isDefinition ? 'v' : 'x';
+    for (auto& iter: kinds)
+    {
+        if (iter.first == kind)
+            return iter.second;
+    }
+    return 'v';
+}
+
+// Returns the value of a pseudo-tag line ("!_NAME<TAB>value<TAB>/comment/") if it starts with prefix
+static std::string_view GetPseudoTag(std::string_view line, std::string_view prefix)
+{
+    if (line.substr(0, prefix.size()) != prefix)
+        return {};
+    line.remove_prefix(prefix.size());
+    return line.substr(0, line.find('\t'));
+}
+
+CIndexer::ShardInfo CIndexer::IndexFile(const ttlib::cstr& filename)
+{
+    TRACE_SCOPE("CIndexer::IndexFile");
+
+    ShardInfo info;
+
+    std::string contents;
+    if (!ReadFileBytes(filename, contents))
+    {
+        info.failed = true;
+        return info;
+    }
+
+    // The path (relative to the project) names the shard, and the contents decide whether it is still current. The
+    // basename is only there to make the shard directory easier to browse.
+    auto path = std::filesystem::u8path(filename.c_str()).lexically_normal();
+    auto shard_name = ttlib::cstr(path.filename().u8string());
+    shard_name << '.' << HashToString(HashFnv1a(path.generic_u8string())) << ".tags";
+    auto source_hash = HashToString(HashFnv1a(contents));
+
+    ttlib::cstr shard_path(m_index_dir);
+    shard_path.append_filename(shard_name);
+
+    // Tag filenames are relative to the tag file's directory, which is how editors locate them
+    std::error_code ec;
+    auto abs_path = std::filesystem::absolute(path, ec).lexically_normal();
+    auto tag_file = abs_path.lexically_relative(std::filesystem::u8path(m_abs_index_dir)).generic_u8string();
+    if (tag_file.empty())
+        tag_file = abs_path.generic_u8string();
+
+    std::string shard;
+    if (!m_isForced && ReadFileBytes(shard_path, shard))
+    {
+        bool isFormat = false;
+        bool isSource = false;
+        std::vector<ttlib::cstr> includes;
+        std::vector<std::string> tags;
+        std::string_view lines(shard);
+        while (lines.size())
+        {
+            auto end = lines.find('\n');
+            auto line = lines.substr(0, end);
+            lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 1);
+
+            if (line.empty())
+                continue;
+            if (line[0] != '!')
+                tags.emplace_back(line);
+            else if (auto value = GetPseudoTag(line, txtTagIndexFormat); value.size())
+                isFormat = (value == std::to_string(INDEX_FORMAT));
+            else if (value = GetPseudoTag(line, txtTagSourceHash); value.size())
+                isSource = (value == source_hash);
+            else if (value = GetPseudoTag(line, txtTagInclude); value.size())
+                includes.emplace_back(value);
+        }
+
+        if (isFormat && isSource)
+        {
+            info.includes = std::move(includes);
+            info.tags = std::move(tags);
+            info.cached = true;
+            return info;
+        }
+    }
+
+    std::vector<Symbol> symbols;
+    CTokenizer tokenizer(contents, symbols, info.includes);
+    auto tokens = tokenizer.Tokenize();
+    CSymbolParser parser(tokens, symbols);
+    parser.Parse();
+
+    for (auto& iter: symbols)
+    {
+        // name <TAB> file <TAB> line;" <TAB> kind <TAB> line:n [<TAB> scope_kind:scope]
+        std::string tag(iter.name);
+        tag += '\t';
+        tag += tag_file;
+        tag += '\t';
+        tag += std::to_string(iter.line);
+        tag += ";\"\t";
+        tag += GetKindLetter(iter);
+        tag += "\tline:";
+        tag += std::to_string(iter.line);
+        if (iter.scope_kind && iter.scope.size())
+        {
+            tag += '\t';
+            tag += iter.scope_kind;
+            tag += ':';
+            tag += iter.scope;
+        }
+        info.tags.emplace_back(std::move(tag));
+    }
+    std::sort(info.tags.begin(), info.tags.end());
+    info.tags.erase(std::unique(info.tags.begin(), info.tags.end()), info.tags.end());
+
+    std::string out(txtTagHeader);
+    out.append(txtTagIndexFormat).append(std::to_string(INDEX_FORMAT)).append("\t//\n");
+    out.append(txtTagSourceHash).append(source_hash).append("\t//\n");
+    for (auto& iter: info.includes)
+        out.append(txtTagInclude).append(iter).append("\t//\n");
+    for (auto& iter: info.tags)
+        out.append(iter).append(1, '\n');
+
+    if (CPlan::Get().Add(shard_path, out, "symbol index shard"))
+        return info;
+
+    if (m_isDryRun)
+    {
+        std::string current;
+        if (!ReadFileBytes(shard_path, current) || current != out)
+            info.changed_shard = shard_path;
+    }
+    else if (!WriteIfChanged(shard_path, out.data(), out.size()))
+    {
+        info.failed = true;
+    }
+    return info;
+}
+
+ttlib::cstr CIndexer::ResolveInclude(const ttlib::cstr& includer, const ttlib::cstr& header)
+{
+    ttlib::cstr path(includer);
+    path.remove_filename();
+    path.append_filename(header);
+    if (path.file_exists())
+        return path;
+
+    for (auto& iter: m_inc_dirs)
+    {
+        path = iter;
+        path.append_filename(header);
+        if (path.file_exists())
+            return path;
+    }
+    return {};
+}
+
+bool CIndexer::Run(const ttlib::cstr& index_dir)
+{
+    TRACE_SCOPE("CIndexer::Run");
+
+    m_index_dir = index_dir.size() ? index_dir : ttlib::cstr(txtDefIndexDir);
+    m_index_dir.backslashestoforward();
+
+    std::error_code ec;
+    bool isWriting = !m_isDryRun && !CPlan::Get().IsEnabled();
+    if (isWriting)
+        std::filesystem::create_directories(std::filesystem::u8path(m_index_dir.c_str()), ec);
+    if (isWriting && !std::filesystem::is_directory(std::filesystem::u8path(m_index_dir.c_str())))
+    {
+        std::cerr << "Unable to create " << m_index_dir << '\n';
+        return false;
+    }
+    auto abs_index_dir = std::filesystem::absolute(std::filesystem::u8path(m_index_dir.c_str()), ec);
+    m_abs_index_dir = abs_index_dir.lexically_normal().generic_u8string();
+
+    if (m_srcfiles.hasOptValue(OPT::INC_DIRS))
+    {
+        ttlib::multistr dirs(m_srcfiles.getOptValue(OPT::INC_DIRS));
+        for (auto& iter: dirs)
+        {
+            if (iter.size())
+                m_inc_dirs.emplace_back(iter);
+        }
+    }
+
+    // Every file is normalized before it is added, so that no two workers ever write the same shard
+    std::vector<ttlib::cstr> files;
+    std::set<ttlib::cstr> seen;
+    auto add_file = [&](const ttlib::cstr& filename)
+    {
+        ttlib::cstr file(std::filesystem::u8path(filename.c_str()).lexically_normal().generic_u8string());
+        if (IsIndexable(file) && seen.insert(file).second)
+            files.emplace_back(std::move(file));
+    };
+
+    for (auto& iter: m_srcfiles.GetSrcFileList())
+        add_file(iter);
+    for (auto& iter: m_srcfiles.GetDebugFileList())
+        add_file(iter);
+
+    std::vector<std::string> tags;
+
+    // Each pass indexes every file found so far in parallel. The local headers those files include are then indexed in
+    // the next pass, until there are no new headers.
+    CThreadPool pool;
+    size_t first = 0;
+    while (first < files.size())
+    {
+        auto last = files.size();
+        std::vector<ShardInfo> results(last - first);
+        for (auto pos = first; pos < last; ++pos)
+            pool.Add([this, &files, &results, pos, first]() { results[pos - first] = IndexFile(files[pos]); });
+        pool.Wait();
+
+        for (auto pos = first; pos < last; ++pos)
+        {
+            auto& info = results[pos - first];
+            if (info.failed)
+            {
+                std::cerr << "Unable to index " << files[pos] << '\n';
+                continue;
+            }
+            if (info.cached)
+                ++m_cached;
+            else
+                ++m_indexed;
+            if (info.changed_shard.size())
+                std::cout << "Would write " << info.changed_shard << '\n';
+            std::move(info.tags.begin(), info.tags.end(), std::back_inserter(tags));
+
+            for (auto& header: info.includes)
+            {
+                auto path = ResolveInclude(files[pos], header);
+                if (path.size())
+                    add_file(path);
+            }
+        }
+        first = last;
+    }
+
+    if (!WriteTags(tags))
+        return false;
+
+    // The files that would change have already been listed
+    if (m_isDryRun && !CPlan::Get().IsEnabled())
+        return true;
+
+    std::cout << "Indexed " << m_indexed << " file" << (m_indexed == 1 ? "" : "s") << " (" << m_cached
+              << " unchanged) in " << m_index_dir << '\n';
+    return true;
+}
+
+bool CIndexer::WriteTags(std::vector<std::string>& tags)
+{
+    // Editors binary search a sorted tag file, so the order has to match the !_TAG_FILE_SORTED pseudo-tag
+    std::sort(tags.begin(), tags.end());
+
+    std::string out(txtTagHeader);
+    for (auto& iter: tags)
+        out.append(iter).append(1, '\n');
+
+    ttlib::cstr tags_path(m_index_dir);
+    tags_path.append_filename(m_srcfiles.GetProjectName().size() ? m_srcfiles.GetProjectName() :
+                                                                   ttlib::cstr("project"));
+    tags_path << ".tags";
+
+    if (CPlan::Get().Add(tags_path, out, "symbol index tags"))
+        return true;
+
+    if (m_isDryRun)
+    {
+        std::string current;
+        if (!ReadFileBytes(tags_path, current) || current != out)
+            std::cout << "Would write " << tags_path << '\n';
+        return true;
+    }
+
+    if (!WriteIfChanged(tags_path, out.data(), out.size()))
+    {
+        std::cerr << "Unable to write " << tags_path << '\n';
+        return false;
+    }
+    return true;
+}
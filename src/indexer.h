@@ -0,0 +1,81 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Creates a shareable symbol index for every source file in a project
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tttextfile_wx.h"  // Classes for reading and writing line-oriented files
+
+class CSrcFiles;
+
+constexpr const char* txtDefIndexDir { ".cache/ttbld/index" };
+
+// Background indexing of a large project in an IDE can take a very long time, and every developer pays that cost after
+// every fresh checkout or branch switch. This class extracts the symbols (namespaces, types, functions, variables,
+// enumerators, typedefs and macros) from every source file and every local header they #include, and writes one shard
+// per file.
+//
+// Shards are tag files in the extended ctags format, and all of them are merged into <project>.tags which any editor
+// that reads ctags files can use directly. Filenames in both are relative to the index directory.
+//
+// Each shard is named after the file's normalized path relative to the project, and records a hash of the file's
+// contents. A directory of shards produced by a CI build can be copied into the same location in any checkout -- only
+// the files whose contents have actually changed need to be indexed again.
+//
+// This is a lexical extractor rather than a compiler-based indexer: macros are not expanded and templates are not
+// instantiated, which is what makes it fast enough to run over thousands of files in a few seconds.
+class CIndexer
+{
+public:
+    CIndexer(CSrcFiles& srcfiles) : m_srcfiles(srcfiles) {}
+
+    // Indexes every C/C++ file in the project, skipping any file that already has a shard in index_dir. If index_dir
+    // is empty, txtDefIndexDir is used. Returns false if the index directory or manifest cannot be written.
+    bool Run(const ttlib::cstr& index_dir);
+
+    // Forces every file to be indexed even if its shard already exists
+    void ForceWrite() { m_isForced = true; }
+
+    // Nothing is written -- each shard (and the tags file) that would be created or changed is listed instead
+    void EnableDryRun() { m_isDryRun = true; }
+
+    size_t GetIndexedCount() const { return m_indexed; }
+    size_t GetCachedCount() const { return m_cached; }
+
+protected:
+    struct ShardInfo
+    {
+        std::vector<ttlib::cstr> includes;  // quoted #include filenames
+        std::vector<std::string> tags;      // tag lines (without the pseudo-tags)
+        ttlib::cstr changed_shard;          // set during a dry run if the shard would be created or changed
+        bool cached { false };
+        bool failed { false };
+    };
+
+    ShardInfo IndexFile(const ttlib::cstr& filename);
+
+    // Returns the path to a quoted #include, or an empty string if it cannot be located.
+    ttlib::cstr ResolveInclude(const ttlib::cstr& includer, const ttlib::cstr& header);
+
+    // Writes <project>.tags containing every tag from every shard
+    bool WriteTags(std::vector<std::string>& tags);
+
+private:
+    CSrcFiles& m_srcfiles;
+
+    ttlib::cstr m_index_dir;
+    std::string m_abs_index_dir;  // absolute, used to make tag filenames relative to the index directory
+    std::vector<ttlib::cstr> m_inc_dirs;
+
+    size_t m_indexed { 0 };
+    size_t m_cached { 0 };
+
+    bool m_isForced { false };
+    bool m_isDryRun { false };
+};
@@ -0,0 +1,507 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Edits individual values in a JSON file without changing anything else
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include "jsonpatch.h"
+
+// Deeply nested input is rejected rather than risking a stack overflow
+static constexpr size_t MAX_DEPTH = 256;
+
+// Returns the value of the 4 hex digits in str, or 0xFFFD (the Unicode replacement character) if any are invalid
+static unsigned int ParseHex4(std::string_view str)
+{
+    unsigned int value = 0;
+    for (size_t pos = 0; pos < 4; ++pos)
+    {
+        auto ch = (pos < str.size() ? str[pos] : 0);
+        value <<= 4;
+        if (ch >= '0' && ch <= '9')
+            value |= static_cast<unsigned int>(ch - '0');
+        else if (ch >= 'a' && ch <= 'f')
+            value |= static_cast<unsigned int>(ch - 'a' + 10);
+        else if (ch >= 'A' && ch <= 'F')
+            value |= static_cast<unsigned int>(ch - 'A' + 10);
+        else
+            return 0xFFFD;
+    }
+    return value;
+}
+
+bool CJsonPatch::Parse(std::string_view text)
+{
+    m_text = text;
+
+    auto pos = SkipSpace(0);
+    if (pos == tt::npos || pos >= m_text.size())
+        return false;
+    pos = SkipValue(pos);
+    if (pos == tt::npos || SkipSpace(pos) != m_text.size())
+        return false;
+
+    m_eol = (m_text.find("\r\n") != std::string::npos ? "\r\n" : "\n");
+
+    // Use the same indentation as the first indented line
+    m_indent_unit = "    ";
+    for (auto eol = m_text.find('\n'); eol != std::string::npos; eol = m_text.find('\n', eol + 1))
+    {
+        auto indent = GetLineIndent(eol + 1);
+        if (indent.size() && eol + 1 + indent.size() < m_text.size() && m_text[eol + 1 + indent.size()] != '\r' &&
+            m_text[eol + 1 + indent.size()] != '\n')
+        {
+            m_indent_unit = indent;
+            break;
+        }
+    }
+
+    return true;
+}
+
+size_t CJsonPatch::SkipSpace(size_t pos) const
+{
+    while (pos < m_text.size())
+    {
+        auto ch = m_text[pos];
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+        {
+            ++pos;
+        }
+        else if (ch == '/' && pos + 1 < m_text.size() && m_text[pos + 1] == '/')
+        {
+            pos = m_text.find('\n', pos);
+            if (pos == std::string::npos)
+                return m_text.size();
+        }
+        else if (ch == '/' && pos + 1 < m_text.size() && m_text[pos + 1] == '*')
+        {
+            pos = m_text.find("*/", pos + 2);
+            if (pos == std::string::npos)
+                return tt::npos;
+            pos += 2;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return pos;
+}
+
+size_t CJsonPatch::SkipString(size_t pos) const
+{
+    if (pos >= m_text.size() || m_text[pos] != '"')
+        return tt::npos;
+
+    for (++pos; pos < m_text.size(); ++pos)
+    {
+        if (m_text[pos] == '\\')
+            ++pos;
+        else if (m_text[pos] == '"')
+            return pos + 1;
+        else if (m_text[pos] == '\n')
+            return tt::npos;
+    }
+    return tt::npos;
+}
+
+size_t CJsonPatch::SkipValue(size_t pos, size_t depth) const
+{
+    if (pos >= m_text.size() || depth > MAX_DEPTH)
+        return tt::npos;
+
+    auto ch = m_text[pos];
+    if (ch == '"')
+        return SkipString(pos);
+
+    if (ch == '{' || ch == '[')
+    {
+        const char close = (ch == '{' ? '}' : ']');
+        pos = SkipSpace(pos + 1);
+        while (pos != tt::npos && pos < m_text.size() && m_text[pos] != close)
+        {
+            if (ch == '{')
+            {
+                pos = SkipSpace(SkipString(pos));
+                if (pos == tt::npos || pos >= m_text.size() || m_text[pos] != ':')
+                    return tt::npos;
+                pos = SkipSpace(pos + 1);
+            }
+            pos = SkipSpace(SkipValue(pos, depth + 1));
+            if (pos == tt::npos || pos >= m_text.size())
+                return tt::npos;
+            if (m_text[pos] == ',')
+                pos = SkipSpace(pos + 1);
+            else if (m_text[pos] != close)
+                return tt::npos;
+        }
+        return (pos == tt::npos || pos >= m_text.size()) ? tt::npos : pos + 1;
+    }
+
+    // Numbers, true, false and null
+    auto begin = pos;
+    while (pos < m_text.size() && (ttlib::is_alpha(m_text[pos]) || ttlib::is_digit(m_text[pos]) || m_text[pos] == '-' ||
+                                   m_text[pos] == '+' || m_text[pos] == '.'))
+    {
+        ++pos;
+    }
+    return (pos > begin ? pos : tt::npos);
+}
+
+std::string CJsonPatch::ReadString(size_t pos) const
+{
+    std::string result;
+    auto end = SkipString(pos);
+    if (end == tt::npos)
+        return result;
+
+    for (++pos; pos < end - 1; ++pos)
+    {
+        if (m_text[pos] != '\\')
+        {
+            result += m_text[pos];
+            continue;
+        }
+
+        switch (m_text[++pos])
+        {
+            case 'b':
+                result += '\b';
+                break;
+            case 'f':
+                result += '\f';
+                break;
+            case 'n':
+                result += '\n';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'u':
+                if (pos + 4 < end)
+                {
+                    auto code = ParseHex4(std::string_view(m_text).substr(pos + 1, 4));
+                    pos += 4;
+                    if (code >= 0xD800 && code <= 0xDBFF && pos + 6 < end && m_text[pos + 1] == '\\' &&
+                        m_text[pos + 2] == 'u')
+                    {
+                        auto low = ParseHex4(std::string_view(m_text).substr(pos + 3, 4));
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            pos += 6;
+                        }
+                    }
+
+                    // Convert to UTF8
+                    if (code < 0x80)
+                    {
+                        result += static_cast<char>(code);
+                    }
+                    else if (code < 0x800)
+                    {
+                        result += static_cast<char>(0xC0 | (code >> 6));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    else if (code < 0x10000)
+                    {
+                        result += static_cast<char>(0xE0 | (code >> 12));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        result += static_cast<char>(0xF0 | (code >> 18));
+                        result += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                        result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        result += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                }
+                break;
+            default:
+                // \" \\ and \/
+                result += m_text[pos];
+                break;
+        }
+    }
+    return result;
+}
+
+std::string CJsonPatch::QuoteString(std::string_view str)
+{
+    std::string result("\"");
+    for (auto ch: str)
+    {
+        switch (ch)
+        {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\r':
+                result += "\\r";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20)
+                {
+                    ttlib::cstr code;
+                    code.Format("\\u%04x", static_cast<unsigned int>(ch));
+                    result += code;
+                }
+                else
+                {
+                    result += ch;
+                }
+                break;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+bool CJsonPatch::FindValue(const Path& path, size_t& begin, size_t& end) const
+{
+    auto pos = SkipSpace(0);
+    for (auto& key: path)
+    {
+        if (pos == tt::npos || pos >= m_text.size())
+            return false;
+
+        if (key.isIndex)
+        {
+            if (m_text[pos] != '[')
+                return false;
+            pos = SkipSpace(pos + 1);
+            for (size_t index = 0; pos != tt::npos && pos < m_text.size() && m_text[pos] != ']'; ++index)
+            {
+                if (index == key.index)
+                    break;
+                pos = SkipSpace(SkipValue(pos));
+                if (pos != tt::npos && pos < m_text.size() && m_text[pos] == ',')
+                    pos = SkipSpace(pos + 1);
+            }
+            if (pos == tt::npos || pos >= m_text.size() || m_text[pos] == ']')
+                return false;
+        }
+        else
+        {
+            if (m_text[pos] != '{')
+                return false;
+            pos = SkipSpace(pos + 1);
+            bool found = false;
+            while (pos != tt::npos && pos < m_text.size() && m_text[pos] != '}')
+            {
+                found = (ReadString(pos) == key.name);
+                pos = SkipSpace(SkipString(pos));
+                if (pos == tt::npos || pos >= m_text.size() || m_text[pos] != ':')
+                    return false;
+                pos = SkipSpace(pos + 1);
+                if (found)
+                    break;
+                pos = SkipSpace(SkipValue(pos));
+                if (pos != tt::npos && pos < m_text.size() && m_text[pos] == ',')
+                    pos = SkipSpace(pos + 1);
+            }
+            if (!found)
+                return false;
+        }
+    }
+
+    if (pos == tt::npos || pos >= m_text.size())
+        return false;
+    begin = pos;
+    end = SkipValue(pos);
+    return (end != tt::npos);
+}
+
+size_t CJsonPatch::GetArraySize(const Path& path) const
+{
+    size_t begin, end;
+    if (!FindValue(path, begin, end) || m_text[begin] != '[')
+        return 0;
+
+    size_t count = 0;
+    for (auto pos = SkipSpace(begin + 1); pos < end && m_text[pos] != ']'; ++count)
+    {
+        pos = SkipSpace(SkipValue(pos));
+        if (m_text[pos] == ',')
+            pos = SkipSpace(pos + 1);
+    }
+    return count;
+}
+
+bool CJsonPatch::GetStringArray(const Path& path, std::vector<ttlib::cstr>& values) const
+{
+    size_t begin, end;
+    if (!FindValue(path, begin, end) || m_text[begin] != '[')
+        return false;
+
+    for (auto pos = SkipSpace(begin + 1); pos < end && m_text[pos] != ']';)
+    {
+        if (m_text[pos] == '"')
+            values.emplace_back(ReadString(pos));
+        pos = SkipSpace(SkipValue(pos));
+        if (m_text[pos] == ',')
+            pos = SkipSpace(pos + 1);
+    }
+    return true;
+}
+
+bool CJsonPatch::GetString(const Path& path, ttlib::cstr& value) const
+{
+    size_t begin, end;
+    if (!FindValue(path, begin, end) || m_text[begin] != '"')
+        return false;
+    value = ReadString(begin);
+    return true;
+}
+
+std::string_view CJsonPatch::GetLineIndent(size_t pos) const
+{
+    auto line_begin = (pos == 0 ? 0 : m_text.rfind('\n', pos - 1));
+    line_begin = (line_begin == std::string::npos || pos == 0) ? 0 : line_begin + 1;
+
+    auto indent_end = line_begin;
+    while (indent_end < m_text.size() && (m_text[indent_end] == ' ' || m_text[indent_end] == '\t'))
+        ++indent_end;
+    return std::string_view(m_text).substr(line_begin, indent_end - line_begin);
+}
+
+std::string CJsonPatch::FormatStringArray(const std::vector<ttlib::cstr>& values, std::string_view indent,
+                                          std::string_view element_indent) const
+{
+    if (values.empty())
+        return "[]";
+
+    std::string result("[");
+    for (size_t idx = 0; idx < values.size(); ++idx)
+    {
+        result += m_eol;
+        result += element_indent;
+        result += QuoteString(values[idx]);
+        if (idx + 1 < values.size())
+            result += ',';
+    }
+    result += m_eol;
+    result += indent;
+    result += ']';
+    return result;
+}
+
+template <typename T>
+bool CJsonPatch::SetValue(const Path& path, T format_value)
+{
+    size_t begin, end;
+    if (FindValue(path, begin, end))
+    {
+        auto value = format_value(begin, GetLineIndent(begin));
+        if (m_text.compare(begin, end - begin, value) != 0)
+            m_text.replace(begin, end - begin, value);
+        return true;
+    }
+
+    if (path.empty() || path.back().isIndex)
+        return false;
+
+    // The member doesn't exist, so add it after the last member of the parent object
+    Path parent(path.begin(), path.end() - 1);
+    if (!FindValue(parent, begin, end) || m_text[begin] != '{')
+        return false;
+
+    size_t last_end = tt::npos;  // end of the last member's value, or its trailing comma
+    size_t last_key = tt::npos;
+    bool has_trailing_comma = false;
+    for (auto pos = SkipSpace(begin + 1); pos < end && m_text[pos] != '}';)
+    {
+        last_key = pos;
+        pos = SkipSpace(SkipSpace(SkipString(pos)) + 1);
+        last_end = SkipValue(pos);
+        has_trailing_comma = false;
+        pos = SkipSpace(last_end);
+        if (m_text[pos] == ',')
+        {
+            has_trailing_comma = true;
+            last_end = pos + 1;
+            pos = SkipSpace(pos + 1);
+        }
+    }
+
+    ttlib::cstr member;
+    if (last_key == tt::npos)
+    {
+        // Empty object
+        std::string indent(GetLineIndent(begin));
+        indent += m_indent_unit;
+        member << m_eol << indent << QuoteString(path.back().name) << ": ";
+        member += format_value(tt::npos, indent);
+        member << m_eol << GetLineIndent(begin);
+        m_text.insert(end - 1, member);
+    }
+    else
+    {
+        auto indent = GetLineIndent(last_key);
+        if (!has_trailing_comma)
+            member += ',';
+        member << m_eol << indent << QuoteString(path.back().name) << ": ";
+        member += format_value(tt::npos, indent);
+        m_text.insert(last_end, member);
+    }
+    return true;
+}
+
+bool CJsonPatch::SetStringArray(const Path& path, const std::vector<ttlib::cstr>& values)
+{
+    return SetValue(path,
+                    [&](size_t begin, std::string_view indent) -> std::string
+                    {
+                        std::string element_indent(indent);
+                        element_indent += m_indent_unit;
+
+                        if (begin != tt::npos)
+                        {
+                            // Leave the array exactly as it is if it already contains these values
+                            Path existing_path(path);
+                            std::vector<ttlib::cstr> existing;
+                            if (GetStringArray(existing_path, existing) && existing == values)
+                            {
+                                auto end = SkipValue(begin);
+                                return m_text.substr(begin, end - begin);
+                            }
+
+                            // Match the indentation of the current elements
+                            auto first = SkipSpace(begin + 1);
+                            if (m_text[begin] == '[' && m_text[first] != ']' &&
+                                m_text.find('\n', begin) < first)
+                            {
+                                element_indent = GetLineIndent(first);
+                            }
+                        }
+                        return FormatStringArray(values, indent, element_indent);
+                    });
+}
+
+bool CJsonPatch::SetString(const Path& path, std::string_view value)
+{
+    return SetValue(path,
+                    [&](size_t begin, std::string_view /* indent */) -> std::string
+                    {
+                        if (begin != tt::npos && m_text[begin] == '"' && ReadString(begin) == value)
+                        {
+                            // Don't change the way the original was escaped
+                            return m_text.substr(begin, SkipString(begin) - begin);
+                        }
+                        return QuoteString(value);
+                    });
+}
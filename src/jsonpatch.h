@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Edits individual values in a JSON file without changing anything else
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+// VS Code reparses (and IntelliSense re-indexes) a .json file whenever it is written, and users add their own keys and
+// comments to these files. Rather than building a document and writing it back out, this class locates the text span
+// of a single value and replaces just that span -- everything else in the file, including comments, formatting and
+// keys it knows nothing about, is left exactly as it was. Setting a value to what it already contains does nothing, so
+// GetText() can be compared to the original text to decide whether the file needs to be written at all.
+//
+// Comments and trailing commas are accepted since VS Code allows them in its settings files.
+class CJsonPatch
+{
+public:
+    // A path element is either the name of an object member or an index into an array.
+    struct Key
+    {
+        Key(const char* name) : name(name) {}
+        Key(std::string_view name) : name(name) {}
+        Key(size_t index) : index(index), isIndex(true) {}
+        Key(int index) : index(static_cast<size_t>(index)), isIndex(true) {}
+
+        std::string_view name;
+        size_t index { 0 };
+        bool isIndex { false };
+    };
+    using Path = std::vector<Key>;
+
+    // Returns false if text is not valid JSON.
+    bool Parse(std::string_view text);
+
+    const std::string& GetText() const { return m_text; }
+
+    // Returns the number of elements in the array at path, or 0 if path doesn't exist or isn't an array.
+    size_t GetArraySize(const Path& path) const;
+
+    // Returns false if path doesn't exist or isn't an array. Any element that isn't a string is ignored.
+    bool GetStringArray(const Path& path, std::vector<ttlib::cstr>& values) const;
+
+    // Returns false if path doesn't exist or isn't a string.
+    bool GetString(const Path& path, ttlib::cstr& value) const;
+
+    // If the last element of path doesn't exist, it is added to its parent object. Returns false if the parent doesn't
+    // exist or isn't an object.
+    bool SetStringArray(const Path& path, const std::vector<ttlib::cstr>& values);
+    bool SetString(const Path& path, std::string_view value);
+
+protected:
+    // All of the following return tt::npos if the text at pos is not valid JSON
+    size_t SkipSpace(size_t pos) const;
+    size_t SkipString(size_t pos) const;
+    size_t SkipValue(size_t pos, size_t depth = 0) const;
+
+    std::string ReadString(size_t pos) const;
+    static std::string QuoteString(std::string_view str);
+
+    // Sets begin and end to the span of the value. Returns false if path doesn't exist.
+    bool FindValue(const Path& path, size_t& begin, size_t& end) const;
+
+    // Replaces the value at path with value_text, or adds it as a new member of the parent object. format_value is
+    // called with the indentation of the line the member name is on.
+    template <typename T>
+    bool SetValue(const Path& path, T format_value);
+
+    // Returns the leading whitespace of the line that contains pos
+    std::string_view GetLineIndent(size_t pos) const;
+
+    std::string FormatStringArray(const std::vector<ttlib::cstr>& values, std::string_view indent,
+                                  std::string_view element_indent) const;
+
+private:
+    std::string m_text;
+    std::string m_eol { "\n" };
+    std::string m_indent_unit { "    " };
+};
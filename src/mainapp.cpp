@@ -43,10 +43,16 @@
 
 #include "convert.h"         // CConvert
 #include "funcs.h"           // List of function declarations
+#include "globindex.h"       // CGlobIndex -- Incremental index of the directories searched by wildcard patterns
+#include "indexer.h"         // CIndexer -- Creates a shareable symbol index for every source file in a project
 #include "ninja.h"           // CNinja
+#include "plan.h"            // CPlan -- Records every file ttBld would write without writing any of them
 #include "stackwalk.h"       // Walk the stack filtering out anything unrelated to current app
+#include "trace.h"           // CTrace -- Scoped timers and counters exported as a Chrome trace
 #include "uifuncs.h"         // Miscellaneous functions for displaying UI
+#include "watcher.h"         // CWatcher -- Keeps .ninja scripts up to date whenever a project input changes
 #include "writevcx.h"        // CVcxWrite -- Create a Visual Studio project file
+#include "xmlarena.h"        // CXmlArena -- Bump allocator for pugixml documents
 #include "wxWidgets_file.h"  // WidgetsFile -- Convert wxWidgets build/file to CMake file list
 
 #include "ui/optionsdlg.h"  // OptionsDlg -- Dialog for setting all .srcfile options
@@ -56,8 +62,10 @@
 #endif
 
 void AddFiles(const std::vector<ttlib::cstr>& lstFiles);
-int ConvertImageToHeader(std::vector<ttlib::cstr>& files);
-int MakeHgz(std::vector<ttlib::cstr>& files);
+int ConvertImageToHeader(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir);
+int ConvertImageToXpm(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir);
+int ConvertImageBatch(const ttlib::cstr& rsp_file, bool isXpm, const ttlib::cstr& cache_dir);
+int MakeHgz(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir, bool runtime);
 
 enum UPDATE_TYPE
 {
@@ -97,12 +105,50 @@ bool CMainApp::OnInit()
     ::wxHandleFatalExceptions(true);
 #endif
 
+    // This must be done before any pugixml document is created
+    CXmlArena::Install();
+
     // If we're just providing text-popups for help, then this is all we need.
     wxHelpProvider::Set(new wxSimpleHelpProvider);
 
     return true;
 }
 
+// Returns the name the command is listed under in a -trace file
+static const char* GetCommandName(ttlib::cmd& cmd)
+{
+    // The first option that selects a command wins, in the same order that OnRun() checks them
+    static const char* aCommands[] {
+        // clang-format off
+        "-hgz",
+        "-png",
+        "-widgets",
+        "-xpm",
+        "-codecmd",
+        "-msvcenv64",
+        "-msvcenv32",
+        "-cmake",
+        "-convert-tree",
+        "-sln",
+        "-vcxmake",
+        "-options",
+        "-vscode",
+        "-vcxbench",
+        "-vcxproj",
+        "-vs",
+        "-index",
+        "-watch",
+        // clang-format on
+    };
+
+    for (auto name: aCommands)
+    {
+        if (cmd.isOption(name + 1))
+            return name;
+    }
+    return "ninja";
+}
+
 int CMainApp::OnRun()
 {
     // wxWidgets can return argv as char** but it does so using ToAscii(), which in some cases will trash a UTF16
@@ -128,10 +174,35 @@ int CMainApp::OnRun()
 
     cmd.addOption("cmake", "Uses .srcfiles.yaml as a template to create a cmake CMakeLists.txt file");
     cmd.addOption("vcxmake", "Creates a CMakeLists.txt file based on a .vcxproj file");
+    cmd.addOption("convert-tree",
+                  "(directory) -- converts every project file in directory and its subdirectories to .srcfiles.yaml "
+                  "and CMakeLists.txt",
+                  ttlib::cmd::needsarg);
+    cmd.addOption("sln",
+                  "(file) -- converts every project in a Visual Studio solution and creates a CMakeLists.txt that "
+                  "builds all of them",
+                  ttlib::cmd::needsarg);
+    cmd.addOption("unity", "(size) -- generated CMakeLists.txt files use unity builds with size files per batch",
+                  ttlib::cmd::needsarg);
+    cmd.addOption("ccache", "generated CMakeLists.txt files use sccache or ccache if either is installed");
+    cmd.addOption("linker",
+                  "(name) -- generated CMakeLists.txt files use this linker (lld, mold, etc.) or \"auto\" to use mold "
+                  "or lld if installed",
+                  ttlib::cmd::needsarg);
+    cmd.addOption("index",
+                  "creates or updates shareable symbol index shards for every source file (use -cache dir to change "
+                  "the location)");
     cmd.addOption("vscode", "creates or updates .vscode/*.json files used to build and debug a project using VS Code");
     cmd.addOption("vcxproj", "creates or updates Visual Studio project file (.vcxproj)");
     cmd.addOption("vs", "adds or updates .vs/*.json files used by Visual Studio");
+    cmd.addOption("watch",
+                  "keeps running, updating the .ninja files whenever the project or one of its source directories "
+                  "changes");
     cmd.addOption("widgets", "[file] [dest] Converts wxWidgets build\\file into a dest.cmake file");
+    cmd.addOption("trace",
+                  "(file) -- writes a timeline of where ttBld spent its time to file (open it in chrome://tracing or "
+                  "ui.perfetto.dev)",
+                  ttlib::cmd::needsarg);
 
     // The following options are all hidden -- they will not be displayed in the -help command list
 
@@ -141,6 +212,12 @@ int CMainApp::OnRun()
     cmd.addHiddenOption("msvcenv32", ttlib::cmd::needsarg);
     cmd.addHiddenOption("dryrun");
 
+    // -dryrun -json (nothing is written -- every file that would be written is listed as JSON on stdout)
+    cmd.addHiddenOption("json");
+
+    // -vcxbench iterations (compares the streaming .vcxproj writer with building a pugixml document)
+    cmd.addHiddenOption("vcxbench", ttlib::cmd::needsarg);
+
     cmd.addHiddenOption("umsvc");
     cmd.addHiddenOption("umsvc_x86");
     cmd.addHiddenOption("uclang");
@@ -152,15 +229,37 @@ int CMainApp::OnRun()
 
     cmd.addHiddenOption("hgz");  // -hgz dst src (converts src into gzip, saves as char array header file)
 
+    // -hgz -runtime dst src (also writes ttbld_inflate.h and adds lazy decompression objects to the header)
+    cmd.addHiddenOption("runtime");
+
     cmd.addHiddenOption("xpm");  // -xpm src dst
     cmd.addHiddenOption("png");  // -png src dst
 
+    // -cache dir (used with -hgz, -xpm and -png to skip the conversion if the source hasn't changed, or with -index to
+    // specify the index directory relative to the project file)
+    cmd.addHiddenOption("cache", ttlib::cmd::needsarg);
+
+    // -png -batch file or -xpm -batch file (file contains all source images followed by all destination files)
+    cmd.addHiddenOption("batch", ttlib::cmd::needsarg);
+
 #if defined(TESTING) && !defined(NDEBUG)
     cmd.addHiddenOption("tvdlg", ttlib::cmd::needsarg);
 #endif
 
     cmd.parse();
 
+    if (cmd.isOption("dryrun") && cmd.isOption("json"))
+        CPlan::Get().Enable();
+
+    // -force overrides -dryrun unless the JSON plan was requested (see the ninja scripts below)
+    m_isDryRun = cmd.isOption("dryrun") && (!cmd.isOption("force") || CPlan::Get().IsEnabled());
+
+    if (cmd.isOption("trace"))
+        CTrace::Get().Enable(cmd.getOption("trace").value_or("ttBld.trace.json"));
+
+    // Everything the command does is nested under this in the trace
+    CTraceScope trace_command(GetCommandName(cmd));
+
     if (cmd.isHelpRequested())
     {
         std::cout << txtVersion << '\n' << txtCopyRight << "\n\n";
@@ -175,11 +274,14 @@ int CMainApp::OnRun()
 
     else if (cmd.isOption("hgz"))
     {
-        return MakeHgz(cmd.getExtras());
+        return MakeHgz(cmd.getExtras(), cmd.getOption("cache").value_or(ttlib::emptystring), cmd.isOption("runtime"));
     }
     else if (cmd.isOption("png"))
     {
-        return ConvertImageToHeader(cmd.getExtras());
+        if (cmd.isOption("batch"))
+            return ConvertImageBatch(cmd.getOption("batch").value_or(ttlib::emptystring), false,
+                                     cmd.getOption("cache").value_or(ttlib::emptystring));
+        return ConvertImageToHeader(cmd.getExtras(), cmd.getOption("cache").value_or(ttlib::emptystring));
     }
     else if (cmd.isOption("widgets"))
     {
@@ -188,33 +290,10 @@ int CMainApp::OnRun()
     }
     else if (cmd.isOption("xpm"))
     {
-        auto files = cmd.getExtras();
-        if (files.size() < 2)
-        {
-            std::cerr << "both src and dest files must be specified" << '\n';
-            return 1;
-        }
-
-        // Add all image handlers so that any type of image that wxWidgets supports can be converted.
-        wxInitAllImageHandlers();
-
-        wxImage image;
-        if (!image.LoadFile(files[0].wx_str()))
-        {
-            std::cerr << "Cannot load the image file " << files[0].wx_str() << '\n';
-            return 1;
-        }
-
-        if (image.HasAlpha())
-            image.ConvertAlphaToMask(wxIMAGE_ALPHA_THRESHOLD);
-
-        if (!image.SaveFile(files[1].wx_str(), wxBITMAP_TYPE_XPM))
-        {
-            std::cerr << "Cannot save the XPM file " << files[1].wx_str() << '\n';
-            return 1;
-        }
-
-        return 0;
+        if (cmd.isOption("batch"))
+            return ConvertImageBatch(cmd.getOption("batch").value_or(ttlib::emptystring), true,
+                                     cmd.getOption("cache").value_or(ttlib::emptystring));
+        return ConvertImageToXpm(cmd.getExtras(), cmd.getOption("cache").value_or(ttlib::emptystring));
     }
 
     UPDATE_TYPE upType = UPDATE_NORMAL;
@@ -323,6 +402,17 @@ int CMainApp::OnRun()
         return 0;
     }
 
+    CMakeSpeedOptions cmake_options;
+    if (cmd.isOption("unity"))
+    {
+        auto batch_size = ttlib::atoi(cmd.getOption("unity").value_or("0"));
+        if (batch_size > 0)
+            cmake_options.unity_batch_size = static_cast<size_t>(batch_size);
+    }
+    cmake_options.use_launcher = cmd.isOption("ccache");
+    if (cmd.isOption("linker"))
+        cmake_options.linker = cmd.getOption("linker").value_or(ttlib::emptystring);
+
     if (cmd.isOption("cmake"))
     {
         if (projectFile.empty())
@@ -330,13 +420,25 @@ int CMainApp::OnRun()
             projectFile.assign(locateProjectFile(RootDir));
         }
         CConvert convert;
+        convert.SetCMakeOptions(cmake_options);
         auto result = convert.CreateCmakeProject(projectFile);
         return (result == bld::RESULT::success ? 0 : 1);
     }
 
+    if (cmd.isOption("convert-tree"))
+    {
+        return ConvertProjectTree(cmd.getOption("convert-tree").value_or("."), cmake_options, m_isDryRun);
+    }
+
+    if (cmd.isOption("sln"))
+    {
+        return ConvertSolution(cmd.getOption("sln").value_or(ttlib::emptystring), cmake_options, m_isDryRun);
+    }
+
     if (cmd.isOption("vcxmake"))
     {
         CConvert convert;
+        convert.SetCMakeOptions(cmake_options);
         auto result = convert.ConvertToCmakeProject(projectFile);
         return (result == bld::RESULT::success ? 0 : 1);
     }
@@ -382,14 +484,20 @@ int CMainApp::OnRun()
 
     if (!projectCreated && cmd.isOption("vscode"))
     {
-        if (cmd.isOption("force"))
-            std::filesystem::remove(".vscode/c_cpp_properties.json");
-        // Create .vscode/ and any of the three .json files that are missing, and update c_cpp_properties.json
-        auto results = CreateVsCodeProject(projectFile);
+        // Create .vscode/ and any of the three .json files that are missing, and update c_cpp_properties.json (-force
+        // recreates it, but it still isn't written unless the contents change)
+        auto results = CreateVsCodeProject(projectFile, cmd.isOption("force"));
         for (auto& iter: results)
             std::cout << iter << '\n';
     }
 
+    if (cmd.isOption("vcxbench"))
+    {
+        auto iterations = ttlib::atoi(cmd.getOption("vcxbench").value_or("100"));
+        CVcxWrite vcx(projectFile);
+        return (vcx.Benchmark(iterations > 0 ? static_cast<size_t>(iterations) : 100) ? 0 : 1);
+    }
+
     if (cmd.isOption("vcxproj"))
     {
         CVcxWrite vcx(projectFile);
@@ -429,6 +537,22 @@ int CMainApp::OnRun()
         return 1;
     }
 
+    if (cmd.isOption("index"))
+    {
+        CIndexer indexer(cNinja);
+        if (cmd.isOption("force"))
+            indexer.ForceWrite();
+        if (m_isDryRun)
+            indexer.EnableDryRun();
+        return (indexer.Run(cmd.getOption("cache").value_or(ttlib::emptystring)) ? 0 : 1);
+    }
+
+    if (cmd.isOption("watch"))
+    {
+        CWatcher watcher(projectFile);
+        return watcher.Run();
+    }
+
     if (cmd.isOption("makefile"))
     {
         cNinja.CreateMakeFile(CNinja::MAKE_TYPE::normal);
@@ -436,36 +560,12 @@ int CMainApp::OnRun()
 
     cNinja.CreateMakeFile(CNinja::MAKE_TYPE::autogen);
 
-    if (cmd.isOption("force"))  // force write ignores any request for dryrun
+    if (cmd.isOption("force") && !CPlan::Get().IsEnabled())  // force write ignores any request for dryrun
         cNinja.ForceWrite();
     else if (cmd.isOption("dryrun"))
         cNinja.EnableDryRun();
 
-    int countNinjas = 0;
-#if defined(_WIN32)
-    if (cNinja.CreateBuildFile(CNinja::GEN_DEBUG, CNinja::CMPLR_MSVC))
-        countNinjas++;
-    if (cNinja.CreateBuildFile(CNinja::GEN_RELEASE, CNinja::CMPLR_MSVC))
-        countNinjas++;
-    if (cNinja.hasOptValue(OPT::TARGET_DIR32))
-    {
-        if (cNinja.CreateBuildFile(CNinja::GEN_DEBUG32, CNinja::CMPLR_MSVC))
-            countNinjas++;
-        if (cNinja.CreateBuildFile(CNinja::GEN_RELEASE32, CNinja::CMPLR_MSVC))
-            countNinjas++;
-    }
-#endif
-    if (cNinja.CreateBuildFile(CNinja::GEN_DEBUG, CNinja::CMPLR_CLANG))
-        countNinjas++;
-    if (cNinja.CreateBuildFile(CNinja::GEN_RELEASE, CNinja::CMPLR_CLANG))
-        countNinjas++;
-    if (cNinja.hasOptValue(OPT::TARGET_DIR32))
-    {
-        if (cNinja.CreateBuildFile(CNinja::GEN_DEBUG32, CNinja::CMPLR_CLANG))
-            countNinjas++;
-        if (cNinja.CreateBuildFile(CNinja::GEN_RELEASE32, CNinja::CMPLR_CLANG))
-            countNinjas++;
-    }
+    int countNinjas = cNinja.CreateAllBuildFiles();
 
     // Display any errors that occurred during processing
 
@@ -566,6 +666,13 @@ void MakeFileCaller(UPDATE_TYPE upType, const char* pszRootDir)
 
 int CMainApp::OnExit()
 {
+    CPlan::Get().Print();
+    CTrace::Get().Write();
+
+    // A dry run doesn't write anything, including the index
+    if (!m_isDryRun)
+        CGlobIndex::SaveAll();
+
     delete wxHelpProvider::Set(NULL);
 
     return wxApp::OnExit();
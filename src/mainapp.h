@@ -17,6 +17,9 @@ protected:
     virtual int OnRun() override;
     virtual void OnFatalException() override;
     virtual int OnExit() override;
+
+private:
+    bool m_isDryRun { false };  // -dryrun was specified (with or without -json), so nothing may be written
 };
 
 wxDECLARE_APP(CMainApp);
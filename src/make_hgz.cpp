@@ -5,10 +5,11 @@
 // License:   Apache License -- see ../LICENSE
 /////////////////////////////////////////////////////////////////////////////
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
-#include <sstream>
+#include <string_view>
 #include <vector>
 
 #include <wx/archive.h>   // Streams for archive formats
@@ -16,14 +17,61 @@
 #include <wx/mstream.h>   // Memory stream classes
 #include <wx/stream.h>    // stream classes
 #include <wx/wfstream.h>  // File stream classes
+#include <wx/zstream.h>   // zlib compression classes
 
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
 #include "pugixml/pugixml.hpp"
 
+#include "assetcache.h"  // CAssetCache
+#include "mappedfile.h"  // CMappedFile -- Private, copy-on-write memory mapping of a file
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+
+const char* res_ttbld_inflate =
+#include "res/ttbld_inflate.h"
+    ;
+
+// Name of the companion header written next to the output file when -runtime is specified
+inline constexpr const auto txtInflateHeader = "ttbld_inflate.h";
+
+struct RuntimeAsset
+{
+    ttlib::cstr array_name;
+    ttlib::cstr src_name;
+    size_t original_size;
+};
+
+// Writes the output of pugi::xml_document::save() directly to a wxOutputStream
+class XmlStreamWriter : public pugi::xml_writer
+{
+public:
+    XmlStreamWriter(wxOutputStream* stream) : m_stream(stream) {}
+
+    void write(const void* data, size_t size) override
+    {
+        m_stream->Write(data, size);
+        if (m_stream->LastWrite() != size)
+            m_isOk = false;
+        m_bytes_written += size;
+    }
+
+    bool IsOk() const { return m_isOk; }
+    size_t GetBytesWritten() const { return m_bytes_written; }
+
+private:
+    wxOutputStream* m_stream;
+    size_t m_bytes_written { 0 };
+    bool m_isOk { true };
+};
+
 static bool CopyStreamData(wxInputStream* inputStream, wxOutputStream* outputStream, size_t size);
+static ttlib::cstr MakeIdentifier(std::string_view name);
+static void AddRuntimeAssets(ttlib::textfile& file, const std::vector<RuntimeAsset>& assets, const ttlib::cstr& dst);
 
-int MakeHgz(std::vector<ttlib::cstr>& files)
+// If runtime is true, the generated header includes ttbld_inflate.h and adds a ttbld::lazy_asset for each array along
+// with a table of contents. The consuming app can then decompress an asset the first time it is needed without going
+// through wxWidgets streams.
+int MakeHgz(std::vector<ttlib::cstr>& files, const ttlib::cstr& cache_dir, bool runtime)
 {
     if (files.size() < 2)
     {
@@ -31,6 +79,35 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
         return 1;
     }
 
+    if (runtime)
+    {
+        ttlib::cstr inflate_header(files[0]);
+        inflate_header.remove_filename();
+        inflate_header.append_filename(txtInflateHeader);
+        std::string_view contents(res_ttbld_inflate);
+        if (!CPlan::Get().Add(inflate_header, contents, "asset decompressor header") &&
+            !WriteIfChanged(inflate_header, contents.data(), contents.size()))
+        {
+            std::cerr << "Unable to create or write to " << inflate_header << '\n';
+            return 1;
+        }
+    }
+
+    // If none of the source files have changed since the last conversion, then we can just copy the previous result
+    // without compressing anything.
+
+    CAssetCache cache(cache_dir);
+    std::vector<ttlib::cstr> sources(files.begin() + 1, files.end());
+    // The version suffix changes whenever the generated header changes so that older cached results aren't reused
+    if (cache.ComputeKey(runtime ? "gzip-runtime-2" : "gzip-2", wxZ_DEFAULT_COMPRESSION, sources, files[0]) &&
+        cache.Fetch(files[0]))
+        return 0;
+
+    // Everything in the generated header is static so that including two of them in the same source file can't
+    // result in two definitions of the same name.
+    const char* array_type = "static const unsigned char ";
+    std::vector<RuntimeAsset> assets;
+
     auto filterClassFactory = wxFilterClassFactory::Find(".gz", wxSTREAM_FILEEXT);
     if (!filterClassFactory)
     {
@@ -43,21 +120,21 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
 
     if (files[1].has_extension(".xml"))
     {
+        // The document's strings point into the mapping, so it must be declared first to outlive the document.
+        CMappedFile mapping;
         pugi::xml_document doc;
-        auto result = doc.load_file(files[1].c_str(), pugi::parse_default | pugi::parse_trim_pcdata);
+        auto result = LoadXmlInPlace(files[1], mapping, doc, pugi::parse_default | pugi::parse_trim_pcdata);
 
         if (result)
         {
-            std::stringstream strm;
-            doc.save(strm, "", pugi::format_raw);
-            // TODO: [KeyWorks - 05-10-2021] C++20 adds a view() method so that we don't have to make a copy of the string
-            auto string = strm.str();
-            wxMemoryInputStream inputFileStream(string.c_str(), string.size());
-
             wxMemoryOutputStream stream_out;
             wxScopedPtr<wxFilterOutputStream> filterOutputStream(filterClassFactory->NewStream(stream_out));
 
-            if (!CopyStreamData(&inputFileStream, filterOutputStream.get(), inputFileStream.GetLength()))
+            // pugixml hands the writer small chunks as it serializes the document, so the minified XML is never held
+            // in memory -- it goes straight into the compressor.
+            XmlStreamWriter writer(filterOutputStream.get());
+            doc.save(writer, "", pugi::format_raw);
+            if (!writer.IsOk())
             {
                 std::cerr << "An internal error has occurred: " << '\n';
                 return 1;
@@ -76,14 +153,21 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
                 str_name << ext;
             }
             str_name << "_gz";
+            str_name = MakeIdentifier(str_name);
 
             ttlib::textfile file;
 
             file.insertEmptyLine(0) << "// " << files[1].filename()
                                     << " -- comments and formatting removed, compressed with gizp";
+            if (runtime)
+            {
+                file.addEmptyLine();
+                file.addEmptyLine() << "#pragma once";
+                file.addEmptyLine();
+                file.addEmptyLine() << "#include \"" << txtInflateHeader << '"';
+            }
             file.addEmptyLine();
-            file.addEmptyLine() << "static const unsigned char " << str_name << '[' << strm_buffer->GetBufferSize()
-                                << "] = {";
+            file.addEmptyLine() << array_type << str_name << '[' << strm_buffer->GetBufferSize() << "] = {";
 
             auto buf = static_cast<unsigned char*>(strm_buffer->GetBufferStart());
 
@@ -106,7 +190,13 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
 
             file.addEmptyLine() << "};";
 
-            if (!file.WriteFile(files[0]))
+            if (runtime)
+            {
+                assets.push_back({ str_name, files[1].filename(), writer.GetBytesWritten() });
+                AddRuntimeAssets(file, assets, files[0]);
+            }
+
+            if (!cache.Commit(file, files[0]))
             {
                 std::cerr << "Unable to create or write to " << files[0];
                 return 1;
@@ -151,11 +241,12 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
             str_name << ext;
         }
         str_name << "_gz";
+        str_name = MakeIdentifier(str_name);
 
         file.insertEmptyLine(0) << "// " << str_name << "[] == " << files[file_pos];
 
         file.addEmptyLine();
-        file.addEmptyLine() << "static const unsigned char " << str_name << '[' << strm_buffer->GetBufferSize() << "] = {";
+        file.addEmptyLine() << array_type << str_name << '[' << strm_buffer->GetBufferSize() << "] = {";
 
         auto buf = static_cast<unsigned char*>(strm_buffer->GetBufferStart());
 
@@ -177,6 +268,12 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
             file[file.size() - 1].pop_back();
 
         file.addEmptyLine() << "};";
+
+        if (runtime)
+        {
+            auto original_size = static_cast<size_t>(inputFileStream.GetLength());
+            assets.push_back({ str_name, files[file_pos].filename(), original_size });
+        }
     }
 
     for (size_t pos_cmt = 0; pos_cmt < file.size(); ++pos_cmt)
@@ -185,11 +282,19 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
         {
             file.insertEmptyLine(pos_cmt++);
             file.insertEmptyLine(pos_cmt++) << "#pragma once";
+            if (runtime)
+            {
+                file.insertEmptyLine(pos_cmt++);
+                file.insertEmptyLine(pos_cmt++) << "#include \"" << txtInflateHeader << '"';
+            }
             break;
         }
     }
 
-    if (!file.WriteFile(files[0]))
+    if (runtime)
+        AddRuntimeAssets(file, assets, files[0]);
+
+    if (!cache.Commit(file, files[0]))
     {
         std::cerr << "Unable to create or write to " << files[0];
         return 1;
@@ -198,6 +303,65 @@ int MakeHgz(std::vector<ttlib::cstr>& files)
     return 0;
 }
 
+static void AddRuntimeAssets(ttlib::textfile& file, const std::vector<RuntimeAsset>& assets, const ttlib::cstr& dst)
+{
+    // The decompression buffers are zero-initialized, so they don't take up space in the executable, and the OS won't
+    // commit any memory for them until the asset is actually decompressed.
+
+    for (auto& iter: assets)
+    {
+        ttlib::cstr base_name(iter.array_name);
+        base_name.erase(base_name.size() - (sizeof("_gz") - 1));
+
+        file.addEmptyLine();
+        // A zero-length array isn't valid C++, so an empty source file still gets a one byte buffer
+        file.addEmptyLine() << "static unsigned char " << base_name << "_buf["
+                            << (iter.original_size ? iter.original_size : static_cast<size_t>(1)) << "];";
+        file.addEmptyLine() << "static ttbld::lazy_asset " << base_name << "_asset(" << iter.array_name << ", sizeof("
+                            << iter.array_name << "), " << base_name << "_buf, " << iter.original_size << ");";
+    }
+
+    ttlib::cstr toc_name = dst.filename();
+    toc_name.remove_extension();
+    toc_name << "_toc";
+    toc_name = MakeIdentifier(toc_name);
+
+    file.addEmptyLine();
+    file.addEmptyLine() << "static const ttbld::toc_entry " << toc_name << "[] = {";
+    for (auto& iter: assets)
+    {
+        ttlib::cstr base_name(iter.array_name);
+        base_name.erase(base_name.size() - (sizeof("_gz") - 1));
+        auto& line = file.addEmptyLine();
+        line << "    { \"";
+        for (auto ch: iter.src_name)
+        {
+            if (ch == '"' || ch == '\\')
+                line << '\\';
+            line << ch;
+        }
+        line << "\", &" << base_name << "_asset },";
+    }
+    file.addEmptyLine() << "};";
+}
+
+// Converts name into a valid C++ identifier: every character other than [A-Za-z0-9_] is replaced with '_', and a
+// leading digit is prefixed with '_'.
+static ttlib::cstr MakeIdentifier(std::string_view name)
+{
+    ttlib::cstr result;
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9'))
+        result += '_';
+    for (auto ch: name)
+    {
+        if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_')
+            result += ch;
+        else
+            result += '_';
+    }
+    return result;
+}
+
 static bool CopyStreamData(wxInputStream* inputStream, wxOutputStream* outputStream, size_t size)
 {
     size_t buf_size;
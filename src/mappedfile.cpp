@@ -0,0 +1,120 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Private, copy-on-write memory mapping of a file
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <filesystem>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "mappedfile.h"  // CMappedFile
+
+#if defined(_WIN32)
+
+bool CMappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    auto path = std::filesystem::u8path(filename);
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(hFile, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file, so the file handle isn't needed once the mapping is created.
+    m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(hFile);
+    if (!m_hMapping)
+        return false;
+
+    m_data = static_cast<char*>(MapViewOfFile(m_hMapping, FILE_MAP_COPY, 0, 0, 0));
+    if (!m_data)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+        return false;
+    }
+
+    m_size = static_cast<size_t>(file_size.QuadPart);
+    return true;
+}
+
+void CMappedFile::Close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_hMapping)
+        CloseHandle(m_hMapping);
+
+    m_data = nullptr;
+    m_hMapping = nullptr;
+    m_size = 0;
+}
+
+#else  // not _WIN32
+
+bool CMappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file, so the descriptor isn't needed once the mapping is created.
+    auto data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<char*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+
+    // The file is almost always read from start to finish exactly once
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+void CMappedFile::Close()
+{
+    if (m_data)
+        munmap(m_data, m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif  // _WIN32
+
+pugi::xml_parse_result LoadXmlInPlace(const std::string& filename, CMappedFile& mapping, pugi::xml_document& doc,
+                                      unsigned int options)
+{
+    if (!mapping.Open(filename))
+        return doc.load_file(std::filesystem::u8path(filename).c_str(), options);
+
+    return doc.load_buffer_inplace(mapping.data(), mapping.size(), options);
+}
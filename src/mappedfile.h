@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Private, copy-on-write memory mapping of a file
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "pugixml/pugixml.hpp"  // pugixml parser
+
+// Maps an entire file into memory. The mapping is private, so the contents can be modified (which is what pugixml's
+// in-place parser does) without changing the file, and only the pages that are actually modified get copied.
+class CMappedFile
+{
+public:
+    CMappedFile() = default;
+    ~CMappedFile() { Close(); }
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    // Returns false if the file cannot be opened or mapped. Empty files cannot be mapped.
+    bool Open(const std::string& filename);
+    void Close();
+
+    bool IsOpen() const { return m_data != nullptr; }
+
+    char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    char* m_data { nullptr };
+    size_t m_size { 0 };
+
+#if defined(_WIN32)
+    void* m_hMapping { nullptr };
+#endif  // _WIN32
+};
+
+// Parses filename directly from a private mapping of the file, so the file is neither read into a separate buffer nor
+// are its strings copied into the document. mapping must remain open for as long as doc is used. If the file cannot be
+// mapped, this falls back to doc.load_file().
+pugi::xml_parse_result LoadXmlInPlace(const std::string& filename, CMappedFile& mapping, pugi::xml_document& doc,
+                                      unsigned int options = pugi::parse_default);
@@ -7,15 +7,17 @@
 
 #include <cctype>
 #include <filesystem>
-
-#include <wx/arrstr.h>  // wxArrayString class
-#include <wx/dir.h>     // wxDir is a class for enumerating the files in a directory
+#include <map>
 
 #include "ttcwd.h"          // Class for storing and optionally restoring the current directory
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 
-#include "ninja.h"     // CNinja
-#include "verninja.h"  // CVerMakeNinja
+#include "assetcache.h"  // WriteIfChanged
+#include "globindex.h"   // CGlobIndex -- Incremental index of the directories searched by wildcard patterns
+#include "ninja.h"       // CNinja
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "trace.h"       // CTrace -- Scoped timers and counters exported as a Chrome trace
+#include "verninja.h"    // CVerMakeNinja
 
 const char* aCppExt[] { ".cpp", ".cxx", ".cc", nullptr };
 
@@ -70,6 +72,36 @@ CNinja::CNinja(std::string_view projectFile)
         ProcessBuildLibs32();
 }
 
+int CNinja::CreateAllBuildFiles()
+{
+    int countNinjas = 0;
+#if defined(_WIN32)
+    if (CreateBuildFile(GEN_DEBUG, CMPLR_MSVC))
+        countNinjas++;
+    if (CreateBuildFile(GEN_RELEASE, CMPLR_MSVC))
+        countNinjas++;
+    if (hasOptValue(OPT::TARGET_DIR32))
+    {
+        if (CreateBuildFile(GEN_DEBUG32, CMPLR_MSVC))
+            countNinjas++;
+        if (CreateBuildFile(GEN_RELEASE32, CMPLR_MSVC))
+            countNinjas++;
+    }
+#endif
+    if (CreateBuildFile(GEN_DEBUG, CMPLR_CLANG))
+        countNinjas++;
+    if (CreateBuildFile(GEN_RELEASE, CMPLR_CLANG))
+        countNinjas++;
+    if (hasOptValue(OPT::TARGET_DIR32))
+    {
+        if (CreateBuildFile(GEN_DEBUG32, CMPLR_CLANG))
+            countNinjas++;
+        if (CreateBuildFile(GEN_RELEASE32, CMPLR_CLANG))
+            countNinjas++;
+    }
+    return countNinjas;
+}
+
 static const char* aszCompilerPrefix[] {
     "msvc_",
     "clang_",
@@ -78,6 +110,8 @@ static const char* aszCompilerPrefix[] {
 
 bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
 {
+    TRACE_SCOPE("CNinja::CreateBuildFile");
+
     m_ninjafile.clear();
 
     m_gentype = gentype;
@@ -125,6 +159,7 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
             m_scriptFilename += "rel.ninja";
             break;
     }
+    m_outDir = outdir.subview(outdir.find('=') + 2);
 
     m_ninjafile.addEmptyLine();
     lastline() += "# WARNING: This file is auto-generated by ";
@@ -170,27 +205,44 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
         msvcWriteLinkDirective(cmplr);
     }
 
+    // The conversion rules use a content-hash cache in $builddir/cache, and only write the header if it actually changed.
+    // restat lets ninja skip rebuilding anything that depends on the header when the output was left untouched.
+
     if (m_gzip_files.size())
     {
         m_ninjafile.emplace_back("rule gzipHeader");
-        m_ninjafile.emplace_back("  command = ttBld -hgz $out $in");
+        m_ninjafile.emplace_back("  command = ttBld -hgz -cache $builddir/cache $out $in");
         m_ninjafile.emplace_back("  description = converting $in into $out");
+        m_ninjafile.emplace_back("  restat = 1");
         m_ninjafile.addEmptyLine();
     }
 
+    // The response files go in the cache directory and are named after the script so that variants can't overwrite each
+    // other. ninja only creates the directories of an edge's outputs, so the directory is created below when the script
+    // is written.
+    ttlib::cstr rsp_prefix("$builddir/cache/");
+    rsp_prefix << m_scriptFilename.filename();
+    rsp_prefix.remove_extension();
+
     if (m_xpm_files.size())
     {
         m_ninjafile.emplace_back("rule xpmConversion");
-        m_ninjafile.emplace_back("  command = ttBld -xpm $in $out");
-        m_ninjafile.emplace_back("  description = converting $in into $out");
+        m_ninjafile.emplace_back("  command = ttBld -xpm -cache $builddir/cache -batch $rspfile");
+        m_ninjafile.emplace_back(ttlib::cstr() << "  rspfile = " << rsp_prefix << "_xpm.rsp");
+        m_ninjafile.emplace_back("  rspfile_content = $in $out");
+        m_ninjafile.emplace_back("  description = converting images into XPM files");
+        m_ninjafile.emplace_back("  restat = 1");
         m_ninjafile.addEmptyLine();
     }
 
     if (m_png_files.size())
     {
         m_ninjafile.emplace_back("rule pngConversion");
-        m_ninjafile.emplace_back("  command = ttBld -png $in $out");
-        m_ninjafile.emplace_back("  description = converting $in into $out");
+        m_ninjafile.emplace_back("  command = ttBld -png -cache $builddir/cache -batch $rspfile");
+        m_ninjafile.emplace_back(ttlib::cstr() << "  rspfile = " << rsp_prefix << "_png.rsp");
+        m_ninjafile.emplace_back("  rspfile_content = $in $out");
+        m_ninjafile.emplace_back("  description = converting images into PNG headers");
+        m_ninjafile.emplace_back("  restat = 1");
         m_ninjafile.addEmptyLine();
     }
 
@@ -200,21 +252,14 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
         {
             if (iter.first.contains("*") || iter.first.contains("?"))
             {
-                wxDir dir;
-                wxArrayString files;
-                ttlib::cstr in_directory(iter.first);
-                in_directory.remove_filename();
-                if (in_directory.empty())
-                    in_directory = ".";
-                dir.GetAllFiles(in_directory.wx_str(), &files, iter.first.filename().wx_str(), wxDIR_FILES);
-
+                auto files = CGlobIndex::Get(GetBldDir())->Match(iter.first);
                 if (files.size())
                 {
                     auto& ninja_line = m_ninjafile.addEmptyLine();
                     ninja_line << "build " << iter.second << ": gzipHeader";
-                    for (size_t pos_file = 0; pos_file < files.size(); ++pos_file)
+                    for (auto& file: files)
                     {
-                        ninja_line << ' ' << files[pos_file].wx_str();
+                        ninja_line << ' ' << file;
                     }
                     ninja_line.backslashestoforward();
                 }
@@ -231,23 +276,14 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
         }
     }
 
+    // All of the images in a section are converted by a single ttBld process so that process startup and image handler
+    // initialization only happen once rather than once per image.
+
     if (m_xpm_files.size())
-    {
-        for (auto& iter: m_xpm_files)
-        {
-            m_ninjafile.addEmptyLine().Format("build %s: xpmConversion %s", iter.second.c_str(), iter.first.c_str());
-            m_ninjafile.addEmptyLine();
-        }
-    }
+        WriteImageBatch("xpmConversion", m_xpm_files);
 
     if (m_png_files.size())
-    {
-        for (auto& iter: m_png_files)
-        {
-            m_ninjafile.addEmptyLine().Format("build %s: pngConversion %s", iter.second.c_str(), iter.first.c_str());
-            m_ninjafile.addEmptyLine();
-        }
-    }
+        WriteImageBatch("pngConversion", m_png_files);
 
     // If the project has a .idl file, then the midl compiler will create a matching header file that will be included in one
     // or more source files. If the .idl file changes, or the header file doesn't exist yet, then we need to run the midl
@@ -389,6 +425,14 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
         msvcWriteMidlTargets(cmplr);
         msvcWriteLinkTargets(cmplr);
     }
+    CTrace::Count(TRACE_COUNTER::lines_emitted, static_cast<int64_t>(m_ninjafile.size()));
+
+    if (CPlan::Get().IsEnabled())
+    {
+        WriteCompileCommands();
+        CPlan::Get().Add(m_scriptFilename, m_ninjafile, "ninja build script");
+        return false;  // because we didn't write anything
+    }
 
     if (!GetBldDir().dir_exists())
     {
@@ -399,8 +443,25 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
         }
     }
 
+    WriteCompileCommands();
+
+    // The image outputs are in the source tree, so nothing in the script creates the directory for the response files.
+    // It's created whenever the script is written or confirmed to be up to date.
+    auto create_rsp_dir = [this]()
+    {
+        if (m_xpm_files.empty() && m_png_files.empty())
+            return true;
+        ttlib::cstr cache_dir(GetBldDir());
+        cache_dir.append_filename("cache");
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::u8path(cache_dir.c_str()), ec);
+        if (ec)
+            AddError("Unable to create " + cache_dir);
+        return !ec;
+    };
+
     if (m_isWriteIfNoChange)
-        return m_ninjafile.WriteFile(m_scriptFilename);
+        return create_rsp_dir() && m_ninjafile.WriteFile(m_scriptFilename);
 
     ttlib::viewfile fileOrg;
     if (fileOrg.ReadFile(m_scriptFilename))
@@ -414,10 +475,15 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
 
         if (fileOrg.is_sameas(m_ninjafile))
         {
+            // The cache directory could have been deleted since the script was written
+            create_rsp_dir();
             return false;  // nothing changed
         }
     }
 
+    if (!create_rsp_dir())
+        return false;
+
     if (!m_ninjafile.WriteFile(m_scriptFilename))
     {
         m_ninjafile.clear();
@@ -429,11 +495,216 @@ bool CNinja::CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr)
     return true;
 }
 
+// Expands $name, ${name} and the $$, "$ " and "$:" escapes the same way ninja does before it runs a command.
+static ttlib::cstr ExpandNinjaVars(std::string_view str, const std::map<std::string, std::string, std::less<>>& vars)
+{
+    ttlib::cstr result;
+    for (size_t pos = 0; pos < str.size(); ++pos)
+    {
+        if (str[pos] != '$' || pos + 1 >= str.size())
+        {
+            result += str[pos];
+            continue;
+        }
+
+        ++pos;
+        if (str[pos] == '$' || str[pos] == ' ' || str[pos] == ':')
+        {
+            result += str[pos];
+            continue;
+        }
+
+        size_t end;
+        std::string_view name;
+        if (str[pos] == '{')
+        {
+            end = str.find('}', pos);
+            if (end == std::string_view::npos)
+                end = str.size();
+            name = str.substr(pos + 1, end - pos - 1);
+        }
+        else
+        {
+            for (end = pos; end < str.size(); ++end)
+            {
+                auto ch = str[end];
+                if (!ttlib::is_alpha(ch) && !ttlib::is_digit(ch) && ch != '_' && ch != '-')
+                    break;
+            }
+            name = str.substr(pos, end - pos);
+            --end;
+        }
+
+        // Unknown variables expand to nothing, just as they do in ninja
+        if (auto found = vars.find(name); found != vars.end())
+            result += found->second;
+        pos = end;
+    }
+    return result;
+}
+
+// Returns the position of the first unescaped ':' in a build statement, or npos
+static size_t FindBuildColon(std::string_view line)
+{
+    for (size_t pos = 0; pos < line.size(); ++pos)
+    {
+        if (line[pos] == '$')
+            ++pos;
+        else if (line[pos] == ':')
+            return pos;
+    }
+    return std::string_view::npos;
+}
+
+void CNinja::WriteCompileCommands()
+{
+    // Just like "ninja -t compdb", the entries are read back from the script that was just generated: every build
+    // statement using the compile or compilePCH rule becomes an entry. That way every compiler's rules are handled the
+    // same way, and the commands are always exactly what ninja will run.
+
+    std::map<std::string, std::string, std::less<>> vars;      // top-level variables, already expanded
+    std::map<std::string, std::string, std::less<>> commands;  // rule name -> unexpanded command
+
+    struct BuildStatement
+    {
+        std::string rule;
+        std::string out;
+        std::string in;
+    };
+    std::vector<BuildStatement> statements;
+
+    std::string_view cur_rule;
+    for (auto& line: m_ninjafile)
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (line[0] == ' ')
+        {
+            // Only a rule's command matters -- the other indented lines are rule or build statement bindings, or the
+            // continuation of a build statement's implicit dependencies.
+            if (cur_rule.size() && ttlib::is_sameprefix(ttlib::find_nonspace(line), "command = "))
+                commands[std::string(cur_rule)] = ttlib::find_nonspace(line).substr(sizeof("command = ") - 1);
+            continue;
+        }
+        cur_rule = {};
+
+        std::string_view view(line);
+        if (ttlib::is_sameprefix(view, "rule "))
+        {
+            cur_rule = view.substr(sizeof("rule ") - 1);
+            if (cur_rule != "compile" && cur_rule != "compilePCH")
+                cur_rule = {};
+        }
+        else if (ttlib::is_sameprefix(view, "build "))
+        {
+            auto colon = FindBuildColon(view);
+            if (colon == std::string_view::npos)
+                continue;
+
+            BuildStatement statement;
+            statement.out = view.substr(sizeof("build ") - 1, colon - (sizeof("build ") - 1));
+
+            auto inputs = ttlib::find_nonspace(view.substr(colon + 1));
+            auto space = inputs.find(' ');
+            statement.rule = inputs.substr(0, space);
+            if (statement.rule != "compile" && statement.rule != "compilePCH")
+                continue;
+
+            // Anything after '|' is an implicit or order-only dependency rather than an input
+            inputs = (space == std::string_view::npos) ? std::string_view() :
+                                                         ttlib::find_nonspace(inputs.substr(space));
+            statement.in = inputs.substr(0, inputs.find(" |"));
+            while (statement.in.size() && (statement.in.back() == ' ' || statement.in.back() == '$'))
+                statement.in.pop_back();
+            statements.emplace_back(std::move(statement));
+        }
+        else if (auto equal = view.find(" = "); equal != std::string_view::npos && !ttlib::is_sameprefix(view, "pool "))
+        {
+            // Top-level variables are expanded when they are defined
+            auto value = ExpandNinjaVars(view.substr(equal + 3), vars);
+            vars[std::string(view.substr(0, equal))] = std::move(value);
+        }
+    }
+
+    if (statements.empty())
+        return;
+
+    std::error_code ec;
+    auto directory = std::filesystem::current_path(ec).generic_u8string();
+
+    ttlib::cstr json("[");
+    bool first_entry = true;
+    for (auto& iter: statements)
+    {
+        auto command = commands.find(iter.rule);
+        if (command == commands.end())
+            continue;
+
+        auto build_vars = vars;
+        build_vars["in"] = ExpandNinjaVars(iter.in, vars);
+        build_vars["out"] = ExpandNinjaVars(iter.out, vars);
+
+        json += (first_entry ? "\n" : ",\n");
+        first_entry = false;
+
+        json += "  {\n    \"directory\": ";
+        AppendJsonString(json, directory);
+        json += ",\n    \"command\": ";
+        AppendJsonString(json, ExpandNinjaVars(command->second, build_vars));
+        json += ",\n    \"file\": ";
+        AppendJsonString(json, build_vars["in"]);
+        json += ",\n    \"output\": ";
+        AppendJsonString(json, build_vars["out"]);
+        json += "\n  }";
+    }
+    json += "\n]\n";
+
+    auto json_path = std::filesystem::u8path(m_outDir.c_str()) / "compile_commands.json";
+    if (CPlan::Get().Add(json_path.generic_u8string(), json, "compilation database"))
+        return;
+
+    if (m_dryrun.IsEnabled())
+        return;
+
+    // WriteIfChanged() leaves an unchanged file alone, so clangd doesn't re-index the project
+    std::filesystem::create_directories(json_path.parent_path(), ec);
+    if (!WriteIfChanged(json_path.generic_u8string(), json.data(), json.size()))
+        AddError("Unable to create or write to " + json_path.generic_u8string());
+}
+
+void CNinja::WriteImageBatch(std::string_view rule, const std::map<ttlib::cstr, ttlib::cstr>& files)
+{
+    // The outputs are listed first, then the inputs -- each on its own line using ninja's $ line continuation.
+
+    m_ninjafile.addEmptyLine() << "build $";
+    size_t count = 0;
+    for (auto& iter: files)
+    {
+        if (++count < files.size())
+            m_ninjafile.addEmptyLine() << "    " << iter.second << " $";
+        else
+            m_ninjafile.addEmptyLine() << "    " << iter.second << ": " << rule << " $";
+    }
+
+    count = 0;
+    for (auto& iter: files)
+    {
+        auto& line = m_ninjafile.addEmptyLine();
+        line << "    " << iter.first;
+        if (++count < files.size())
+            line << " $";
+    }
+    m_ninjafile.addEmptyLine();
+}
+
 void CNinja::ProcessBuildLibs()
 {
     if (!hasOptValue(OPT::BUILD_LIBS))
         return;
 
+    TRACE_SCOPE("CNinja::ProcessBuildLibs");
+
     ttlib::multistr enumLib(ttlib::find_nonspace(getOptValue(OPT::BUILD_LIBS)), ';');
     for (auto& libPath: enumLib)
     {
@@ -525,6 +796,7 @@ void CNinja::ProcessBuildLibs()
             AddError("Cannot read .srcfiles.yaml in " + BuildFile);
             continue;
         }
+        AddInputs(cSrcFiles);
 
         if (cSrcFiles.getErrorMsgs().size())
         {
@@ -570,6 +842,8 @@ void CNinja::ProcessBuildLibs32()
     if (!hasOptValue(OPT::BUILD_LIBS32))
         return;
 
+    TRACE_SCOPE("CNinja::ProcessBuildLibs32");
+
     ttlib::multistr enumLib(ttlib::find_nonspace(getOptValue(OPT::BUILD_LIBS32)), ';');
     for (auto& libPath: enumLib)
     {
@@ -661,6 +935,7 @@ void CNinja::ProcessBuildLibs32()
             AddError("Cannot read .srcfiles.yaml in " + BuildFile);
             continue;
         }
+        AddInputs(cSrcFiles);
 
         if (cSrcFiles.getErrorMsgs().size())
         {
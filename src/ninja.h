@@ -48,11 +48,15 @@ public:
 
     // Warning: this will first clear m_ninjafile.
     bool CreateBuildFile(GEN_TYPE gentype, CMPLR_TYPE cmplr);
+
+    // Creates every .ninja script the project needs. Returns the number of scripts that were written.
+    int CreateAllBuildFiles();
     bool CreateMakeFile(MAKE_TYPE type = MAKE_TYPE::normal);
 
     size_t getSrcCount() { return m_lstSrcFiles.size(); }
 
     const ttlib::cstr& GetRcFile() { return m_RCname; }
+    const std::vector<ttlib::cstr>& GetRcDependencies() const { return m_RcDependencies; }
     std::string_view GetScriptFile() { return m_scriptFilename; }
 
     // Returns false if .srcfiles.yaml requires a newer version
@@ -83,6 +87,14 @@ protected:
 
     bool FindRcDependencies(std::string_view rcfile, std::string_view header = {});
 
+    // Writes a single build statement that converts every image in files using the specified rule
+    void WriteImageBatch(std::string_view rule, const std::map<ttlib::cstr, ttlib::cstr>& files);
+
+    // Writes $outdir/compile_commands.json with the exact command ninja will run for every source file. Each variant
+    // gets its own directory because clangd only looks for a file with that exact name. The file is only written if a
+    // command changed so that clangd doesn't re-index the entire project.
+    void WriteCompileCommands();
+
     // Retrieve a reference to the last line in the current ninja script file.
     ttlib::cstr& lastline() noexcept { return m_ninjafile.back(); }
 
@@ -101,6 +113,8 @@ private:
 
     ttlib::cstr m_scriptFilename;  // The .ninja file
 
+    ttlib::cstr m_outDir;  // expanded value of $outdir -- compile_commands.json is written here
+
     std::vector<ttlib::cstr> m_RcDependencies;
 
     struct BLD_LIB
@@ -0,0 +1,202 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Records every file ttBld would write without writing any of them
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <filesystem>
+
+#include "plan.h"
+
+#include "assetcache.h"  // HashFnv1a, ReadFileBytes
+
+// Changing the JSON layout in an incompatible way MUST change this number
+static constexpr int PLAN_FORMAT = 1;
+
+static int64_t CountLines(std::string_view str)
+{
+    auto count = static_cast<int64_t>(std::count(str.begin(), str.end(), '\n'));
+    if (str.size() && str.back() != '\n')
+        ++count;
+    return count;
+}
+
+CPlan& CPlan::Get()
+{
+    static CPlan plan;
+    return plan;
+}
+
+void CPlan::Enable()
+{
+    if (m_isEnabled)
+        return;
+    m_isEnabled = true;
+    m_cout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+}
+
+bool CPlan::Add(const ttlib::cstr& filename, std::string_view contents, std::string_view reason)
+{
+    if (!m_isEnabled)
+        return false;
+
+    Entry entry;
+    std::error_code ec;
+    auto path = std::filesystem::absolute(std::filesystem::u8path(filename.c_str()), ec);
+    entry.path = ec ? filename : ttlib::cstr(path.lexically_normal().u8string());
+    entry.path.backslashestoforward();
+    entry.reason = reason;
+
+    std::string current;
+    entry.exists = ReadFileBytes(filename, current);
+    entry.old_hash = entry.exists ? HashFnv1a(current) : 0;
+    entry.new_hash = HashFnv1a(contents);
+    entry.byte_delta = static_cast<int64_t>(contents.size()) - static_cast<int64_t>(current.size());
+    entry.line_delta = CountLines(contents) - CountLines(current);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The same file can be generated more than once (e.g., the makefile), in which case only the last one counts
+    auto iter = std::find_if(m_entries.begin(), m_entries.end(),
+                             [&](const Entry& existing) { return existing.path.is_sameas(entry.path); });
+    if (iter != m_entries.end())
+        *iter = std::move(entry);
+    else
+        m_entries.emplace_back(std::move(entry));
+    return true;
+}
+
+bool CPlan::Add(const ttlib::cstr& filename, const ttlib::textfile& file, std::string_view reason)
+{
+    if (!m_isEnabled)
+        return false;
+
+    std::string contents;
+    for (auto& iter: file)
+    {
+        contents += iter;
+        contents += '\n';
+    }
+    return Add(filename, contents, reason);
+}
+
+bool CPlan::AddDirectory(const ttlib::cstr& dir, std::string_view reason)
+{
+    if (!m_isEnabled)
+        return false;
+
+    std::error_code ec;
+    auto path = std::filesystem::absolute(std::filesystem::u8path(dir.c_str()), ec).lexically_normal();
+    std::error_code ec_dir;
+    if (!ec && std::filesystem::is_directory(path, ec_dir))
+        return true;
+    if (!path.has_filename())  // trailing slash
+        path = path.parent_path();
+    ttlib::cstr normalized = ec ? dir : ttlib::cstr(path.u8string());
+    normalized.backslashestoforward();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (std::none_of(m_directories.begin(), m_directories.end(),
+                     [&](const auto& existing) { return existing.first.is_sameas(normalized); }))
+    {
+        m_directories.emplace_back(normalized, reason);
+    }
+    return true;
+}
+
+bool CPlan::HasChanges() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_directories.size())
+        return true;
+    return std::any_of(m_entries.begin(), m_entries.end(),
+                       [](const Entry& entry) { return !entry.exists || entry.old_hash != entry.new_hash; });
+}
+
+ttlib::cstr CPlan::GetJson() const
+{
+    auto hasChanges = HasChanges();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ttlib::cstr json;
+    json << "{\n  \"format\": " << std::to_string(PLAN_FORMAT) << ",\n  \"changed\": "
+         << (hasChanges ? "true" : "false") << ",\n  \"files\": [";
+
+    bool isFirst = true;
+    for (auto& entry: m_entries)
+    {
+        json << (isFirst ? "\n" : ",\n") << "    {\n      \"path\": ";
+        isFirst = false;
+        AppendJsonString(json, entry.path);
+
+        const char* action = !entry.exists ? "create" : (entry.old_hash != entry.new_hash ? "update" : "unchanged");
+        json << ",\n      \"action\": \"" << action << "\",\n      \"reason\": ";
+        AppendJsonString(json, entry.reason);
+
+        ttlib::cstr hash;
+        json << ",\n      \"old_hash\": ";
+        if (entry.exists)
+            json << '"' << hash.Format("%016llx", static_cast<unsigned long long>(entry.old_hash)) << '"';
+        else
+            json << "null";
+        json << ",\n      \"new_hash\": \"" << hash.Format("%016llx", static_cast<unsigned long long>(entry.new_hash))
+             << '"';
+
+        json << ",\n      \"byte_delta\": " << std::to_string(entry.byte_delta)
+             << ",\n      \"line_delta\": " << std::to_string(entry.line_delta) << "\n    }";
+    }
+    json << (m_entries.empty() ? "]" : "\n  ]") << ",\n  \"directories\": [";
+
+    isFirst = true;
+    for (auto& [path, reason]: m_directories)
+    {
+        json << (isFirst ? "\n" : ",\n") << "    {\n      \"path\": ";
+        isFirst = false;
+        AppendJsonString(json, path);
+        json << ",\n      \"reason\": ";
+        AppendJsonString(json, reason);
+        json << "\n    }";
+    }
+    json << (m_directories.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    return json;
+}
+
+void CPlan::Print()
+{
+    if (!m_isEnabled)
+        return;
+
+    if (m_cout_buf)
+    {
+        std::cout.flush();
+        std::cout.rdbuf(m_cout_buf);
+        m_cout_buf = nullptr;
+    }
+    std::cout << GetJson();
+    std::cout.flush();
+}
+
+void AppendJsonString(ttlib::cstr& json, std::string_view str)
+{
+    json += '"';
+    for (auto ch: str)
+    {
+        if (ch == '"' || ch == '\\')
+        {
+            json += '\\';
+            json += ch;
+        }
+        else if (static_cast<unsigned char>(ch) < 32)
+        {
+            json += (ch == '\t' ? "\\t" : " ");
+        }
+        else
+        {
+            json += ch;
+        }
+    }
+    json += '"';
+}
@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Records every file ttBld would write without writing any of them
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tttextfile_wx.h"  // textfile -- Classes for reading and writing line-oriented files
+
+// Enabled with -dryrun -json. Every project, script or asset writer calls Add() before writing a file, and if it
+// returns true, the file is only recorded and nothing is written. When ttBld exits, the plan is printed as JSON listing
+// each file's path, the hash of its current and new contents, how many bytes and lines it would change by, and why it
+// is written -- so a single call can decide whether regenerating would change anything. Output directories that would
+// have to be created are listed separately.
+//
+// ttBld's own bookkeeping files (the tool cache, glob.index, the asset cache, the -trace file and the watcher's control
+// files) are not part of the plan since they never affect a build. Neither are the files written by the interactive
+// dialogs, which can't be used during a dry run.
+//
+// While the plan is enabled, everything else ttBld would normally display is sent to stderr so that stdout only
+// contains the JSON.
+class CPlan
+{
+public:
+    static CPlan& Get();
+
+    void Enable();
+    bool IsEnabled() const { return m_isEnabled; }
+
+    // If the plan is enabled, records what writing contents to filename would change and returns true -- the caller
+    // must not write the file. Returns false if the plan is not enabled. reason describes the file, e.g. "ninja
+    // build script".
+    bool Add(const ttlib::cstr& filename, std::string_view contents, std::string_view reason);
+    bool Add(const ttlib::cstr& filename, const ttlib::textfile& file, std::string_view reason);
+
+    // If the plan is enabled, records dir if it doesn't exist yet and returns true -- the caller must not create it.
+    // Returns false if the plan is not enabled.
+    bool AddDirectory(const ttlib::cstr& dir, std::string_view reason);
+
+    // Returns true if any file would be created or changed
+    bool HasChanges() const;
+
+    ttlib::cstr GetJson() const;
+
+    // Restores stdout and prints the JSON plan to it
+    void Print();
+
+protected:
+    CPlan() {}
+
+    struct Entry
+    {
+        ttlib::cstr path;
+        ttlib::cstr reason;
+        bool exists;
+        uint64_t old_hash;
+        uint64_t new_hash;
+        int64_t byte_delta;
+        int64_t line_delta;
+    };
+
+private:
+    std::vector<Entry> m_entries;
+    std::vector<std::pair<ttlib::cstr, ttlib::cstr>> m_directories;  // path, reason
+    std::streambuf* m_cout_buf { nullptr };
+
+    mutable std::mutex m_mutex;
+    bool m_isEnabled { false };
+};
+
+// Appends str to json as a quoted JSON string. Control characters other than tab are replaced with spaces -- none of
+// the strings ttBld writes (paths, command lines, descriptions) should contain them.
+void AppendJsonString(ttlib::cstr& json, std::string_view str);
@@ -11,6 +11,7 @@
 #include <tttextfile_wx.h>  // Classes for reading and writing line-oriented files
 
 #include "ninja.h"  // CNinja
+#include "trace.h"  // CTrace -- Scoped timers and counters exported as a Chrome trace
 
 // clang-format off
 
@@ -49,6 +50,8 @@ static const char* aRemovals[]
 // dependency.
 bool CNinja::FindRcDependencies(std::string_view rcfile, std::string_view header)
 {
+    TRACE_SCOPE("CNinja::FindRcDependencies");
+
     // Save the current working directory and restore it when we're done
     ttlib::cwd SavedCWD(true);
 
@@ -79,6 +82,11 @@ bool CNinja::FindRcDependencies(std::string_view rcfile, std::string_view header
         AddError("An exception occurred while reading " + inFilename + ": " + e.what());
         return false;
     }
+    if (CTrace::IsEnabled())
+    {
+        for (auto& line: file)
+            CTrace::Count(TRACE_COUNTER::bytes_read, static_cast<int64_t>(line.size() + 1));
+    }
 
     for (auto line: file)
     {
@@ -110,6 +118,7 @@ bool CNinja::FindRcDependencies(std::string_view rcfile, std::string_view header
                 incName.make_relative(root);
                 incName.backslashestoforward();
 
+                CTrace::Count(TRACE_COUNTER::files_stat);
                 if (!incName.file_exists())
                 {
                     // We can't really report this as an error unless we first check the INCLUDE environment variable as well
@@ -169,6 +178,7 @@ bool CNinja::FindRcDependencies(std::string_view rcfile, std::string_view header
                     {
                         ttlib::cstr parseName;
                         parseName.ExtractSubString(filename);
+                        CTrace::Count(TRACE_COUNTER::files_stat);
                         if (!parseName.empty() && parseName.file_exists())
                         {
                             ttlib::cstr root { inFilename };
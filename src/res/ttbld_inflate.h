@@ -0,0 +1,454 @@
+R"===(/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Lazy, allocation-free decompression of arrays created by ttBld -hgz -runtime
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License -- see https://github.com/KeyWorksRW/ttBld/blob/main/LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+// WARNING: This file is auto-generated by ttBld. Changes you make will be lost if it is auto-generated again!
+
+// Requires C++17 or later. Nothing in this file allocates memory -- all decompression is done directly into a
+// buffer supplied by the caller (the generated headers supply a zero-initialized buffer for each asset which costs
+// nothing until the asset is actually decompressed).
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+namespace ttbld
+{
+    namespace inflate_detail
+    {
+        struct state
+        {
+            const unsigned char* in;
+            size_t in_size;
+            size_t in_pos;
+
+            unsigned char* out;
+            size_t out_size;
+            size_t out_pos;
+
+            uint32_t bitbuf;
+            int bitcnt;
+            bool error;
+        };
+
+        // Canonical Huffman table: the number of codes of each length, followed by the symbols sorted by code
+        struct huffman
+        {
+            short count[16];
+            short symbol[288];
+        };
+
+        inline int bits(state& s, int need)
+        {
+            uint32_t val = s.bitbuf;
+            while (s.bitcnt < need)
+            {
+                if (s.in_pos >= s.in_size)
+                {
+                    s.error = true;
+                    return 0;
+                }
+                val |= static_cast<uint32_t>(s.in[s.in_pos++]) << s.bitcnt;
+                s.bitcnt += 8;
+            }
+            s.bitbuf = val >> need;
+            s.bitcnt -= need;
+            return static_cast<int>(val & ((1u << need) - 1));
+        }
+
+        inline bool stored(state& s)
+        {
+            // Stored blocks start on a byte boundary
+            s.bitbuf = 0;
+            s.bitcnt = 0;
+
+            if (s.in_pos + 4 > s.in_size)
+                return false;
+            unsigned len = s.in[s.in_pos] | (s.in[s.in_pos + 1] << 8);
+            unsigned nlen = s.in[s.in_pos + 2] | (s.in[s.in_pos + 3] << 8);
+            s.in_pos += 4;
+            if (len != (~nlen & 0xffff))
+                return false;
+            if (s.in_pos + len > s.in_size || s.out_pos + len > s.out_size)
+                return false;
+
+            std::memcpy(s.out + s.out_pos, s.in + s.in_pos, len);
+            s.in_pos += len;
+            s.out_pos += len;
+            return true;
+        }
+
+        inline int decode(state& s, const huffman& h)
+        {
+            int code = 0;
+            int first = 0;
+            int index = 0;
+            for (int len = 1; len < 16; ++len)
+            {
+                code |= bits(s, 1);
+                if (s.error)
+                    return -1;
+                int count = h.count[len];
+                if (code - count < first)
+                    return h.symbol[index + (code - first)];
+                index += count;
+                first += count;
+                first <<= 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+
+        // Returns 0 for a complete code, a positive value for an incomplete code, and a negative value for an
+        // over-subscribed code.
+        inline int construct(huffman& h, const short* length, int n)
+        {
+            for (int len = 0; len < 16; ++len)
+                h.count[len] = 0;
+            for (int sym = 0; sym < n; ++sym)
+                h.count[length[sym]]++;
+            if (h.count[0] == n)
+                return 0;
+
+            int left = 1;
+            for (int len = 1; len < 16; ++len)
+            {
+                left <<= 1;
+                left -= h.count[len];
+                if (left < 0)
+                    return left;
+            }
+
+            short offs[16];
+            offs[1] = 0;
+            for (int len = 1; len < 15; ++len)
+                offs[len + 1] = offs[len] + h.count[len];
+            for (int sym = 0; sym < n; ++sym)
+            {
+                if (length[sym] != 0)
+                    h.symbol[offs[length[sym]]++] = static_cast<short>(sym);
+            }
+            return left;
+        }
+
+        inline bool codes(state& s, const huffman& lencode, const huffman& distcode)
+        {
+            static constexpr short lbase[29] = { 3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static constexpr short lext[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static constexpr short dbase[30] = { 1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+                                                 33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+                                                 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            static constexpr short dext[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            for (;;)
+            {
+                int symbol = decode(s, lencode);
+                if (symbol < 0)
+                    return false;
+                if (symbol < 256)
+                {
+                    if (s.out_pos >= s.out_size)
+                        return false;
+                    s.out[s.out_pos++] = static_cast<unsigned char>(symbol);
+                }
+                else if (symbol == 256)
+                {
+                    return true;
+                }
+                else
+                {
+                    symbol -= 257;
+                    if (symbol >= 29)
+                        return false;
+                    size_t len = lbase[symbol] + bits(s, lext[symbol]);
+
+                    symbol = decode(s, distcode);
+                    if (symbol < 0 || symbol >= 30)
+                        return false;
+                    size_t dist = dbase[symbol] + bits(s, dext[symbol]);
+                    if (s.error || dist > s.out_pos || s.out_pos + len > s.out_size)
+                        return false;
+
+                    // The source and destination can overlap, so this must be copied one byte at a time
+                    for (; len > 0; --len, ++s.out_pos)
+                        s.out[s.out_pos] = s.out[s.out_pos - dist];
+                }
+            }
+        }
+
+        inline bool fixed(state& s)
+        {
+            huffman lencode;
+            huffman distcode;
+            short lengths[288];
+
+            int symbol = 0;
+            for (; symbol < 144; ++symbol)
+                lengths[symbol] = 8;
+            for (; symbol < 256; ++symbol)
+                lengths[symbol] = 9;
+            for (; symbol < 280; ++symbol)
+                lengths[symbol] = 7;
+            for (; symbol < 288; ++symbol)
+                lengths[symbol] = 8;
+            construct(lencode, lengths, 288);
+
+            for (symbol = 0; symbol < 30; ++symbol)
+                lengths[symbol] = 5;
+            construct(distcode, lengths, 30);
+
+            return codes(s, lencode, distcode);
+        }
+
+        inline bool dynamic(state& s)
+        {
+            static constexpr short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+            int nlen = bits(s, 5) + 257;
+            int ndist = bits(s, 5) + 1;
+            int ncode = bits(s, 4) + 4;
+            if (s.error || nlen > 286 || ndist > 30)
+                return false;
+
+            short lengths[286 + 30];
+            int index = 0;
+            for (; index < ncode; ++index)
+                lengths[order[index]] = static_cast<short>(bits(s, 3));
+            for (; index < 19; ++index)
+                lengths[order[index]] = 0;
+
+            huffman lencode;
+            huffman distcode;
+            if (construct(lencode, lengths, 19) != 0)
+                return false;
+
+            index = 0;
+            while (index < nlen + ndist)
+            {
+                int symbol = decode(s, lencode);
+                if (symbol < 0)
+                    return false;
+                if (symbol < 16)
+                {
+                    lengths[index++] = static_cast<short>(symbol);
+                }
+                else
+                {
+                    short len = 0;
+                    if (symbol == 16)
+                    {
+                        if (index == 0)
+                            return false;
+                        len = lengths[index - 1];
+                        symbol = 3 + bits(s, 2);
+                    }
+                    else if (symbol == 17)
+                    {
+                        symbol = 3 + bits(s, 3);
+                    }
+                    else
+                    {
+                        symbol = 11 + bits(s, 7);
+                    }
+                    if (s.error || index + symbol > nlen + ndist)
+                        return false;
+                    while (symbol--)
+                        lengths[index++] = len;
+                }
+            }
+
+            // There must be an end-of-block code
+            if (lengths[256] == 0)
+                return false;
+
+            // Incomplete codes are only allowed if there is a single code
+            int err = construct(lencode, lengths, nlen);
+            if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+                return false;
+            err = construct(distcode, lengths + nlen, ndist);
+            if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+                return false;
+
+            return codes(s, lencode, distcode);
+        }
+
+        inline constexpr std::array<uint32_t, 256> crc_table = []
+        {
+            std::array<uint32_t, 256> table {};
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            return table;
+        }();
+
+        inline uint32_t crc32(const unsigned char* buf, size_t size)
+        {
+            uint32_t crc = 0xffffffffu;
+            for (size_t pos = 0; pos < size; ++pos)
+                crc = crc_table[(crc ^ buf[pos]) & 0xff] ^ (crc >> 8);
+            return crc ^ 0xffffffffu;
+        }
+
+        inline uint32_t read_le32(const unsigned char* buf)
+        {
+            return static_cast<uint32_t>(buf[0]) | (static_cast<uint32_t>(buf[1]) << 8) |
+                   (static_cast<uint32_t>(buf[2]) << 16) | (static_cast<uint32_t>(buf[3]) << 24);
+        }
+    }  // namespace inflate_detail
+
+    // Returns the uncompressed size stored in the trailer of a gzip stream, or 0 if src isn't a gzip stream.
+    inline size_t gzip_original_size(const unsigned char* src, size_t src_size)
+    {
+        if (src_size < 18 || src[0] != 0x1f || src[1] != 0x8b)
+            return 0;
+        return inflate_detail::read_le32(src + src_size - 4);
+    }
+
+    // Decompresses a gzip stream into dst. Returns the number of bytes written, or 0 if the stream is invalid or dst is
+    // too small.
+    inline size_t gunzip(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size) noexcept
+    {
+        using namespace inflate_detail;
+
+        if (src_size < 18 || src[0] != 0x1f || src[1] != 0x8b || src[2] != 8)
+            return 0;
+
+        const unsigned char flags = src[3];
+        size_t pos = 10;
+        if (flags & 0x04)  // FEXTRA
+        {
+            if (pos + 2 > src_size)
+                return 0;
+            pos += 2 + (src[pos] | (src[pos + 1] << 8));
+        }
+        if (flags & 0x08)  // FNAME
+        {
+            while (pos < src_size && src[pos])
+                ++pos;
+            ++pos;
+        }
+        if (flags & 0x10)  // FCOMMENT
+        {
+            while (pos < src_size && src[pos])
+                ++pos;
+            ++pos;
+        }
+        if (flags & 0x02)  // FHCRC
+            pos += 2;
+        if (pos + 8 > src_size)
+            return 0;
+
+        state s { src, src_size - 8, pos, dst, dst_size, 0, 0, 0, false };
+
+        int last;
+        do
+        {
+            last = bits(s, 1);
+            int type = bits(s, 2);
+            if (s.error)
+                return 0;
+
+            bool ok;
+            switch (type)
+            {
+                case 0:
+                    ok = stored(s);
+                    break;
+                case 1:
+                    ok = fixed(s);
+                    break;
+                case 2:
+                    ok = dynamic(s);
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+            if (!ok || s.error)
+                return 0;
+        } while (!last);
+
+        const unsigned char* trailer = src + src_size - 8;
+        if (read_le32(trailer + 4) != static_cast<uint32_t>(s.out_pos) || read_le32(trailer) != crc32(dst, s.out_pos))
+            return 0;
+
+        return s.out_pos;
+    }
+
+    // A compressed asset that is decompressed the first time it is accessed. Decompression is thread-safe, and happens
+    // at most once.
+    class lazy_asset
+    {
+    public:
+        constexpr lazy_asset(const unsigned char* src, size_t src_size, unsigned char* buffer, size_t buffer_size) :
+            m_src(src), m_src_size(src_size), m_buffer(buffer), m_buffer_size(buffer_size)
+        {
+        }
+
+        lazy_asset(const lazy_asset&) = delete;
+        lazy_asset& operator=(const lazy_asset&) = delete;
+
+        // Returns nullptr if the asset could not be decompressed.
+        const unsigned char* data()
+        {
+            std::call_once(m_once, [this]() { m_size = gunzip(m_src, m_src_size, m_buffer, m_buffer_size); });
+            return (m_size || !m_buffer_size) ? m_buffer : nullptr;
+        }
+
+        // Returns the size of the decompressed asset (this does not require decompressing it).
+        size_t size() const { return m_buffer_size; }
+
+        std::string_view view()
+        {
+            auto ptr = data();
+            return ptr ? std::string_view(reinterpret_cast<const char*>(ptr), m_buffer_size) : std::string_view();
+        }
+
+        const unsigned char* compressed_data() const { return m_src; }
+        size_t compressed_size() const { return m_src_size; }
+
+    private:
+        const unsigned char* m_src;
+        size_t m_src_size;
+        unsigned char* m_buffer;
+        size_t m_buffer_size;
+        size_t m_size { 0 };
+        std::once_flag m_once;
+    };
+
+    // Each header generated with -runtime contains a table of contents with one entry for every source file.
+    struct toc_entry
+    {
+        const char* name;
+        lazy_asset* asset;
+    };
+
+    // Returns nullptr if name isn't in the table of contents. Nothing is decompressed until the asset's data() or
+    // view() method is called.
+    template <size_t N>
+    lazy_asset* find_asset(const toc_entry (&toc)[N], std::string_view name)
+    {
+        for (auto& iter: toc)
+        {
+            if (name == iter.name)
+                return iter.asset;
+        }
+        return nullptr;
+    }
+}  // namespace ttbld
+)==="
@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Simple fixed-size thread pool for running independent tasks
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Note: this is a header-only class
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks are run in the order they are added, but may complete in any order. Tasks must not throw, and must not use any
+// wxWidgets UI functionality.
+class CThreadPool
+{
+public:
+    // If threads is zero, one thread is created for each hardware thread.
+    CThreadPool(size_t threads = 0)
+    {
+        if (!threads)
+            threads = std::thread::hardware_concurrency();
+        if (!threads)
+            threads = 1;
+
+        m_threads.reserve(threads);
+        for (size_t count = 0; count < threads; ++count)
+            m_threads.emplace_back([this]() { WorkerThread(); });
+    }
+
+    CThreadPool(const CThreadPool&) = delete;
+    CThreadPool& operator=(const CThreadPool&) = delete;
+
+    // Waits for all pending tasks to finish before the threads are destroyed.
+    ~CThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isShuttingDown = true;
+        }
+        m_cv_task.notify_all();
+        for (auto& iter: m_threads)
+            iter.join();
+    }
+
+    void Add(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back(std::move(task));
+            ++m_pending;
+        }
+        m_cv_task.notify_one();
+    }
+
+    // Blocks until every task that has been added is complete.
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_done.wait(lock, [this]() { return m_pending == 0; });
+    }
+
+    size_t GetThreadCount() const { return m_threads.size(); }
+
+protected:
+    void WorkerThread()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv_task.wait(lock, [this]() { return m_isShuttingDown || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                    return;  // only possible if we're shutting down
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            task();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_pending == 0)
+                    m_cv_done.notify_all();
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv_task;
+    std::condition_variable m_cv_done;
+
+    size_t m_pending { 0 };
+    bool m_isShuttingDown { false };
+};
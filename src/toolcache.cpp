@@ -0,0 +1,412 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Persistent cache of tool locations, versions and supported flags
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+
+#include <wx/arrstr.h>  // wxArrayString class
+#include <wx/utils.h>   // Miscellaneous utilities
+
+#include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
+
+#include "toolcache.h"
+
+#include "assetcache.h"  // HashFnv1a, ReadFileBytes, WriteFileAtomic, WriteIfChanged
+
+namespace fs = std::filesystem;
+
+// Changing the file format MUST change this string so that a cache written by a previous version is ignored. Version 1
+// stored flag results from a probe that reported every cl flag as unsupported.
+static constexpr const char* txtToolCacheFormat = "# ttBld toolchain cache 2";
+
+// The cache file is tab-separated, so tabs and line breaks in tool output are replaced with spaces
+static ttlib::cstr CleanField(std::string_view str)
+{
+    ttlib::cstr result(str);
+    for (auto& ch: result)
+    {
+        if (ch == '\t' || ch == '\r' || ch == '\n')
+            ch = ' ';
+    }
+    return result;
+}
+
+static ttlib::cstr ToLower(std::string_view str)
+{
+    ttlib::cstr result(str);
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return result;
+}
+
+static bool HasSuffix(std::string_view str, std::string_view suffix)
+{
+    return str.size() >= suffix.size() && str.substr(str.size() - suffix.size()) == suffix;
+}
+
+// Returns the tool's filename in lower case without any .exe extension
+static ttlib::cstr GetToolName(const ttlib::cstr& tool)
+{
+    auto name = ToLower(tool.filename());
+    if (HasSuffix(name, ".exe"))
+        name.erase(name.size() - 4);
+    return name;
+}
+
+CToolCache& CToolCache::Get()
+{
+    static CToolCache cache;
+    return cache;
+}
+
+CToolCache::CToolCache()
+{
+#if defined(_WIN32)
+    if (auto dir = std::getenv("LOCALAPPDATA"); dir && *dir)
+        m_cache_file = dir;
+#else
+    if (auto dir = std::getenv("XDG_CACHE_HOME"); dir && *dir)
+        m_cache_file = dir;
+    else if (auto home = std::getenv("HOME"); home && *home)
+        (m_cache_file = home).append_filename(".cache");
+#endif  // _WIN32
+
+    // Without a cache directory, results are only kept until ttBld exits
+    if (m_cache_file.size())
+    {
+        m_cache_file.append_filename("ttBld/toolchain.cache");
+        m_cache_file.backslashestoforward();
+        Load();
+    }
+}
+
+bool CToolCache::GetFileStamp(const ttlib::cstr& filename, FileStamp& stamp)
+{
+    std::error_code ec;
+    auto path = fs::u8path(filename.c_str());
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return false;
+    auto size = fs::file_size(path, ec);
+    if (ec)
+        return false;
+
+    stamp.mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    stamp.size = static_cast<uint64_t>(size);
+    return true;
+}
+
+void CToolCache::Load()
+{
+    std::string contents;
+    if (!ReadFileBytes(m_cache_file, contents))
+        return;
+
+    ttlib::multistr lines(contents, '\n');
+    if (lines.empty() || !lines[0].is_sameas(txtToolCacheFormat))
+        return;
+
+    for (auto& line: lines)
+    {
+        if (line.size() && line.back() == '\r')
+            line.pop_back();
+        ttlib::multistr fields(line, '\t');
+
+        // found <TAB> env <TAB> filename <TAB> env hash <TAB> path <TAB> mtime <TAB> size
+        if (fields.size() == 7 && fields[0].is_sameas("found"))
+        {
+            FoundFile found;
+            found.env_hash = std::strtoull(fields[3].c_str(), nullptr, 16);
+            found.path = fields[4];
+            found.stamp.mtime = std::strtoll(fields[5].c_str(), nullptr, 10);
+            found.stamp.size = std::strtoull(fields[6].c_str(), nullptr, 10);
+            m_found[fields[1] + '\t' + fields[2]] = std::move(found);
+        }
+
+        // tool <TAB> path <TAB> mtime <TAB> size <TAB> version
+        else if (fields.size() == 5 && fields[0].is_sameas("tool"))
+        {
+            auto& tool = m_tools[fields[1]];
+            tool.stamp.mtime = std::strtoll(fields[2].c_str(), nullptr, 10);
+            tool.stamp.size = std::strtoull(fields[3].c_str(), nullptr, 10);
+            tool.version = fields[4];
+            tool.hasVersion = true;
+        }
+
+        // flag <TAB> path <TAB> mtime <TAB> size <TAB> flag <TAB> 0 or 1
+        else if (fields.size() == 6 && fields[0].is_sameas("flag"))
+        {
+            auto& tool = m_tools[fields[1]];
+            tool.stamp.mtime = std::strtoll(fields[2].c_str(), nullptr, 10);
+            tool.stamp.size = std::strtoull(fields[3].c_str(), nullptr, 10);
+            tool.flags[fields[4]] = fields[5].is_sameas("1");
+        }
+    }
+}
+
+bool CToolCache::Save()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    if (m_cache_file.empty())
+        return false;
+
+    ttlib::cstr out(txtToolCacheFormat);
+    out << '\n';
+    for (auto& [key, found]: m_found)
+    {
+        ttlib::cstr hash;
+        hash.Format("%016llx", static_cast<unsigned long long>(found.env_hash));
+        out << "found\t" << key << '\t' << hash << '\t' << found.path << '\t' << std::to_string(found.stamp.mtime)
+            << '\t' << std::to_string(found.stamp.size) << '\n';
+    }
+    for (auto& [path, tool]: m_tools)
+    {
+        ttlib::cstr stamp;
+        stamp << std::to_string(tool.stamp.mtime) << '\t' << std::to_string(tool.stamp.size);
+        if (tool.hasVersion)
+            out << "tool\t" << path << '\t' << stamp << '\t' << tool.version << '\n';
+        for (auto& [flag, isSupported]: tool.flags)
+            out << "flag\t" << path << '\t' << stamp << '\t' << flag << '\t' << (isSupported ? "1" : "0") << '\n';
+    }
+
+    // Several ttBld processes can share the cache -- WriteIfChanged() writes a temporary file and renames it, so another
+    // process never reads a partially written cache.
+    std::error_code ec;
+    fs::create_directories(fs::u8path(m_cache_file.c_str()).parent_path(), ec);
+    return WriteIfChanged(m_cache_file, out.data(), out.size());
+}
+
+bool CToolCache::FindFile(const std::string& env, std::string_view filename, ttlib::cstr& result)
+{
+    auto pszEnv = std::getenv(env.c_str());
+    if (!pszEnv)
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    auto env_hash = HashFnv1a(pszEnv);
+    ttlib::cstr key(env);
+    key << '\t' << filename;
+
+    if (auto found = m_found.find(key); found != m_found.end() && found->second.env_hash == env_hash)
+    {
+        FileStamp stamp;
+        if (GetFileStamp(found->second.path, stamp) && stamp == found->second.stamp)
+        {
+            result = found->second.path;
+            return true;
+        }
+    }
+
+    ttlib::cstr missing_key(key);
+    missing_key << '\t' << std::to_string(env_hash);
+    if (m_missing.count(missing_key))
+        return false;
+
+    ttlib::multistr enumstr(pszEnv);
+    for (auto& str: enumstr)
+    {
+        str.append_filename(filename);
+        if (str.file_exists())
+        {
+            result = str;
+            result.backslashestoforward();
+
+            auto& found = m_found[key];
+            found.env_hash = env_hash;
+            found.path = result;
+            GetFileStamp(result, found.stamp);
+            Save();
+            return true;
+        }
+    }
+
+    m_missing.emplace(missing_key);
+    return false;
+}
+
+CToolCache::ToolInfo* CToolCache::GetToolInfo(const ttlib::cstr& tool)
+{
+    FileStamp stamp;
+    if (!GetFileStamp(tool, stamp))
+        return nullptr;
+
+    auto& info = m_tools[tool];
+    if (!(info.stamp == stamp))
+    {
+        // The tool has been updated (or is new), so nothing previously recorded about it can be trusted
+        info = ToolInfo();
+        info.stamp = stamp;
+    }
+    return &info;
+}
+
+CToolCache::TOOL_FAMILY CToolCache::GetFamily(const ttlib::cstr& tool)
+{
+    auto name = GetToolName(tool);
+    if (name == "cl")
+        return TOOL_FAMILY::msvc_compiler;
+    if (name == "clang-cl")
+        return TOOL_FAMILY::clang_cl;
+    if (name == "link" || name == "lib" || name == "lld-link" || name == "llvm-lib")
+        return TOOL_FAMILY::msvc_linker;
+
+    // Cross compilers and versioned installs add a prefix or suffix (x86_64-w64-mingw32-g++, clang++-15)
+    if (name.contains("clang") || name.contains("gcc") || name.contains("g++") || name == "cc" || name == "c++" ||
+        HasSuffix(name, "-cc") || HasSuffix(name, "-c++"))
+    {
+        return TOOL_FAMILY::gnu_compiler;
+    }
+    return TOOL_FAMILY::gnu_linker;
+}
+
+int CToolCache::RunTool(const ttlib::cstr& tool, std::string_view args, std::string& output)
+{
+    ttlib::cstr command;
+    command << '"' << tool << '"';
+    if (args.size())
+        command << ' ' << args;
+
+    wxArrayString out_lines;
+    wxArrayString err_lines;
+    auto result =
+        wxExecute(command.wx_str(), out_lines, err_lines, wxEXEC_SYNC | wxEXEC_NODISABLE | wxEXEC_HIDE_CONSOLE);
+
+    output.clear();
+    for (auto& iter: out_lines)
+        output.append(iter.utf8_str().data()).append(1, '\n');
+    for (auto& iter: err_lines)
+        output.append(iter.utf8_str().data()).append(1, '\n');
+    return static_cast<int>(result);
+}
+
+ttlib::cstr CToolCache::GetVersion(const ttlib::cstr& tool)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    auto info = GetToolInfo(tool);
+    if (!info)
+        return {};
+
+    if (!info->hasVersion)
+    {
+        // cl, link and lib don't have a version option -- they print a banner ("Microsoft (R) C/C++ Optimizing Compiler
+        // Version 19.29.30133 for x64") followed by their usage when run without arguments.
+        auto name = GetToolName(tool);
+        bool isBanner = (name == "cl" || name == "link" || name == "lib");
+
+        std::string output;
+        if (RunTool(tool, isBanner ? "" : "--version", output) >= 0)
+        {
+            ttlib::multistr lines(output, '\n');
+            for (auto& iter: lines)
+            {
+                iter.trim(tt::TRIM::both);
+                if (iter.size() && (!isBanner || iter.contains("Version")))
+                {
+                    info->version = CleanField(iter);
+                    break;
+                }
+            }
+        }
+        info->hasVersion = true;
+        Save();
+    }
+    return info->version;
+}
+
+bool CToolCache::SupportsFlag(const ttlib::cstr& tool, std::string_view flag)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    auto info = GetToolInfo(tool);
+    if (!info)
+        return false;
+
+    if (auto found = info->flags.find(flag); found != info->flags.end())
+        return found->second;
+
+    bool isSupported = ProbeFlag(tool, flag);
+    info->flags[std::string(flag)] = isSupported;
+    Save();
+    return isSupported;
+}
+
+bool CToolCache::ProbeFlag(const ttlib::cstr& tool, std::string_view flag)
+{
+    auto family = GetFamily(tool);
+    std::string output;
+
+    if (family == TOOL_FAMILY::gnu_linker)
+    {
+        // --version means nothing is linked, but the rest of the command line is still parsed
+        ttlib::cstr args;
+        args << flag << " --version";
+        return RunTool(tool, args, output) == 0;
+    }
+
+    if (family == TOOL_FAMILY::msvc_linker)
+    {
+        // Without any input the run always fails, so only the warning about the flag tells whether it was accepted:
+        // LNK4044 (unrecognized option) or LNK1117 (syntax error in option) from link and lib, "unknown argument" from
+        // lld-link.
+        ttlib::cstr args;
+        args << "/nologo " << flag;
+        if (RunTool(tool, args, output) < 0)
+            return false;
+        auto lower = ToLower(output);
+        return !lower.contains("lnk4044") && !lower.contains("lnk1117") && !lower.contains("unknown argument");
+    }
+
+    // A compiler is given a minimal translation unit to compile with the flag. This is done in a directory named after
+    // the process so that concurrent ttBld processes can't interfere with each other, and so that anything else the
+    // flag makes the compiler write (e.g., a .dwo file for -gsplit-dwarf) is removed along with it.
+    std::error_code ec;
+    auto probe_dir = fs::temp_directory_path(ec) / ("ttbld_probe_" + std::to_string(wxGetProcessId()));
+    if (ec || !fs::create_directories(probe_dir, ec))
+        return false;
+    ttlib::cstr src_file((probe_dir / "probe.cpp").u8string());
+    ttlib::cstr obj_file((probe_dir / "probe.obj").u8string());
+
+    std::string_view source("int ttbld_probe;\n");
+    if (!WriteFileAtomic(src_file, source.data(), source.size()))
+    {
+        fs::remove_all(probe_dir, ec);
+        return false;
+    }
+
+    ttlib::cstr args;
+    int result;
+    switch (family)
+    {
+        case TOOL_FAMILY::msvc_compiler:
+            // cl only warns about an unknown option (D9002), and /WX doesn't change that, so the output has to be
+            // checked. An invalid argument to a known option is an error (D8021 etc.) and fails the compile.
+            args << "/nologo /c " << flag << " \"" << src_file << "\" /Fo\"" << obj_file << '"';
+            result = RunTool(tool, args, output);
+            result = (result == 0 && !ttlib::cstr(output).contains("D9002")) ? 0 : 1;
+            break;
+
+        case TOOL_FAMILY::clang_cl:
+            args << "/nologo /c /WX " << flag << " \"" << src_file << "\" /Fo\"" << obj_file << '"';
+            result = RunTool(tool, args, output);
+            break;
+
+        case TOOL_FAMILY::gnu_compiler:
+        default:
+            // -Werror turns clang's "argument unused during compilation" into a failure. An unknown option is already
+            // an error for both gcc and clang.
+            args << "-x c++ -c -Werror " << flag << " \"" << src_file << "\" -o \"" << obj_file << '"';
+            result = RunTool(tool, args, output);
+            break;
+    }
+
+    fs::remove_all(probe_dir, ec);
+    return result == 0;
+}
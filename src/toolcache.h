@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Persistent cache of tool locations, versions and supported flags
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+// Searching PATH (or INCLUDE, LIB, etc.) means checking every directory for the file, and finding out what a compiler
+// or linker supports means running it. Both results are stored in a cache file in the user's cache directory
+// (%LOCALAPPDATA%/ttBld on Windows, $XDG_CACHE_HOME/ttBld or ~/.cache/ttBld elsewhere) so that they are only ever
+// determined once.
+//
+// A found file is keyed on the value of the environment variable that was searched, and is verified by checking that
+// the file still has the same modification time and size. Version and flag results are keyed on the tool's path,
+// modification time and size, so updating a compiler invalidates everything that was recorded about it. A file that
+// could not be found is only remembered until ttBld exits, since installing a tool doesn't change the environment.
+class CToolCache
+{
+public:
+    static CToolCache& Get();
+
+    // Searches every directory in the environment variable env for filename. result is set to the full path with
+    // forward slashes.
+    bool FindFile(const std::string& env, std::string_view filename, ttlib::cstr& result);
+
+    // GetVersion() and SupportsFlag() run the tool the first time, so they must only be called from the main thread.
+
+    // Returns the first line of the tool's version banner, or an empty string if tool could not be run. cl, link and
+    // lib print their banner when run without arguments, every other tool is run with --version.
+    ttlib::cstr GetVersion(const ttlib::cstr& tool);
+
+    // Returns true if tool accepts flag (e.g., "-gsplit-dwarf" for a compiler or "--threads" for a linker). A compiler
+    // is checked by compiling a minimal translation unit with the flag, a linker by running it with the flag.
+    bool SupportsFlag(const ttlib::cstr& tool, std::string_view flag);
+
+    // Normally called automatically whenever a new result is added
+    bool Save();
+
+protected:
+    CToolCache();
+
+    struct FileStamp
+    {
+        int64_t mtime { 0 };
+        uint64_t size { 0 };
+
+        bool operator==(const FileStamp& other) const { return mtime == other.mtime && size == other.size; }
+    };
+
+    struct FoundFile
+    {
+        uint64_t env_hash;
+        ttlib::cstr path;
+        FileStamp stamp;
+    };
+
+    struct ToolInfo
+    {
+        FileStamp stamp;
+        ttlib::cstr version;
+        bool hasVersion { false };
+        std::map<std::string, bool, std::less<>> flags;
+    };
+
+    // Each family reports an unsupported flag differently
+    enum class TOOL_FAMILY
+    {
+        gnu_compiler,   // gcc, g++, clang, clang++ -- an unknown flag is an error
+        gnu_linker,     // ld, ld.lld, ld.gold, mold -- an unknown flag is an error
+        msvc_compiler,  // cl -- an unknown flag is warning D9002, and the compile succeeds
+        clang_cl,       // clang-cl -- an unknown flag is a warning, which /WX turns into an error
+        msvc_linker,    // link, lib, lld-link -- an unknown flag is a warning, and the run fails for lack of input
+    };
+
+    static TOOL_FAMILY GetFamily(const ttlib::cstr& tool);
+
+    static bool GetFileStamp(const ttlib::cstr& filename, FileStamp& stamp);
+
+    // Returns the tool's entry, resetting it if the tool has changed since it was recorded. Returns nullptr if the
+    // tool doesn't exist.
+    ToolInfo* GetToolInfo(const ttlib::cstr& tool);
+
+    // Runs the tool, and returns its exit code (-1 if it couldn't be run). Both stdout and stderr are returned in
+    // output.
+    static int RunTool(const ttlib::cstr& tool, std::string_view args, std::string& output);
+
+    // Runs the probe for tool's family. This is what SupportsFlag() caches.
+    static bool ProbeFlag(const ttlib::cstr& tool, std::string_view flag);
+
+    void Load();
+
+private:
+    ttlib::cstr m_cache_file;
+
+    std::map<std::string, FoundFile> m_found;  // key is env + '\t' + filename
+    std::set<std::string> m_missing;           // key is env + '\t' + filename + '\t' + env_hash
+    std::map<ttlib::cstr, ToolInfo> m_tools;   // key is the tool's full path
+
+    std::recursive_mutex m_mutex;
+};
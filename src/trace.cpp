@@ -0,0 +1,284 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Scoped timers and counters exported as a Chrome trace
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if defined(TTBLD_TRACE_ALLOCATIONS) && defined(_WIN32)
+    #include <malloc.h>  // _aligned_malloc, _aligned_free
+#endif
+
+#include "trace.h"
+
+#include "assetcache.h"  // WriteIfChanged
+
+static const char* aCounterNames[] = {
+    "files_stat",
+    "bytes_read",
+    "lines_emitted",
+#if defined(TTBLD_TRACE_ALLOCATIONS)
+    "allocations",
+#endif  // TTBLD_TRACE_ALLOCATIONS
+};
+static_assert(sizeof(aCounterNames) / sizeof(aCounterNames[0]) == static_cast<size_t>(TRACE_COUNTER::count),
+              "aCounterNames must have a name for every TRACE_COUNTER");
+
+#if defined(TTBLD_TRACE_ALLOCATIONS)
+
+// Replacing the global operator new is the only way to count every allocation. Since that affects every allocation in
+// the program whether or not -trace is used, it is only compiled in when the TTBLD_TRACE_ALLOCATIONS CMake option is
+// ON. Memory from malloc() has to be released with free(), so every form of new and delete is replaced -- not all
+// runtimes forward the array, nothrow and aligned versions to the single-object ones.
+
+static void* CountedAlloc(size_t size) noexcept
+{
+    CTrace::Count(TRACE_COUNTER::allocations);
+    return std::malloc(size ? size : 1);
+}
+
+static void* CountedAlignedAlloc(size_t size, std::align_val_t align) noexcept
+{
+    CTrace::Count(TRACE_COUNTER::allocations);
+    auto alignment = static_cast<size_t>(align);
+#if defined(_WIN32)
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    // aligned_alloc() requires the size to be a non-zero multiple of the alignment
+    return std::aligned_alloc(alignment, size ? (size + alignment - 1) / alignment * alignment : alignment);
+#endif  // _WIN32
+}
+
+static void AlignedFree(void* ptr) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif  // _WIN32
+}
+
+void* operator new(size_t size)
+{
+    if (auto ptr = CountedAlloc(size); ptr)
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    if (auto ptr = CountedAlloc(size); ptr)
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+    if (auto ptr = CountedAlignedAlloc(size, align); ptr)
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+    if (auto ptr = CountedAlignedAlloc(size, align); ptr)
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedAlloc(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return CountedAlignedAlloc(size, align);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    AlignedFree(ptr);
+}
+
+#endif  // TTBLD_TRACE_ALLOCATIONS
+
+CTrace& CTrace::Get()
+{
+    static CTrace trace;
+    return trace;
+}
+
+void CTrace::Enable(const ttlib::cstr& filename)
+{
+    m_filename = filename;
+    m_start = std::chrono::steady_clock::now();
+    for (auto& iter: s_counters)
+        iter.store(0, std::memory_order_relaxed);
+    s_isEnabled = true;
+}
+
+int64_t CTrace::GetTimestamp() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void CTrace::AddEvent(const char* name, int64_t start, int64_t duration, const int64_t* counter_deltas)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto thread = std::find(m_threads.begin(), m_threads.end(), std::this_thread::get_id());
+    if (thread == m_threads.end())
+        thread = m_threads.insert(m_threads.end(), std::this_thread::get_id());
+
+    auto& event = m_events.emplace_back();
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.tid = static_cast<size_t>(thread - m_threads.begin());
+    std::copy(counter_deltas, counter_deltas + static_cast<size_t>(TRACE_COUNTER::count), event.counters);
+}
+
+ttlib::cstr CTrace::GetJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Nested scopes end before the scopes containing them, so sorting by start time makes the file easier to read.
+    // The viewers don't care about the order.
+    std::vector<const Event*> events;
+    events.reserve(m_events.size());
+    for (auto& iter: m_events)
+        events.emplace_back(&iter);
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event* a, const Event* b) { return a->start < b->start; });
+
+    ttlib::cstr json;
+    json << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+
+    bool isFirst = true;
+    for (auto event: events)
+    {
+        // Names are string literals, so they never need escaping
+        json << (isFirst ? "\n" : ",\n") << "    { \"name\": \"" << event->name
+             << "\", \"cat\": \"ttBld\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << std::to_string(event->tid)
+             << ", \"ts\": " << std::to_string(event->start) << ", \"dur\": " << std::to_string(event->duration)
+             << ", \"args\": {";
+        isFirst = false;
+        for (size_t idx = 0; idx < static_cast<size_t>(TRACE_COUNTER::count); ++idx)
+        {
+            json << (idx ? ", \"" : " \"") << aCounterNames[idx] << "\": " << std::to_string(event->counters[idx]);
+        }
+        json << " } }";
+    }
+
+    // The totals are shown as a counter track at the end of the timeline
+    json << (isFirst ? "\n" : ",\n") << "    { \"name\": \"totals\", \"cat\": \"ttBld\", \"ph\": \"C\", \"pid\": 1, "
+         << "\"tid\": 0, \"ts\": " << std::to_string(GetTimestamp()) << ", \"args\": {";
+    for (size_t idx = 0; idx < static_cast<size_t>(TRACE_COUNTER::count); ++idx)
+    {
+        json << (idx ? ", \"" : " \"") << aCounterNames[idx]
+             << "\": " << std::to_string(GetCount(static_cast<TRACE_COUNTER>(idx)));
+    }
+    json << " } }\n  ]\n}\n";
+    return json;
+}
+
+bool CTrace::Write()
+{
+    if (!s_isEnabled)
+        return true;
+
+    auto json = GetJson();
+    if (!WriteIfChanged(m_filename, json.data(), json.size()))
+    {
+        std::cerr << "Unable to write " << m_filename << '\n';
+        return false;
+    }
+    return true;
+}
+
+void CTraceScope::Start(const char* name)
+{
+    m_name = name;
+    for (size_t idx = 0; idx < static_cast<size_t>(TRACE_COUNTER::count); ++idx)
+        m_counters[idx] = CTrace::GetCount(static_cast<TRACE_COUNTER>(idx));
+    m_start = CTrace::Get().GetTimestamp();
+}
+
+void CTraceScope::Stop()
+{
+    auto duration = CTrace::Get().GetTimestamp() - m_start;
+    for (size_t idx = 0; idx < static_cast<size_t>(TRACE_COUNTER::count); ++idx)
+        m_counters[idx] = CTrace::GetCount(static_cast<TRACE_COUNTER>(idx)) - m_counters[idx];
+    CTrace::Get().AddEvent(m_name, m_start, duration, m_counters);
+}
@@ -0,0 +1,124 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Scoped timers and counters exported as a Chrome trace
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+enum class TRACE_COUNTER : size_t
+{
+    files_stat,     // file system queries (existence, size, modification time)
+    bytes_read,     // bytes read from input files
+    lines_emitted,  // lines in generated scripts
+#if defined(TTBLD_TRACE_ALLOCATIONS)
+    allocations,    // calls to operator new
+#endif  // TTBLD_TRACE_ALLOCATIONS
+
+    count
+};
+
+// Enabled with -trace file. Every TRACE_SCOPE records how long it took along with how much each counter changed while
+// it was active, and when ttBld exits all of them are written to file in the Chrome trace event format (load it in
+// chrome://tracing, edge://tracing or https://ui.perfetto.dev).
+//
+// When tracing isn't enabled, a TRACE_SCOPE and a call to Count() only test a bool.
+class CTrace
+{
+public:
+    static CTrace& Get();
+
+    static bool IsEnabled() { return s_isEnabled; }
+
+    static void Count(TRACE_COUNTER counter, int64_t value = 1)
+    {
+        if (s_isEnabled)
+            s_counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static int64_t GetCount(TRACE_COUNTER counter)
+    {
+        return s_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    // Starts recording. The trace is written to filename by Write().
+    void Enable(const ttlib::cstr& filename);
+
+    // Returns microseconds since tracing was enabled
+    int64_t GetTimestamp() const;
+
+    // name must be a string literal (or otherwise remain valid until the trace is written)
+    void AddEvent(const char* name, int64_t start, int64_t duration, const int64_t* counter_deltas);
+
+    ttlib::cstr GetJson() const;
+
+    // Writes the trace file if tracing is enabled. Returns false if the file could not be written.
+    bool Write();
+
+protected:
+    CTrace() {}
+
+    struct Event
+    {
+        const char* name;
+        int64_t start;
+        int64_t duration;
+        size_t tid;
+        int64_t counters[static_cast<size_t>(TRACE_COUNTER::count)];
+    };
+
+private:
+    static inline bool s_isEnabled { false };
+    static inline std::atomic<int64_t> s_counters[static_cast<size_t>(TRACE_COUNTER::count)] {};
+
+    ttlib::cstr m_filename;
+    std::chrono::steady_clock::time_point m_start;
+
+    std::vector<Event> m_events;
+    std::vector<std::thread::id> m_threads;  // index is the tid written to the trace
+
+    mutable std::mutex m_mutex;
+};
+
+class CTraceScope
+{
+public:
+    CTraceScope(const char* name)
+    {
+        if (CTrace::IsEnabled())
+            Start(name);
+    }
+    ~CTraceScope()
+    {
+        if (m_name)
+            Stop();
+    }
+
+    CTraceScope(const CTraceScope&) = delete;
+    CTraceScope& operator=(const CTraceScope&) = delete;
+
+protected:
+    void Start(const char* name);
+    void Stop();
+
+private:
+    const char* m_name { nullptr };
+    int64_t m_start;
+    int64_t m_counters[static_cast<size_t>(TRACE_COUNTER::count)];
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+
+// Times the rest of the enclosing block. name must be a string literal.
+#define TRACE_SCOPE(name) CTraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
@@ -13,6 +13,7 @@
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
 #include "csrcfiles.h"  // CSrcFiles
+#include "plan.h"       // CPlan -- Records every file ttBld would write without writing any of them
 
 static const char* txtTasks =
 
@@ -54,7 +55,7 @@ bool CreateVsJson(const char* pszSrcFiles, std::vector<std::string>& results)
     CSrcFiles cSrcFiles;
     cSrcFiles.ReadFile(pszSrcFiles);
 
-    if (!std::filesystem::exists(".vs"))
+    if (!std::filesystem::exists(".vs") && !CPlan::Get().IsEnabled())
     {
         if (!std::filesystem::create_directory(".vs"))
         {
@@ -76,7 +77,11 @@ bool CreateVsJson(const char* pszSrcFiles, std::vector<std::string>& results)
     file.at(file.FindLineContaining("%command%")).Replace("%command%", "nmake.exe -nologo debug");
 #endif
 
-    if (!file.WriteFile(".vs/tasks.vs.json"))
+    if (CPlan::Get().Add(".vs/tasks.vs.json", file, "Visual Studio tasks"))
+    {
+        results.push_back("Planned .vs/tasks.vs.json");
+    }
+    else if (!file.WriteFile(".vs/tasks.vs.json"))
     {
         results.push_back(ttlib::cstr() << "Unable to create or write to "
                                         << ".vs/tasks.vs.json");
@@ -100,7 +105,11 @@ bool CreateVsJson(const char* pszSrcFiles, std::vector<std::string>& results)
         return false;
     }
 
-    if (!file.WriteFile(".vs/launch.vs.json"))
+    if (CPlan::Get().Add(".vs/launch.vs.json", file, "Visual Studio launch configuration"))
+    {
+        results.push_back("Planned .vs/launch.vs.json");
+    }
+    else if (!file.WriteFile(".vs/launch.vs.json"))
     {
         results.push_back(ttlib::cstr() << "Unable to create or write to "
                                         << ".vs/launch.vs.json");
@@ -12,10 +12,13 @@
 #include <ttmultistr_wx.h>  // multistr -- Breaks a single string into multiple strings
 #include <tttextfile_wx.h>  // ttTextFile, ttViewFile -- Similar to wxTextFile, but uses UTF8 strings
 
-#include "csrcfiles.h"  // CSrcFiles
-#include "funcs.h"      // List of function declarations
-#include "uifuncs.h"    // Miscellaneous functions for displaying UI
-#include "vscodedlg.h"  // VsCodeDlg -- Dialog for setting options to create tasks.json and launch.json
+#include "assetcache.h"  // ReadFileBytes, WriteIfChanged
+#include "csrcfiles.h"   // CSrcFiles
+#include "funcs.h"       // List of function declarations
+#include "jsonpatch.h"   // CJsonPatch -- Edits individual values in a JSON file without changing anything else
+#include "plan.h"        // CPlan -- Records every file ttBld would write without writing any of them
+#include "uifuncs.h"     // Miscellaneous functions for displaying UI
+#include "vscodedlg.h"   // VsCodeDlg -- Dialog for setting options to create tasks.json and launch.json
 
 bool CreateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results);
 bool UpdateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results);
@@ -23,11 +26,11 @@ bool UpdateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results);
 void AddMsvcTask(ttlib::textfile& fileOut, std::string_view Label, std::string_view Group, std::string_view Command);
 void AddClangTask(ttlib::textfile& fileOut, std::string_view Label, std::string_view Group, std::string_view Command);
 
-std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view projectFile)
+std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view projectFile, bool recreateProps)
 {
     std::vector<ttlib::cstr> results;
 
-    if (!ttlib::dir_exists(".vscode"))
+    if (!ttlib::dir_exists(".vscode") && !CPlan::Get().IsEnabled())
     {
         if (!std::filesystem::create_directory(".vscode"))
         {
@@ -68,7 +71,7 @@ std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view projectFile)
         return results;
     }
 
-    if (ttlib::file_exists(".vscode/c_cpp_properties.json"))
+    if (!recreateProps && ttlib::file_exists(".vscode/c_cpp_properties.json"))
     {
         if (!UpdateVsCodeProps(cSrcFiles, results))
             return results;
@@ -79,6 +82,10 @@ std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view projectFile)
             return results;
     }
 
+    // launch.json and tasks.json are created from the user's choices in a dialog, so they can't be part of a plan
+    if (CPlan::Get().IsEnabled())
+        return results;
+
     if (!ttlib::file_exists(".vscode/launch.json") || !ttlib::file_exists(".vscode/tasks.json"))
     {
         VsCodeDlg dlg;
@@ -101,127 +108,119 @@ std::vector<ttlib::cstr> CreateVsCodeProject(std::string_view projectFile)
     return results;
 }
 
-constexpr auto txtProperties = R"===(
-{
+constexpr auto txtProperties = R"===({
     "configurations": [
         {
             "name": "Default",
-             "cStandard": "c11",
-             "cppStandard": "c++11",
-             "defines": [
-             ],
-             "includePath": [
-             ]
-         }
-     ],
-     "version": 4
+            "cStandard": "c11",
+            "cppStandard": "c++11",
+            "defines": [],
+            "includePath": []
+        }
+    ],
+    "version": 4
 }
 )===";
 
-bool CreateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results)
+constexpr auto txtPropertiesFile = ".vscode/c_cpp_properties.json";
+
+// Writes the file only if its contents have changed. VS Code reparses the file (and IntelliSense re-indexes the
+// project) every time it is written.
+static bool WritePropsFile(const std::string& text, std::string_view action, std::vector<ttlib::cstr>& Results)
 {
-    ttlib::textfile out;
-    ttlib::textfile propFile;
-    propFile.ReadString(ttlib::find_nonspace(txtProperties));
+    if (CPlan::Get().Add(txtPropertiesFile, text, "VS Code IntelliSense configuration"))
+        return true;
 
-    for (auto propLine = propFile.begin(); propLine != propFile.end(); ++propLine)
+    std::string original;
+    if (ReadFileBytes(txtPropertiesFile, original) && original == text)
     {
-        if (propLine->view_nonspace().is_sameprefix("\"defines", tt::CASE::either))
-        {
-            out.emplace_back(*propLine);
-            std::vector<ttlib::cstr> Defines;
-            if (cSrcFiles.hasOptValue(OPT::CFLAGS_CMN))
-                ParseDefines(Defines, cSrcFiles.getOptValue(OPT::CFLAGS_CMN));
-            if (cSrcFiles.hasOptValue(OPT::CFLAGS_DBG))
-                ParseDefines(Defines, cSrcFiles.getOptValue(OPT::CFLAGS_DBG));
-            std::sort(Defines.begin(), Defines.end());
-            for (auto iter: Defines)
-            {
-                auto& line = out.addEmptyLine();
-                // add the defines in quotes, one per line (%ks puts the string in quotes)
-                line.Format("                %ks,", iter.c_str());
-            }
-            // we always define _DEBUG. Under Windows, we always define _WIN32.
+        Results.emplace_back("c_cpp_properties.json is up to date");
+        return true;
+    }
 
-#if defined(_WIN32)
-            out.emplace_back("                \"_WIN32\",");
-#endif
-            out.emplace_back("                \"_DEBUG\"");
-            continue;
-        }
+    if (!WriteIfChanged(txtPropertiesFile, text.data(), text.size()))
+    {
+        Results.emplace_back(ttlib::cstr("Unable to create or write to ") << txtPropertiesFile);
+        return false;
+    }
 
-        else if (propLine->view_nonspace().is_sameprefix("\"includePath", tt::CASE::either))
-        {
-            out.emplace_back(*propLine);
-            while (++propLine != propFile.end())  // find the end of the current list of includes
-            {
-                if (propLine->find(']') == tt::npos)
-                    out.emplace_back(*propLine);
-                else
-                    break;
-            }
+    Results.emplace_back(ttlib::cstr() << txtPropertiesFile << ' ' << action);
+    return true;
+}
 
-            if (cSrcFiles.hasOptValue(OPT::INC_DIRS))
-            {
-                ttlib::cstr projectDir = cSrcFiles.GetSrcFilesName();
-                projectDir.make_absolute();
-                projectDir.remove_filename();
+bool CreateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results)
+{
+    CJsonPatch json;
+    json.Parse(txtProperties);
 
-                ttlib::multistr enumInc(cSrcFiles.getOptValue(OPT::INC_DIRS));
-                for (auto& iter: enumInc)
-                {
-                    ttlib::cstr IncName(iter);
-                    IncName.make_absolute();
-                    IncName.make_relative(projectDir);
-                    IncName.backslashestoforward();
+    std::vector<ttlib::cstr> Defines;
+    if (cSrcFiles.hasOptValue(OPT::CFLAGS_CMN))
+        ParseDefines(Defines, cSrcFiles.getOptValue(OPT::CFLAGS_CMN));
+    if (cSrcFiles.hasOptValue(OPT::CFLAGS_DBG))
+        ParseDefines(Defines, cSrcFiles.getOptValue(OPT::CFLAGS_DBG));
+    std::sort(Defines.begin(), Defines.end());
 
-                    auto& line = out.addEmptyLine();
-                    line.Format("                \"${workspaceRoot}/%s\",", IncName.c_str());
-                }
-            }
-            // we always add the default include path
-            out.emplace_back("                \042${default}\042");
-            out.emplace_back(*propLine);
-            continue;
-        }
-        else if (propLine->view_nonspace().is_sameprefix("\"cppStandard", tt::CASE::either))
-        {
-            // The default is c++11, but check to see if a specific version was specified in Cflags
-            if (cSrcFiles.hasOptValue(OPT::CFLAGS_CMN) && cSrcFiles.getOptValue(OPT::CFLAGS_CMN).contains("std:c++"))
-            {
-                auto option = cSrcFiles.getOptValue(OPT::CFLAGS_CMN).subview();
-                option.remove_prefix(option.locate("std:c++") + 3);
-                ttlib::cstr cppstandard;
-                cppstandard.AssignSubString(option, ':', ' ');
-                auto& line = out.emplace_back(*propLine);
-                line.Replace("c++11", cppstandard);
-            }
-        }
-        else
+    // we always define _DEBUG. Under Windows, we always define _WIN32.
+#if defined(_WIN32)
+    Defines.emplace_back("_WIN32");
+#endif
+    Defines.emplace_back("_DEBUG");
+    json.SetStringArray({ "configurations", 0, "defines" }, Defines);
+
+    std::vector<ttlib::cstr> Includes;
+    if (cSrcFiles.hasOptValue(OPT::INC_DIRS))
+    {
+        ttlib::cstr projectDir = cSrcFiles.GetSrcFilesName();
+        projectDir.make_absolute();
+        projectDir.remove_filename();
+
+        ttlib::multistr enumInc(cSrcFiles.getOptValue(OPT::INC_DIRS));
+        for (auto& iter: enumInc)
         {
-            out.emplace_back(*propLine);
+            ttlib::cstr IncName(iter);
+            IncName.make_absolute();
+            IncName.make_relative(projectDir);
+            IncName.backslashestoforward();
+            Includes.emplace_back("${workspaceRoot}/" + IncName);
         }
     }
+    // we always add the default include path
+    Includes.emplace_back("${default}");
+    json.SetStringArray({ "configurations", 0, "includePath" }, Includes);
 
-    if (!out.WriteFile(".vscode/c_cpp_properties.json"))
+    // The default is c++11, but check to see if a specific version was specified in Cflags
+    if (cSrcFiles.hasOptValue(OPT::CFLAGS_CMN) && cSrcFiles.getOptValue(OPT::CFLAGS_CMN).contains("std:c++"))
     {
-        appMsgBox(ttlib::cstr("Unable to create or write to ") + ".vscode/c_cpp_properties.json");
-        return false;
+        auto option = cSrcFiles.getOptValue(OPT::CFLAGS_CMN).subview();
+        option.remove_prefix(option.locate("std:c++") + 3);
+        ttlib::cstr cppstandard;
+        cppstandard.AssignSubString(option, ':', ' ');
+        json.SetString({ "configurations", 0, "cppStandard" }, cppstandard);
     }
-    else
+
+    if (!WritePropsFile(json.GetText(), "created.", Results))
     {
-        Results.emplace_back("Created .vscode/c_cpp_properties.json");
+        appMsgBox(ttlib::cstr("Unable to create or write to ") + txtPropertiesFile);
+        return false;
     }
-
     return true;
 }
 
+// Only the "defines" and "includePath" arrays of each configuration are changed, and only if there is something to
+// add to them. Everything else in the file -- including any comments or keys the user added -- is left as is.
 bool UpdateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results)
 {
-    ttlib::textfile file;
-    if (!file.ReadFile(".vscode/c_cpp_properties.json"))
+    std::string original;
+    if (!ReadFileBytes(txtPropertiesFile, original))
+    {
+        Results.emplace_back(ttlib::cstr("Cannot open ") + txtPropertiesFile);
+        return false;
+    }
+
+    CJsonPatch json;
+    if (!json.Parse(original))
     {
-        Results.emplace_back(ttlib::cstr("Cannot open ") + ".vscode/c_cpp_properties.json");
+        Results.emplace_back(ttlib::cstr(txtPropertiesFile) << " is not valid JSON -- it has not been updated.");
         return false;
     }
 
@@ -282,157 +281,48 @@ bool UpdateVsCodeProps(CSrcFiles& cSrcFiles, std::vector<ttlib::cstr>& Results)
     if (Env.assignEnvVar("CFLAGSD"))
         ParseDefines(Defines, Env);
 
-    // BUGBUG: [KeyWorks - 7/27/2019] This is a short-term hack until we have hooked up proper routines for
-    // reading/writing .json files. While .json files are typically written out as line-oriented files, there's no
-    // requirement for each element to be on it's own line, which is what we require if we're reading line by line.
-    // So, if we're reading a file we generated that the user didn't touch, we're fine. But if the user decides to
-    // edit the file, we're likely to either lose their changes, or break entirely -- until we have a json class in
-    // place.
-
-    size_t line = 0;
-    for (; line < file.size(); ++line)
+    auto configurations = json.GetArraySize({ "configurations" });
+    for (size_t config = 0; config < configurations; ++config)
     {
-        // Normally defines and includePath place each argument on its own line, but it doesn't have to be done
-        // that way. They could all be on a single line, or they could be on multiple lines interspersed with
-        // comment lines, blank lines, etc. For now, we'll assume it wasn't hand-edited...
-
-        if (ttlib::contains(file[line], "\"defines\""))
-        {
-            if (file[line].find(']') != tt::npos)
-                continue;  // all on one line, we don't process it
-            auto insertpos = line + 1;
-
-            for (++line; line < file.size();)
-            {
-                if (file[line].find(']') != tt::npos)
-                    break;
-                auto start = file[line].find_nonspace();
-                if (start == tt::npos)
-                    continue;
-                ttlib::cstr tmp;
-                tmp.ExtractSubString(file[line], start);
-                ttlib::add_if(Defines, tmp);
-                file.erase(file.begin() + line, file.begin() + line + 1);
-            }
-            if (Defines.size())
-            {
-                size_t defpos = 0;
-                for (; defpos < Defines.size() - 1; ++defpos)
-                {
-                    file.insert(file.begin() + insertpos, ttlib::cstr() << "                \"" << Defines[defpos] << "\",");
-                    ++insertpos;
-                }
+        // The user's own defines and include paths are kept in their original order, and anything new is appended.
 
-                // Write the last one without a trailing comma
-                file.insert(file.begin() + insertpos, ttlib::cstr() << "                \"" << Defines[defpos] << "\"");
-                ++insertpos;
-            }
-            line = insertpos;
-            continue;
-        }
+        std::vector<ttlib::cstr> ConfigDefines;
+        json.GetStringArray({ "configurations", config, "defines" }, ConfigDefines);
+        for (auto& iter: Defines)
+            ttlib::add_if(ConfigDefines, iter);
+        json.SetStringArray({ "configurations", config, "defines" }, ConfigDefines);
 
-        if (file[line].contains("\"includePath\""))
+        std::vector<ttlib::cstr> ConfigIncludes;
+        json.GetStringArray({ "configurations", config, "includePath" }, ConfigIncludes);
+        for (auto& path: ConfigIncludes)
         {
-            if (file[line].contains("]"))
-                continue;  // all on one line, we don't process it
-            auto insertpos = line + 1;
+            if (path.empty() || path.contains("${workspaceRoot}") || path.contains("${default}"))
+                continue;
 
-            for (++line; line < file.size();)
+            // If it's not already a relative path, make it relative
+            if (path.at(0) != '.')
             {
-                if (file[line].contains("]"))
-                    break;
-                auto start = file[line].find_nonspace();
-                if (start == tt::npos)
-                    continue;
-                ttlib::cstr path;
-                path.ExtractSubString(file[line], start);
-                if (!path.contains("${workspaceRoot}") && !path.contains("${default}"))
-                {
-                    // If it's not already a relative path, make it relative
-                    if (path.at(0) != '.')
-                    {
-                        path.make_relative(".");
-                    }
+                path.make_relative(".");
+            }
 #if defined(_WIN32)
-                    path.backslashestoforward();
+            path.backslashestoforward();
 #endif
-                    if (!path.contains(":"))
-                    {
-                        Includes.emplace_back("${workspaceRoot}/" + path);
-                    }
-                    else
-                    {
-                        Includes.emplace_back(path);
-                    }
-                }
-                else
-                {
-                    Includes.emplace_back(path);
-                }
-                file.erase(file.begin() + line, file.begin() + line + 1);
-            }
-
-            if (Includes.size())
-            {
-                size_t defpos = 0;
-                for (; defpos < Includes.size() - 1; ++defpos)
-                {
-                    // ':' is checked in case a drive letter is specified
-                    if (!Includes[defpos].contains("${workspaceRoot}") && !Includes[defpos].contains("${default}") &&
-                        !Includes[defpos].contains(":"))
-                    {
-                        Includes[defpos].insert(0, "${workspaceRoot}/");
-                    }
-
-                    file.insert(file.begin() + insertpos, "                \"" + Includes[defpos] + "\",");
-                    ++insertpos;
-                }
-
-                // Write the last one without a trailing comma
-                file.insert(file.begin() + insertpos, "                \"" + Includes[defpos] + "\"");
-                ++insertpos;
-            }
-            line = insertpos;
-            continue;
-        }
-    }
-    ttlib::viewfile orgfile;
-    if (!orgfile.ReadFile(".vscode/c_cpp_properties.json"))
-    {
-        Results.emplace_back(ttlib::cstr("Cannot open ") + ".vscode/c_cpp_properties.json");
-        return false;
-    }
-
-    bool Modified = false;
-    if (file.size() != orgfile.size())
-        Modified = true;
-    else
-    {
-        for (line = 0; line < file.size(); ++line)
-        {
-            if (!file[line].is_sameas(orgfile[line]))
-            {
-                Modified = true;
-                break;
-            }
+            // ':' is checked in case a drive letter is specified
+            if (!path.contains(":"))
+                path.insert(0, "${workspaceRoot}/");
         }
+        for (auto& iter: Includes)
+            ttlib::add_if(ConfigIncludes, iter);
+        json.SetStringArray({ "configurations", config, "includePath" }, ConfigIncludes);
     }
 
-    if (!Modified)
+    if (json.GetText() == original)
     {
         Results.emplace_back("c_cpp_properties.json is up to date");
         return true;
     }
 
-    if (!file.WriteFile(".vscode/c_cpp_properties.json"))
-    {
-        Results.emplace_back("Unable to create or write to .vscode/c_cpp_properties.json");
-        return false;
-    }
-
-    Results.emplace_back(".vscode/c_cpp_properties.json updated.");
-
-    return true;
+    return WritePropsFile(json.GetText(), "updated.", Results);
 }
 
 // Given a string, finds any definitions and stores them in the provided list. Primarily used
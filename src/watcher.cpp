@@ -0,0 +1,512 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Keeps .ninja scripts up to date whenever a project input changes
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <csignal>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string_view>
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <sddl.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <wx/filename.h>  // wxFileName - encapsulates a file path
+
+#include "watcher.h"
+
+#include "assetcache.h"  // NormalizePath
+#include "globindex.h"   // CGlobIndex -- Incremental index of the directories searched by wildcard patterns
+#include "ninja.h"       // CNinja
+#include "trace.h"       // CTrace -- Scoped timers and counters exported as a Chrome trace
+#include "ttconsole.h"   // concolor -- Sets/restores console foreground color
+
+// Editors often save a file by writing a temporary file and renaming it, so several notifications arrive for a single
+// change. Waiting this long after the last one means the scripts are only regenerated once.
+static constexpr int DEBOUNCE_MS = 50;
+
+enum : int
+{
+    id_server = wxID_HIGHEST + 1,
+    id_client,
+};
+
+// The destructor doesn't run if ttBld is interrupted, so the control file is also removed by a signal (or console
+// control) handler. The handler can only use what is stored here.
+#if defined(_WIN32)
+static std::filesystem::path s_control_path;
+
+static BOOL WINAPI OnConsoleCtrl(DWORD /* type */)
+{
+    std::error_code ec;
+    std::filesystem::remove(s_control_path, ec);
+    return FALSE;  // let the default handler terminate the process
+}
+#else
+static std::array<char, 4096> s_control_path {};
+
+static void OnTerminateSignal(int sig)
+{
+    unlink(s_control_path.data());  // async-signal-safe, unlike std::filesystem::remove()
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+#endif  // _WIN32
+
+static void InstallCleanupHandler(const ttlib::cstr& control_file)
+{
+#if defined(_WIN32)
+    s_control_path = std::filesystem::u8path(control_file.c_str());
+    SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+#else
+    if (control_file.size() >= s_control_path.size())
+        return;
+    std::copy(control_file.begin(), control_file.end(), s_control_path.begin());
+    s_control_path[control_file.size()] = 0;
+    for (auto sig: { SIGINT, SIGTERM, SIGHUP })
+        std::signal(sig, OnTerminateSignal);
+#endif  // _WIN32
+}
+
+static void RemoveCleanupHandler()
+{
+#if defined(_WIN32)
+    SetConsoleCtrlHandler(OnConsoleCtrl, FALSE);
+#else
+    for (auto sig: { SIGINT, SIGTERM, SIGHUP })
+        std::signal(sig, SIG_DFL);
+    s_control_path[0] = 0;
+#endif  // _WIN32
+}
+
+// 128 bits from the system's random number source
+static ttlib::cstr CreateToken()
+{
+    static constexpr const char* hex_digits = "0123456789abcdef";
+
+    std::random_device random;
+    ttlib::cstr token;
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        auto value = static_cast<uint32_t>(random());
+        for (int nibble = 0; nibble < 8; ++nibble, value >>= 4)
+            token += hex_digits[value & 0xf];
+    }
+    return token;
+}
+
+// Takes the same time whether or not the tokens match, so the token can't be guessed one character at a time
+static bool IsSameToken(std::string_view token, std::string_view expected)
+{
+    if (token.size() != expected.size())
+        return false;
+    unsigned char diff = 0;
+    for (size_t idx = 0; idx < token.size(); ++idx)
+        diff |= static_cast<unsigned char>(token[idx] ^ expected[idx]);
+    return diff == 0;
+}
+
+// Replaces filename with a new file that only the current user can read or write
+static bool WritePrivateFile(const ttlib::cstr& filename, std::string_view contents)
+{
+    auto path = std::filesystem::u8path(filename.c_str());
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+#if defined(_WIN32)
+    // Protected DACL that only grants access to the file's owner
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;;FA;;;OW)", SDDL_REVISION_1, &descriptor,
+                                                              nullptr))
+        return false;
+    SECURITY_ATTRIBUTES attributes { sizeof(attributes), descriptor, FALSE };
+    HANDLE hFile =
+        CreateFileW(path.c_str(), GENERIC_WRITE, 0, &attributes, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LocalFree(descriptor);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD written = 0;
+    bool result = WriteFile(hFile, contents.data(), static_cast<DWORD>(contents.size()), &written, nullptr) &&
+                  written == contents.size();
+    CloseHandle(hFile);
+    return result;
+#else
+    // O_EXCL means a file or symlink someone else created in its place since it was removed is never written through
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+
+    bool result = true;
+    while (contents.size())
+    {
+        auto written = write(fd, contents.data(), contents.size());
+        if (written <= 0)
+        {
+            result = false;
+            break;
+        }
+        contents.remove_prefix(static_cast<size_t>(written));
+    }
+    close(fd);
+    return result;
+#endif  // _WIN32
+}
+
+CWatcher::CWatcher(const ttlib::cstr& projectFile) : m_projectFile(projectFile), m_timer(this)
+{
+    Bind(wxEVT_FSWATCHER, &CWatcher::OnFileChange, this);
+    Bind(wxEVT_TIMER, &CWatcher::OnTimer, this);
+    Bind(wxEVT_SOCKET, &CWatcher::OnServerEvent, this, id_server);
+    Bind(wxEVT_SOCKET, &CWatcher::OnClientEvent, this, id_client);
+}
+
+CWatcher::~CWatcher()
+{
+    for (auto& iter: m_clients)
+        iter.first->Destroy();
+    if (m_server)
+        m_server->Destroy();
+
+    if (m_control_file.size())
+    {
+        RemoveCleanupHandler();
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::u8path(m_control_file.c_str()), ec);
+    }
+}
+
+int CWatcher::Run()
+{
+    wxEventLoop loop;
+    m_loop = &loop;
+
+    // The file system watcher can only be created once the event loop is running
+    CallAfter(&CWatcher::Start);
+    auto result = loop.Run();
+
+    m_loop = nullptr;
+    return m_exit_code ? m_exit_code : result;
+}
+
+void CWatcher::Start()
+{
+    m_fs_watcher = std::make_unique<wxFileSystemWatcher>();
+    m_fs_watcher->SetOwner(this);
+
+    Regenerate();
+    if (!m_ninja)
+    {
+        // Regenerate() has already explained why the project couldn't be read
+        m_exit_code = 1;
+        m_loop->Exit(m_exit_code);
+        return;
+    }
+
+    wxIPV4address addr;
+    addr.LocalHost();
+    addr.Service(0);  // let the system choose an unused port
+    m_server = new wxSocketServer(addr, wxSOCKET_REUSEADDR);
+    if (!m_server->IsOk())
+    {
+        std::cerr << "Unable to create a local socket for -watch" << '\n';
+        m_exit_code = 1;
+        m_loop->Exit(m_exit_code);
+        return;
+    }
+    m_server->GetLocal(addr);
+    m_server->SetEventHandler(*this, id_server);
+    m_server->SetNotify(wxSOCKET_CONNECTION_FLAG);
+    m_server->Notify(true);
+
+    if (!WriteControlFile(addr.Service()))
+    {
+        std::cerr << "Unable to create " << m_control_file << '\n';
+        m_exit_code = 1;
+        m_loop->Exit(m_exit_code);
+        return;
+    }
+
+    std::cout << "Watching " << m_watched.size() << " directories for changes (port " << addr.Service() << " in "
+              << m_control_file << ")" << '\n';
+}
+
+bool CWatcher::WriteControlFile(unsigned short port)
+{
+    m_token = CreateToken();
+    m_control_file = m_ninja->GetBldDir();
+    m_control_file.append_filename("watch.port");
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::u8path(m_ninja->GetBldDir().c_str()), ec);
+
+    // The handler is installed first so that there's no window where the file could be left behind
+    InstallCleanupHandler(m_control_file);
+    ttlib::cstr contents;
+    contents << std::to_string(port) << '\n' << m_token << '\n';
+    return WritePrivateFile(m_control_file, contents);
+}
+
+bool CWatcher::Regenerate()
+{
+    TRACE_SCOPE("CWatcher::Regenerate");
+
+    m_timer.Stop();
+    m_isStale = false;
+    m_last_error.clear();
+
+    if (!m_projectFile.file_exists())
+    {
+        // Probably in the middle of being saved -- there will be another notification once it has been written
+        m_last_error = "Cannot open " + m_projectFile;
+    }
+    else
+    {
+        // This re-reads the project file and every .include and BuildLibs: project, and expands every wildcard pattern
+        m_ninja = std::make_unique<CNinja>(m_projectFile);
+        if (!m_ninja->IsValidVersion())
+        {
+            m_last_error = "This version of ttBld is too old -- you need a newer version to correctly build the script "
+                           "files.";
+        }
+        else
+        {
+            m_ninja->CreateMakeFile(CNinja::MAKE_TYPE::autogen);
+            auto countNinjas = m_ninja->CreateAllBuildFiles();
+            CGlobIndex::SaveAll();
+            if (countNinjas > 0)
+                std::cout << "Updated " << countNinjas << " .ninja files" << '\n';
+
+            if (m_ninja->getErrorMsgs().size())
+            {
+                m_last_error = m_ninja->getErrorMsgs().front();
+                ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+                for (auto& iter: m_ninja->getErrorMsgs())
+                    std::cout << iter << '\n';
+            }
+        }
+    }
+
+    if (m_last_error.size())
+    {
+        ttlib::concolor clr(ttlib::concolor::LIGHTRED);
+        std::cout << m_last_error << '\n';
+    }
+
+    UpdateWatches();
+    return m_last_error.empty();
+}
+
+void CWatcher::UpdateWatches()
+{
+    m_input_files.clear();
+    m_input_dirs.clear();
+
+    m_input_files.emplace(GetPathKey(m_projectFile));
+    if (m_ninja)
+    {
+        for (auto& iter: m_ninja->GetInputFiles())
+            m_input_files.emplace(GetPathKey(iter));
+        for (auto& iter: m_ninja->GetInputDirs())
+            m_input_dirs.emplace(GetPathKey(iter));
+
+        // The .rc file and everything it includes are listed in the .ninja scripts as dependencies
+        if (m_ninja->GetRcFile().size())
+            m_input_files.emplace(GetPathKey(m_ninja->GetRcFile()));
+        for (auto& iter: m_ninja->GetRcDependencies())
+            m_input_files.emplace(GetPathKey(iter));
+    }
+
+    std::set<ttlib::cstr> dirs(m_input_dirs);
+    for (auto& iter: m_input_files)
+    {
+        ttlib::cstr dir(iter);
+        dir.remove_filename();
+        if (dir.size() > 1 && dir.back() == '/')
+            dir.pop_back();
+        dirs.emplace(dir);
+    }
+
+    for (auto iter = m_watched.begin(); iter != m_watched.end();)
+    {
+        if (!dirs.count(*iter))
+        {
+            m_fs_watcher->Remove(wxFileName::DirName(iter->wx_str()));
+            iter = m_watched.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    for (auto& iter: dirs)
+    {
+        if (m_watched.count(iter) || !iter.dir_exists())
+            continue;
+        if (m_fs_watcher->Add(wxFileName::DirName(iter.wx_str()), wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE |
+                                                                       wxFSW_EVENT_RENAME | wxFSW_EVENT_MODIFY))
+        {
+            m_watched.emplace(iter);
+        }
+    }
+}
+
+bool CWatcher::IsRelevant(const ttlib::cstr& path, bool isModified) const
+{
+    if (m_input_files.count(path))
+        return true;
+
+    // A file being modified doesn't change the scripts unless it's one of the input files. A file being added,
+    // removed or renamed does if it is in a directory searched by a wildcard pattern and has one of the extensions
+    // that CSrcFiles::AddSourcePattern() adds.
+    if (isModified)
+        return false;
+
+    ttlib::cstr dir(path);
+    dir.remove_filename();
+    if (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+    if (!m_input_dirs.count(dir))
+        return false;
+
+    return (path.has_extension(".c") || path.has_extension(".cc") || path.has_extension(".cpp") ||
+            path.has_extension(".cxx") || path.has_extension(".rc") || path.has_extension(".idl") ||
+            path.has_extension(".hhp"));
+}
+
+void CWatcher::OnFileChange(wxFileSystemWatcherEvent& event)
+{
+    auto type = event.GetChangeType();
+
+    // If notifications were lost, there's no way to know what changed
+    bool isRelevant = (type == wxFSW_EVENT_WARNING || type == wxFSW_EVENT_ERROR);
+
+    if (!isRelevant && (type & (wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME | wxFSW_EVENT_MODIFY)))
+    {
+        bool isModified = (type == wxFSW_EVENT_MODIFY);
+        isRelevant = IsRelevant(GetPathKey(event.GetPath().GetFullPath().utf8_str().data()), isModified);
+        if (!isRelevant && type == wxFSW_EVENT_RENAME)
+            isRelevant = IsRelevant(GetPathKey(event.GetNewPath().GetFullPath().utf8_str().data()), isModified);
+    }
+
+    if (isRelevant)
+    {
+        m_isStale = true;
+        m_timer.StartOnce(DEBOUNCE_MS);
+    }
+}
+
+void CWatcher::OnTimer(wxTimerEvent& WXUNUSED(event))
+{
+    if (m_isStale)
+        Regenerate();
+}
+
+void CWatcher::OnServerEvent(wxSocketEvent& WXUNUSED(event))
+{
+    auto client = m_server->Accept(false);
+    if (!client)
+        return;
+
+    client->SetFlags(wxSOCKET_NOWAIT);
+    client->SetEventHandler(*this, id_client);
+    client->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_LOST_FLAG);
+    client->Notify(true);
+    m_clients[client];
+}
+
+void CWatcher::OnClientEvent(wxSocketEvent& event)
+{
+    auto client = event.GetSocket();
+    if (event.GetSocketEvent() == wxSOCKET_LOST)
+    {
+        m_clients.erase(client);
+        client->Destroy();
+        return;
+    }
+
+    char buffer[256];
+    client->Read(buffer, sizeof(buffer));
+    auto& state = m_clients[client];
+    auto& input = state.input;
+    input.append(buffer, client->LastCount());
+
+    for (auto pos = input.find('\n'); pos != std::string::npos; pos = input.find('\n'))
+    {
+        ttlib::cstr command(input.substr(0, pos));
+        input.erase(0, pos + 1);
+        command.trim(tt::TRIM::both);
+
+        if (!state.isAuthorized)
+        {
+            if (!IsSameToken(command, m_token))
+            {
+                std::string_view reply("error: not authorized\n");
+                client->Write(reply.data(), static_cast<wxUint32>(reply.size()));
+                m_clients.erase(client);
+                client->Destroy();
+                return;
+            }
+            state.isAuthorized = true;
+            continue;
+        }
+
+        auto reply = ProcessCommand(command);
+        reply << '\n';
+        client->Write(reply.data(), static_cast<wxUint32>(reply.size()));
+    }
+
+    // Commands are only a few characters long, so this isn't a client that knows how to talk to us
+    if (input.size() > 1024)
+        input.clear();
+}
+
+ttlib::cstr CWatcher::ProcessCommand(const std::string& command)
+{
+    if (command == "status")
+    {
+        if (m_isStale)
+            Regenerate();
+    }
+    else if (command == "regen")
+    {
+        Regenerate();
+    }
+    else if (command == "quit")
+    {
+        m_loop->Exit(m_exit_code);
+        return "bye";
+    }
+    else
+    {
+        return "error: unknown command " + command;
+    }
+
+    return (m_last_error.empty() ? ttlib::cstr("fresh") : ttlib::cstr("error: ") << m_last_error);
+}
+
+ttlib::cstr CWatcher::GetPathKey(const ttlib::cstr& path)
+{
+    ttlib::cstr result(NormalizePath(std::filesystem::u8path(path.c_str())));
+
+#if defined(_WIN32)
+    // File names are not case-sensitive on Windows
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+#endif  // _WIN32
+
+    return result;
+}
@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Keeps .ninja scripts up to date whenever a project input changes
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <wx/event.h>      // Event classes
+#include <wx/evtloop.h>    // declares wxEventLoop class
+#include <wx/fswatcher.h>  // wxFileSystemWatcherBase
+#include <wx/socket.h>     // Socket handling classes
+#include <wx/timer.h>      // wxTimer, wxStopWatch and global time-related functions
+
+#include "ttcstr_wx.h"  // cstr -- std::string with additional methods
+
+class CNinja;
+
+// Used by -watch. The project is read once and kept in memory, and the directories containing every project input are
+// monitored: .srcfiles.yaml, .include files, .cmake file lists, the BuildLibs: projects, the .rc file and everything it
+// includes, and each directory searched by a wildcard pattern. When one of them changes, the project is read again
+// and the .ninja scripts are regenerated -- only scripts whose contents actually changed are written.
+//
+// A local TCP socket accepts single-line commands so that an editor or makefile can check on the scripts without
+// starting a process. Any local user can connect to the socket, so <bld dir>/watch.port contains the port on its first
+// line and a random token on its second, and only the current user can read the file. A client's first line must be
+// the token (there is no reply to it) -- anything else gets "error: not authorized" and the connection is closed. The
+// file is removed whenever -watch exits, including when it is interrupted.
+//
+//     status  -- regenerates first if a change is pending, then replies "fresh" or "error: <message>"
+//     regen   -- regenerates unconditionally, then replies the same as status
+//     quit    -- replies "bye" and stops watching
+class CWatcher : public wxEvtHandler
+{
+public:
+    CWatcher(const ttlib::cstr& projectFile);
+    ~CWatcher();
+
+    // Doesn't return until a client sends "quit". Returns the exit code for ttBld.
+    int Run();
+
+protected:
+    void Start();
+    bool Regenerate();
+    void UpdateWatches();
+
+    // Returns true if a change to path requires the scripts to be regenerated. isModified is true if the file's
+    // contents changed, false if it was added, removed or renamed.
+    bool IsRelevant(const ttlib::cstr& path, bool isModified) const;
+
+    ttlib::cstr ProcessCommand(const std::string& command);
+
+    void OnFileChange(wxFileSystemWatcherEvent& event);
+    void OnTimer(wxTimerEvent& event);
+    void OnServerEvent(wxSocketEvent& event);
+    void OnClientEvent(wxSocketEvent& event);
+
+    // Writes the port and token to m_control_file. Returns false if the file could not be created.
+    bool WriteControlFile(unsigned short port);
+
+    // Returns NormalizePath(path), converted to lower case on Windows, so that paths can be compared.
+    static ttlib::cstr GetPathKey(const ttlib::cstr& path);
+
+private:
+    ttlib::cstr m_projectFile;
+    ttlib::cstr m_control_file;  // <bld dir>/watch.port
+    ttlib::cstr m_token;         // clients must send this before any command
+
+    std::unique_ptr<CNinja> m_ninja;
+
+    std::set<ttlib::cstr> m_input_files;  // normalized paths of every file the scripts depend on
+    std::set<ttlib::cstr> m_input_dirs;   // normalized paths of directories searched by wildcard patterns
+    std::set<ttlib::cstr> m_watched;      // directories currently being watched
+
+    std::unique_ptr<wxFileSystemWatcher> m_fs_watcher;
+
+    struct Client
+    {
+        std::string input;  // unprocessed input
+        bool isAuthorized { false };
+    };
+
+    // Sockets must be released with Destroy() rather than deleted
+    wxSocketServer* m_server { nullptr };
+    std::map<wxSocketBase*, Client> m_clients;
+
+    wxEventLoopBase* m_loop { nullptr };
+
+    wxTimer m_timer;
+    ttlib::cstr m_last_error;
+
+    int m_exit_code { 0 };
+    bool m_isStale { true };
+};
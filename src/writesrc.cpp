@@ -9,6 +9,7 @@
 
 #include <tttextfile_wx.h>  // textfile -- Classes for reading and writing line-oriented files
 
+#include "plan.h"      // CPlan -- Records every file ttBld would write without writing any of them
 #include "writesrc.h"  // CWriteSrcFiles
 
 CWriteSrcFiles::CWriteSrcFiles() {}
@@ -171,7 +172,7 @@ bld::RESULT CWriteSrcFiles::UpdateOptions(std::string_view filename)
         out.emplace_back(orgFile[pos++]);
     }
 
-    if (out.WriteFile(ttlib::cstr(filename)))
+    if (CPlan::Get().Add(ttlib::cstr(filename), out, "project file") || out.WriteFile(ttlib::cstr(filename)))
         return bld::success;
 
     return bld::write_failed;
@@ -276,5 +277,7 @@ bld::RESULT CWriteSrcFiles::WriteNew(std::string_view filename, std::string_view
         out.emplace_back("    " + iter);
     }
 
+    if (CPlan::Get().Add(ttlib::cstr(filename), out, "project file"))
+        return bld::success;
     return (out.WriteFile(ttlib::cstr(filename)) ? bld::success : bld::write_failed);
 }
@@ -0,0 +1,116 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Bump allocator for pugixml documents
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+
+#include "xmlarena.h"  // CXmlArena
+
+#include "pugixml/pugixml.hpp"  // pugixml parser
+
+// Every allocation is preceded by this header so that XmlDeallocate() can tell whether the memory came from an arena or
+// from malloc(). pugixml doesn't pass the size to its deallocation function, so there's no other way to know.
+struct alignas(16) AllocHeader
+{
+    CXmlArena* arena;
+};
+
+static constexpr size_t ALIGNMENT = sizeof(AllocHeader);
+
+static thread_local CXmlArena* t_active_arena = nullptr;
+
+static size_t AlignSize(size_t size)
+{
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static void* XmlAllocate(size_t size)
+{
+    AllocHeader* header;
+    if (t_active_arena)
+    {
+        header = static_cast<AllocHeader*>(t_active_arena->Allocate(sizeof(AllocHeader) + size));
+    }
+    else
+    {
+        header = static_cast<AllocHeader*>(std::malloc(sizeof(AllocHeader) + size));
+        if (!header)
+            return nullptr;
+    }
+
+    header->arena = t_active_arena;
+    return header + 1;
+}
+
+static void XmlDeallocate(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    auto header = static_cast<AllocHeader*>(ptr) - 1;
+
+    // Arena memory is released when the arena is reset or destroyed
+    if (!header->arena)
+        std::free(header);
+}
+
+void CXmlArena::Install()
+{
+    pugi::set_memory_management_functions(XmlAllocate, XmlDeallocate);
+}
+
+CXmlArena::CXmlArena(size_t block_size) : m_block_size(AlignSize(block_size)) {}
+
+void CXmlArena::NextBlock()
+{
+    // Blocks are kept after a Reset() so that converting the next project doesn't have to allocate (and page in) fresh
+    // memory.
+    if (m_blocks_used >= m_blocks.size())
+    {
+        // The memory is deliberately not initialized -- pugixml initializes everything it uses.
+        m_blocks.emplace_back(new Chunk[m_block_size / sizeof(Chunk)]);
+    }
+    m_cur = reinterpret_cast<char*>(m_blocks[m_blocks_used++].get());
+    m_end = m_cur + m_block_size;
+}
+
+void* CXmlArena::Allocate(size_t size)
+{
+    size = AlignSize(size);
+
+    // Large allocations (typically the copy of the entire file when a document is parsed in place) get their own block
+    // so that the rest of the current block isn't wasted.
+    if (size > m_block_size / 4)
+    {
+        auto& block = m_large_blocks.emplace_back(new Chunk[size / sizeof(Chunk)]);
+        return block.get();
+    }
+
+    if (static_cast<size_t>(m_end - m_cur) < size)
+        NextBlock();
+
+    auto ptr = m_cur;
+    m_cur += size;
+    return ptr;
+}
+
+void CXmlArena::Reset()
+{
+    m_large_blocks.clear();
+    m_cur = nullptr;
+    m_end = nullptr;
+    m_blocks_used = 0;
+}
+
+CXmlArena::Scope::Scope(CXmlArena& arena) : m_prev_arena(t_active_arena)
+{
+    t_active_arena = &arena;
+}
+
+CXmlArena::Scope::~Scope()
+{
+    t_active_arena = m_prev_arena;
+}
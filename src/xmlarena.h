@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////////
+// Purpose:   Bump allocator for pugixml documents
+// Author:    Ralph Walden
+// Copyright: Copyright (c) 2022 KeyWorks Software (Ralph Walden)
+// License:   Apache License see ../LICENSE
+/////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// pugixml allocates every page and every string that doesn't fit in a page with a separate call to malloc(), and frees
+// each of them individually when the document is destroyed. When converting or generating a large number of projects,
+// that churn shows up in profiles even though every allocation has exactly the same lifetime as its document.
+//
+// Once Install() has been called, every pugixml allocation made on a thread with an active CXmlArena::Scope comes from
+// that arena, and freeing it is a no-op. The memory is reclaimed all at once when the arena is Reset() or destroyed.
+// Allocations made without an active scope still use malloc()/free().
+//
+// Any document that allocated from an arena MUST be reset or destroyed before the arena is -- declaring the arena
+// before the document takes care of that.
+class CXmlArena
+{
+public:
+    CXmlArena(size_t block_size = 256 * 1024);
+
+    CXmlArena(const CXmlArena&) = delete;
+    CXmlArena& operator=(const CXmlArena&) = delete;
+
+    // Returns 16-byte aligned memory
+    void* Allocate(size_t size);
+
+    // Releases everything allocated so far. Normal-sized blocks are kept and reused.
+    void Reset();
+
+    // Makes arena the source of all pugixml allocations on the current thread until the Scope is destroyed.
+    class Scope
+    {
+    public:
+        Scope(CXmlArena& arena);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        CXmlArena* m_prev_arena;
+    };
+
+    // Replaces pugixml's allocation functions. This must be called before any pugixml document allocates memory.
+    static void Install();
+
+protected:
+    struct alignas(16) Chunk
+    {
+        unsigned char bytes[16];
+    };
+
+    void NextBlock();
+
+private:
+    std::vector<std::unique_ptr<Chunk[]>> m_blocks;
+    std::vector<std::unique_ptr<Chunk[]>> m_large_blocks;
+
+    size_t m_blocks_used { 0 };
+
+    char* m_cur { nullptr };
+    char* m_end { nullptr };
+    size_t m_block_size;
+};